@@ -6,6 +6,8 @@ CONFIG -= qt
 HEADERS += $$files(*.h)
 SOURCES += $$files(*.cpp)
 OTHER_FILES += $$files(*.vert)
+OTHER_FILES += $$files(*.tesc)
+OTHER_FILES += $$files(*.tese)
 OTHER_FILES += $$files(*.frag)
 OTHER_FILES += $$files(*.comp)
 
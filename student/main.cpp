@@ -54,6 +54,18 @@ Scene g_scene;
 // Auxiliary functions
 //-------------------------------------------------------------------------------------------------
 
+// scenes with keys of their own declare keyPress(unsigned char), others ignore them
+template<typename T>
+auto sceneKeyPress(T& scene, unsigned char key, int) -> decltype(scene.keyPress(key))
+{
+	return scene.keyPress(key);
+}
+
+template<typename T>
+void sceneKeyPress(T&, unsigned char, long)
+{
+}
+
 void keyPress(unsigned char key, int x, int y)
 {
 	(void)x;
@@ -72,6 +84,10 @@ void keyPress(unsigned char key, int x, int y)
 		wireframeEnabled ^= 1;
 		glPolygonMode(GL_FRONT_AND_BACK, wireframeEnabled? GL_LINE : GL_FILL);
 	}
+	else
+	{
+		sceneKeyPress(g_scene, key, 0); // prefers the scene's own keyPress when there is one
+	}
 	glutPostRedisplay();
 }
 
@@ -0,0 +1,1154 @@
+#include <tess/batch_tessellator.h>
+#include <tess/mesh_simplifier.h>
+#include <tess/polygon_tessellator.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+namespace tess
+{
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+	// global constants
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	// number of primitives fetched at once by a worker: large enough to make the atomic counter cheap, small enough to balance heavy polygonal meshes
+	static const unsigned int CHUNK_SIZE = 64;
+
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+	// box around both ends of a truncated cone: a sloped end is a rotated disc, which stays within its radius of its center
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	static void cone_bounds(float top_radius, float bottom_radius, float height, const vec2& offset, vec3& min_corner, vec3& max_corner)
+	{
+		const auto top_center = vec3(offset * 0.5f, height * 0.5f);
+		const auto top = vec3(std::abs(top_radius));
+		const auto bottom = vec3(std::abs(bottom_radius));
+		min_corner = min(top_center - top, -top_center - bottom);
+		max_corner = max(top_center + top, -top_center + bottom);
+	}
+
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+	// primitive_batch::public
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	unsigned int primitive_batch::add(const box& b)
+	{
+		_boxes.push_back(b);
+		return _add(kind_box, _boxes.size() - 1);
+	}
+
+	unsigned int primitive_batch::add(const pyramid& p)
+	{
+		_pyramids.push_back(p);
+		return _add(kind_pyramid, _pyramids.size() - 1);
+	}
+
+	unsigned int primitive_batch::add(const cylinder& c)
+	{
+		_cylinders.push_back(c);
+		return _add(kind_cylinder, _cylinders.size() - 1);
+	}
+
+	unsigned int primitive_batch::add(const cone& c)
+	{
+		_cones.push_back(c);
+		return _add(kind_cone, _cones.size() - 1);
+	}
+
+	unsigned int primitive_batch::add(const cone_slope_offset& c)
+	{
+		_sloped_cones.push_back(c);
+		return _add(kind_cone_slope_offset, _sloped_cones.size() - 1);
+	}
+
+	unsigned int primitive_batch::add(const circular_torus& t)
+	{
+		_circular_tori.push_back(t);
+		return _add(kind_circular_torus, _circular_tori.size() - 1);
+	}
+
+	unsigned int primitive_batch::add(const rectangular_torus& t)
+	{
+		_rectangular_tori.push_back(t);
+		return _add(kind_rectangular_torus, _rectangular_tori.size() - 1);
+	}
+
+	unsigned int primitive_batch::add(const dish& d)
+	{
+		_dishes.push_back(d);
+		return _add(kind_dish, _dishes.size() - 1);
+	}
+
+	unsigned int primitive_batch::add(const sphere& s)
+	{
+		_spheres.push_back(s);
+		return _add(kind_sphere, _spheres.size() - 1);
+	}
+
+	void primitive_batch::begin_polygonal()
+	{
+		polygonal p;
+		p.first_polygon = _polygons.size();
+		p.polygon_count = 0;
+		_polygonals.push_back(p);
+	}
+
+	void primitive_batch::add_polygon(const polygon& poly)
+	{
+		polygon_range r;
+		r.first_offset = _contour_offsets.size();
+		r.contour_count = poly.contours.size();
+
+		_contour_offsets.push_back(_points.size());
+		for(const auto& c : poly.contours)
+		{
+			_points.insert(_points.end(), c.points.begin(), c.points.end());
+			_contour_offsets.push_back(_points.size());
+		}
+
+		_polygons.push_back(r);
+		++_polygonals.back().polygon_count;
+	}
+
+	void primitive_batch::add_polygon(const polygon_view& poly)
+	{
+		polygon_range r;
+		r.first_offset = _contour_offsets.size();
+		r.contour_count = poly.contour_count;
+
+		// offsets of the view are relative to its own buffer
+		const auto first = poly.contour_offsets[0];
+		const unsigned int base = _points.size();
+		for(unsigned int i = 0; i <= poly.contour_count; ++i)
+		{
+			_contour_offsets.push_back(base + poly.contour_offsets[i] - first);
+		}
+		_points.insert(_points.end(), poly.points + first, poly.points + poly.contour_offsets[poly.contour_count]);
+
+		_polygons.push_back(r);
+		++_polygonals.back().polygon_count;
+	}
+
+	unsigned int primitive_batch::end_polygonal(unsigned int lod_count /*= 1*/)
+	{
+		if(lod_count == 0)
+		{
+			throw std::invalid_argument("tess::primitive_batch requires at least one level of detail per polygonal mesh.");
+		}
+
+		_polygonals.back().lod_count = lod_count;
+		const auto position = _add(kind_polygonal, _polygonals.size() - 1);
+
+		// all levels share the polygons of the first one
+		for(unsigned int lod = 1; lod < lod_count; ++lod)
+		{
+			auto p = _polygonals.back();
+			p.lod = lod;
+			_polygonals.push_back(p);
+			_add(kind_polygonal, _polygonals.size() - 1);
+		}
+
+		return position;
+	}
+
+	void primitive_batch::clear()
+	{
+		_entries.clear();
+		_boxes.clear();
+		_pyramids.clear();
+		_cylinders.clear();
+		_cones.clear();
+		_sloped_cones.clear();
+		_circular_tori.clear();
+		_rectangular_tori.clear();
+		_dishes.clear();
+		_spheres.clear();
+		_polygonals.clear();
+		_polygons.clear();
+		_contour_offsets.clear();
+		_points.clear();
+	}
+
+	void primitive_batch::remove_caps(unsigned int position, bool top, bool bottom)
+	{
+		const auto& e = _entries.at(position);
+
+		switch(e.type)
+		{
+		case kind_cylinder:
+			_cylinders[e.index].with_top_cap &= !top;
+			_cylinders[e.index].with_bottom_cap &= !bottom;
+			break;
+		case kind_cone:
+			_cones[e.index].with_top_cap &= !top;
+			_cones[e.index].with_bottom_cap &= !bottom;
+			break;
+		case kind_cone_slope_offset:
+			_sloped_cones[e.index].with_top_cap &= !top;
+			_sloped_cones[e.index].with_bottom_cap &= !bottom;
+			break;
+		default:
+			throw std::invalid_argument("Only truncated cones have caps that can be removed from tess::primitive_batch.");
+		}
+	}
+
+	void primitive_batch::get_caps(unsigned int position, bool& top, bool& bottom) const
+	{
+		const auto& e = _entries.at(position);
+
+		switch(e.type)
+		{
+		case kind_cylinder:
+			top = _cylinders[e.index].with_top_cap;
+			bottom = _cylinders[e.index].with_bottom_cap;
+			break;
+		case kind_cone:
+			top = _cones[e.index].with_top_cap;
+			bottom = _cones[e.index].with_bottom_cap;
+			break;
+		case kind_cone_slope_offset:
+			top = _sloped_cones[e.index].with_top_cap;
+			bottom = _sloped_cones[e.index].with_bottom_cap;
+			break;
+		default:
+			throw std::invalid_argument("Only truncated cones in tess::primitive_batch have caps.");
+		}
+	}
+
+	unsigned int primitive_batch::add(const primitive_batch& other, unsigned int position)
+	{
+		const auto& e = other._entries.at(position);
+
+		switch(e.type)
+		{
+		case kind_box:
+			return add(other._boxes[e.index]);
+		case kind_pyramid:
+			return add(other._pyramids[e.index]);
+		case kind_cylinder:
+			return add(other._cylinders[e.index]);
+		case kind_cone:
+			return add(other._cones[e.index]);
+		case kind_cone_slope_offset:
+			return add(other._sloped_cones[e.index]);
+		case kind_circular_torus:
+			return add(other._circular_tori[e.index]);
+		case kind_rectangular_torus:
+			return add(other._rectangular_tori[e.index]);
+		case kind_dish:
+			return add(other._dishes[e.index]);
+		case kind_sphere:
+			return add(other._spheres[e.index]);
+		case kind_polygonal:
+			break;
+		}
+
+		const auto& p = other._polygonals[e.index];
+		if(p.lod_count > 1)
+		{
+			throw std::invalid_argument("Polygonal meshes with several levels of detail cannot be copied between tess::primitive_batch.");
+		}
+
+		begin_polygonal();
+		for(unsigned int i = 0; i < p.polygon_count; ++i)
+		{
+			add_polygon(other._polygon_view(p.first_polygon + i));
+		}
+		return end_polygonal();
+	}
+
+	void primitive_batch::get_bounds(unsigned int position, vec3& min_corner, vec3& max_corner) const
+	{
+		const auto& e = _entries.at(position);
+
+		switch(e.type)
+		{
+		case kind_box:
+			max_corner = abs(_boxes[e.index].extents) * 0.5f;
+			min_corner = -max_corner;
+			break;
+		case kind_pyramid:
+		{
+			// both ends are rectangles whose centers are half the offset away from the axis
+			const auto& p = _pyramids[e.index];
+			const auto half_offset = p.offset * 0.5f;
+			const auto top = abs(p.top_extents) * 0.5f;
+			const auto bottom = abs(p.bottom_extents) * 0.5f;
+			const auto hh = std::abs(p.height) * 0.5f;
+			min_corner = vec3(min(half_offset - top, -half_offset - bottom), -hh);
+			max_corner = vec3(max(half_offset + top, -half_offset + bottom), hh);
+			break;
+		}
+		case kind_cylinder:
+			cone_bounds(_cylinders[e.index].radius, _cylinders[e.index].radius, _cylinders[e.index].height, vec2(), min_corner, max_corner);
+			break;
+		case kind_cone:
+			cone_bounds(_cones[e.index].top_radius, _cones[e.index].bottom_radius, _cones[e.index].height, vec2(), min_corner, max_corner);
+			break;
+		case kind_cone_slope_offset:
+		{
+			const auto& p = _sloped_cones[e.index];
+			cone_bounds(p.top_radius, p.bottom_radius, p.height, p.offset, min_corner, max_corner);
+			break;
+		}
+		case kind_circular_torus:
+		{
+			// bounds of the whole ring, whatever the sweep
+			const auto& p = _circular_tori[e.index];
+			const auto r = std::abs(p.out_radius) + std::abs(p.in_radius);
+			max_corner = vec3(r, r, std::abs(p.in_radius));
+			min_corner = -max_corner;
+			break;
+		}
+		case kind_rectangular_torus:
+		{
+			const auto& p = _rectangular_tori[e.index];
+			const auto r = std::abs(p.out_radius) + std::abs(p.in_radius);
+			max_corner = vec3(r, r, std::abs(p.in_height) * 0.5f);
+			min_corner = -max_corner;
+			break;
+		}
+		case kind_dish:
+		{
+			// upper half of an ellipsoid standing on z = 0
+			const auto& p = _dishes[e.index];
+			const auto r = std::abs(p.radius);
+			min_corner = vec3(-r, -r, min(p.height, 0.0f));
+			max_corner = vec3(r, r, max(p.height, 0.0f));
+			break;
+		}
+		case kind_sphere:
+			max_corner = vec3(std::abs(_spheres[e.index].radius));
+			min_corner = -max_corner;
+			break;
+		case kind_polygonal:
+		{
+			const auto& p = _polygonals[e.index];
+			min_corner = vec3(std::numeric_limits<float>::max());
+			max_corner = vec3(-std::numeric_limits<float>::max());
+
+			// points of consecutive polygons are contiguous
+			if(p.polygon_count > 0)
+			{
+				const auto& first = _polygons[p.first_polygon];
+				const auto& last = _polygons[p.first_polygon + p.polygon_count - 1];
+				for(auto i = _contour_offsets[first.first_offset]; i < _contour_offsets[last.first_offset + last.contour_count]; ++i)
+				{
+					min_corner = min(min_corner, _points[i].vertex);
+					max_corner = max(max_corner, _points[i].vertex);
+				}
+			}
+			break;
+		}
+		}
+	}
+
+	unsigned int primitive_batch::size() const
+	{
+		return _entries.size();
+	}
+
+	bool primitive_batch::empty() const
+	{
+		return _entries.empty();
+	}
+
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+	// primitive_batch::private
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	unsigned int primitive_batch::_add(kind type, unsigned int index)
+	{
+		_entries.push_back({type, index});
+		return _entries.size() - 1;
+	}
+
+	polygon_view primitive_batch::_polygon_view(unsigned int polygon) const
+	{
+		const auto& r = _polygons[polygon];
+
+		polygon_view view;
+		view.points = _points.data();
+		view.contour_offsets = _contour_offsets.data() + r.first_offset;
+		view.contour_count = r.contour_count;
+		return view;
+	}
+
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+	// Hidden implementation
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	class batch_tessellator::impl
+	{
+	public:
+		// per-thread state: nothing in here is ever touched by two threads
+		struct worker
+		{
+			worker() : sink(vertices, elements)
+			{
+			}
+
+			polygon_tessellator tessellator;
+			mesh_optimizer optimizer;
+			mesh_simplifier simplifier;
+			std::vector<triangle_mesh> lods;
+			std::vector<float> lod_errors;
+
+			// meshes generated by this worker during the current tessellate() call, capacity is kept between calls
+			std::vector<vertex> vertices;
+			std::vector<element> elements;
+			vector_sink sink;
+		};
+
+		// where the mesh of a primitive was generated
+		struct slot
+		{
+			const worker* owner = nullptr;
+			unsigned int first_vertex = 0;
+			unsigned int vertex_count = 0;
+			unsigned int first_element = 0;
+			unsigned int element_count = 0;
+			size_t hash = 0; // contents of polygonal meshes, only computed when caching
+		};
+
+		explicit impl(unsigned int thread_count);
+
+		~impl();
+
+		void tessellate(const primitive_batch& batch, batch_result& result);
+
+		void tessellate_steps(const primitive_batch& batch, batch_result& result);
+
+		void run_parallel(void (impl::*task)(worker&));
+
+		void run_task(worker& w);
+
+		void thread_loop(unsigned int index);
+
+		void tessellate_task(worker& w);
+
+		void merge_task(worker& w);
+
+		void tessellate_entry(worker& w, const primitive_batch::entry& e);
+
+		bool tessellate_polygonal(worker& w, const polygonal& p, triangle_mesh& mesh);
+
+		void tessellate_polygonal_lods(worker& w, unsigned int first);
+
+		void hash_polygonal(slot& s) const;
+
+		primitive_key make_key(const primitive_batch::entry& e) const;
+
+		std::vector<std::unique_ptr<worker>> _workers;
+		mesh_optimizer::flag _polygonal_flags;
+		float _lod_ratio;
+		float _lod_max_error;
+		tessellation_cache* _cache;
+
+		// state of the current tessellate() call, shared (read-only or partitioned) by all workers
+		const primitive_batch* _batch;
+		batch_result* _result;
+		std::vector<slot> _slots;
+		std::vector<unsigned int> _new_meshes; // slot of each polygonal cache entry inserted by the current tessellate() call
+		std::vector<double> _msecs;
+		std::atomic<unsigned int> _next;
+
+		// threads of workers 1..n, kept for the whole lifetime of the tessellator and woken up by each run_parallel
+		std::vector<std::thread> _threads;
+		std::mutex _mutex;
+		std::condition_variable _start;
+		std::condition_variable _done;
+		void (impl::*_task)(worker&);
+		unsigned long long _generation; // incremented for each task, tells threads a new one is ready
+		unsigned int _running;          // threads that did not finish the current task yet
+		bool _stop;
+		std::exception_ptr _error;      // first exception thrown by the current task, rethrown on the calling thread
+	};
+
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+	// batch_tessellator::public
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	batch_tessellator::batch_tessellator(unsigned int thread_count /*= 0*/) : _d(new impl(thread_count))
+	{
+	}
+
+	batch_tessellator::~batch_tessellator()
+	{
+		delete _d;
+	}
+
+	unsigned int batch_tessellator::get_thread_count() const
+	{
+		return _d->_workers.size();
+	}
+
+	void batch_tessellator::set_polygonal_optimizations(mesh_optimizer::flag flags)
+	{
+		_d->_polygonal_flags = flags;
+	}
+
+	void batch_tessellator::set_polygonal_simplification(float lod_ratio, float max_error /*= std::numeric_limits<float>::max()*/)
+	{
+		if(!(lod_ratio > 0.0f && lod_ratio <= 1.0f))
+		{
+			throw std::invalid_argument("Level of detail ratio for tess::batch_tessellator must be in (0, 1].");
+		}
+
+		_d->_lod_ratio = lod_ratio;
+		_d->_lod_max_error = max_error;
+	}
+
+	void batch_tessellator::set_polygonal_weld_tolerances(float distance, float angle)
+	{
+		for(auto& w : _d->_workers)
+		{
+			w->optimizer.set_weld_tolerances(distance, angle);
+		}
+	}
+
+	void batch_tessellator::set_collect_polygonal_stats(bool collect)
+	{
+		for(auto& w : _d->_workers)
+		{
+			w->optimizer.set_collect_stats(collect);
+		}
+	}
+
+	mesh_optimizer::stats batch_tessellator::get_polygonal_input_stats() const
+	{
+		mesh_optimizer::stats s;
+		for(const auto& w : _d->_workers)
+		{
+			s += w->optimizer.get_input_stats();
+		}
+		return s;
+	}
+
+	mesh_optimizer::stats batch_tessellator::get_polygonal_output_stats() const
+	{
+		mesh_optimizer::stats s;
+		for(const auto& w : _d->_workers)
+		{
+			s += w->optimizer.get_output_stats();
+		}
+		return s;
+	}
+
+	mesh_optimizer::weld_stats batch_tessellator::get_polygonal_weld_stats() const
+	{
+		mesh_optimizer::weld_stats s;
+		for(const auto& w : _d->_workers)
+		{
+			s += w->optimizer.get_weld_stats();
+		}
+		return s;
+	}
+
+	polygon_tessellator::path_stats batch_tessellator::get_polygon_path_stats() const
+	{
+		polygon_tessellator::path_stats s;
+		for(const auto& w : _d->_workers)
+		{
+			s += w->tessellator.get_path_stats();
+		}
+		return s;
+	}
+
+	void batch_tessellator::reset_polygonal_stats()
+	{
+		for(auto& w : _d->_workers)
+		{
+			w->optimizer.reset_stats();
+			w->tessellator.reset_path_stats();
+		}
+	}
+
+	void batch_tessellator::set_cache(tessellation_cache* cache)
+	{
+		_d->_cache = cache;
+	}
+
+	void batch_tessellator::tessellate(const primitive_batch& batch, batch_result& result)
+	{
+		_d->tessellate(batch, result);
+	}
+
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+	// batch_tessellator::impl::public
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	batch_tessellator::impl::impl(unsigned int thread_count) : _polygonal_flags(mesh_optimizer::flag_all_optimizations),
+															   _lod_ratio(0.5f),
+															   _lod_max_error(std::numeric_limits<float>::max()),
+															   _cache(nullptr),
+															   _batch(nullptr),
+															   _result(nullptr),
+															   _next(0),
+															   _task(nullptr),
+															   _generation(0),
+															   _running(0),
+															   _stop(false)
+	{
+		if(thread_count == 0)
+		{
+			thread_count = std::max(1U, std::thread::hardware_concurrency());
+		}
+
+		for(unsigned int i = 0; i < thread_count; ++i)
+		{
+			_workers.emplace_back(new worker());
+		}
+
+		// calling thread acts as the first worker
+		_threads.reserve(thread_count - 1);
+		for(unsigned int i = 1; i < thread_count; ++i)
+		{
+			_threads.emplace_back(&impl::thread_loop, this, i);
+		}
+	}
+
+	batch_tessellator::impl::~impl()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stop = true;
+		}
+		_start.notify_all();
+
+		for(auto& t : _threads)
+		{
+			t.join();
+		}
+	}
+
+	void batch_tessellator::impl::tessellate(const primitive_batch& batch, batch_result& result)
+	{
+		const unsigned int cache_size = _cache != nullptr? _cache->size() : 0;
+
+		// entries of a failed call would be found later without a mesh, so their primitives would silently produce nothing
+		try
+		{
+			tessellate_steps(batch, result);
+		}
+		catch(...)
+		{
+			_batch = nullptr;
+			_result = nullptr;
+			if(_cache != nullptr)
+			{
+				_cache->rollback(cache_size);
+			}
+			throw;
+		}
+	}
+
+	void batch_tessellator::impl::tessellate_steps(const primitive_batch& batch, batch_result& result)
+	{
+		_batch = &batch;
+		_result = &result;
+
+		result.ranges.clear();
+		result.ranges.resize(batch.size());
+
+		// 1- look up parametric primitives in the cache: the first occurrence of a key creates a new entry, all others reuse it
+		if(_cache != nullptr)
+		{
+			for(unsigned int i = 0; i < batch.size(); ++i)
+			{
+				const auto& e = batch._entries[i];
+				if(e.type == primitive_batch::kind_polygonal)
+				{
+					continue;
+				}
+
+				auto& r = result.ranges[i];
+				const auto key = make_key(e);
+				r.cache_entry = _cache->find(key);
+				if(r.cache_entry == tessellation_cache::npos)
+				{
+					r.cache_entry = _cache->insert(key);
+				}
+				else
+				{
+					r.reused = true;
+				}
+			}
+		}
+
+		// 2- tessellate each remaining primitive into the arena of its worker, slots keep track of results in batch order
+		for(auto& w : _workers)
+		{
+			w->vertices.clear();
+			w->elements.clear();
+		}
+		_slots.assign(batch.size(), slot());
+		_msecs.assign(batch.size(), 0.0);
+		run_parallel(&impl::tessellate_task);
+
+		// 3- store new meshes in the cache and account for the ones we did not need to tessellate
+		if(_cache != nullptr)
+		{
+			// meshes inserted by this call are compared against the arenas of the workers, older ones against the geometry stored by the caller
+			const unsigned int first_new_entry = _cache->size();
+			_new_meshes.clear();
+
+			auto compare = [&](unsigned int id, const vertex* vertices, unsigned int vertex_count, const element* elements, unsigned int element_count)
+			{
+				if(id < first_new_entry)
+				{
+					return _cache->compare_mesh(id, vertices, vertex_count, elements, element_count);
+				}
+
+				const auto& other = _slots[_new_meshes[id - first_new_entry]];
+				return std::equal(vertices, vertices + vertex_count, other.owner->vertices.begin() + other.first_vertex) &&
+					   std::equal(elements, elements + element_count, other.owner->elements.begin() + other.first_element);
+			};
+
+			for(unsigned int i = 0; i < batch.size(); ++i)
+			{
+				auto& r = result.ranges[i];
+
+				// polygonal meshes identical to one already stored keep only a reference to it, in batch order so results stay deterministic
+				if(batch._entries[i].type == primitive_batch::kind_polygonal && _slots[i].element_count > 0)
+				{
+					const auto& s = _slots[i];
+					const auto vertices = s.owner->vertices.data() + s.first_vertex;
+					const auto elements = s.owner->elements.data() + s.first_element;
+
+					r.cache_entry = _cache->find_mesh(s.hash, vertices, s.vertex_count, elements, s.element_count, compare);
+					if(r.cache_entry == tessellation_cache::npos)
+					{
+						r.cache_entry = _cache->insert_mesh(s.hash, s.vertex_count, s.element_count);
+						_new_meshes.push_back(i);
+						_cache->record_miss(r.cache_entry);
+						continue;
+					}
+
+					r.reused = true;
+				}
+
+				if(r.cache_entry == tessellation_cache::npos)
+				{
+					continue;
+				}
+
+				if(r.reused)
+				{
+					_cache->record_hit(r.cache_entry);
+				}
+				else
+				{
+					const auto& s = _slots[i];
+					_cache->set_mesh(r.cache_entry, s.owner->vertices.data() + s.first_vertex, s.vertex_count,
+									 s.owner->elements.data() + s.first_element, s.element_count, _msecs[i]);
+					_cache->record_miss(r.cache_entry);
+				}
+			}
+		}
+
+		// 4- exclusive prefix sum of mesh sizes gives each primitive its final place in the merged arrays
+		unsigned int vertex_count = 0;
+		unsigned int element_count = 0;
+		for(unsigned int i = 0; i < _slots.size(); ++i)
+		{
+			auto& r = result.ranges[i];
+
+			if(r.reused && batch._entries[i].type == primitive_batch::kind_polygonal)
+			{
+				// geometry lives wherever the cache entry was first stored, this copy is dropped
+				r.vertex_count = _slots[i].vertex_count;
+				r.element_count = _slots[i].element_count;
+				continue;
+			}
+
+			if(r.reused)
+			{
+				// sizes are known, but geometry lives wherever the cache entry was first stored
+				const auto& mesh = _cache->get_mesh(r.cache_entry);
+				r.vertex_count = mesh.vertices.size();
+				r.element_count = mesh.elements.size();
+				continue;
+			}
+
+			r.base_vertex = vertex_count;
+			r.vertex_count = _slots[i].vertex_count;
+			r.first_element = element_count;
+			r.element_count = _slots[i].element_count;
+			vertex_count += r.vertex_count;
+			element_count += r.element_count;
+		}
+
+		// 5- copy meshes to their final place, ranges are disjoint so no synchronization is needed
+		result.vertices.resize(vertex_count);
+		result.elements.resize(element_count);
+		run_parallel(&impl::merge_task);
+
+		_batch = nullptr;
+		_result = nullptr;
+	}
+
+	void batch_tessellator::impl::run_parallel(void (impl::*task)(worker&))
+	{
+		_next = 0;
+
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_task = task;
+			_running = _threads.size();
+			_error = nullptr;
+			++_generation;
+		}
+		_start.notify_all();
+
+		// calling thread acts as the first worker
+		run_task(*_workers[0]);
+
+		std::exception_ptr error;
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_done.wait(lock, [this]{ return _running == 0; });
+			std::swap(error, _error);
+		}
+
+		if(error != nullptr)
+		{
+			std::rethrow_exception(error);
+		}
+	}
+
+	void batch_tessellator::impl::run_task(worker& w)
+	{
+		// an exception escaping a thread would terminate the process: keep the first one for the calling thread
+		try
+		{
+			(this->*_task)(w);
+		}
+		catch(...)
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			if(_error == nullptr)
+			{
+				_error = std::current_exception();
+			}
+		}
+	}
+
+	void batch_tessellator::impl::thread_loop(unsigned int index)
+	{
+		unsigned long long generation = 0;
+
+		for(;;)
+		{
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_start.wait(lock, [&]{ return _stop || _generation != generation; });
+				if(_stop)
+				{
+					return;
+				}
+				generation = _generation;
+			}
+
+			run_task(*_workers[index]);
+
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				--_running;
+			}
+			_done.notify_one();
+		}
+	}
+
+	void batch_tessellator::impl::tessellate_task(worker& w)
+	{
+		const unsigned int count = _slots.size();
+
+		for(unsigned int begin = _next.fetch_add(CHUNK_SIZE); begin < count; begin = _next.fetch_add(CHUNK_SIZE))
+		{
+			const unsigned int end = std::min(begin + CHUNK_SIZE, count);
+			for(unsigned int i = begin; i < end; ++i)
+			{
+				if(_result->ranges[i].reused)
+				{
+					continue;
+				}
+
+				// the whole chain of a polygonal mesh is generated by the worker that finds its coarsest level
+				const auto& e = _batch->_entries[i];
+				if(e.type == primitive_batch::kind_polygonal && _batch->_polygonals[e.index].lod_count > 1)
+				{
+					if(_batch->_polygonals[e.index].lod == 0)
+					{
+						tessellate_polygonal_lods(w, i);
+					}
+					continue;
+				}
+
+				auto& s = _slots[i];
+				s.owner = &w;
+				s.first_vertex = w.vertices.size();
+				s.first_element = w.elements.size();
+
+				const auto start = std::chrono::steady_clock::now();
+				tessellate_entry(w, _batch->_entries[i]);
+				_msecs[i] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+				s.vertex_count = w.vertices.size() - s.first_vertex;
+				s.element_count = w.elements.size() - s.first_element;
+
+				if(e.type == primitive_batch::kind_polygonal)
+				{
+					hash_polygonal(s);
+				}
+			}
+		}
+	}
+
+	void batch_tessellator::impl::merge_task(worker& /*w*/)
+	{
+		const unsigned int count = _slots.size();
+
+		for(unsigned int begin = _next.fetch_add(CHUNK_SIZE); begin < count; begin = _next.fetch_add(CHUNK_SIZE))
+		{
+			const unsigned int end = std::min(begin + CHUNK_SIZE, count);
+			for(unsigned int i = begin; i < end; ++i)
+			{
+				const auto& s = _slots[i];
+				const auto& r = _result->ranges[i];
+				if(r.reused)
+				{
+					continue;
+				}
+
+				const auto vertices = s.owner->vertices.begin() + s.first_vertex;
+				const auto elements = s.owner->elements.begin() + s.first_element;
+				std::copy(vertices, vertices + s.vertex_count, _result->vertices.begin() + r.base_vertex);
+				std::copy(elements, elements + s.element_count, _result->elements.begin() + r.first_element);
+			}
+		}
+	}
+
+	void batch_tessellator::impl::tessellate_entry(worker& w, const primitive_batch::entry& e)
+	{
+		const primitive_batch& b = *_batch;
+
+		switch(e.type)
+		{
+		case primitive_batch::kind_box:
+		{
+			const auto& p = b._boxes[e.index];
+			tessellate_box(w.sink, p.extents);
+			break;
+		}
+		case primitive_batch::kind_pyramid:
+		{
+			const auto& p = b._pyramids[e.index];
+			tessellate_pyramid(w.sink, p.top_extents, p.bottom_extents, p.height, p.offset);
+			break;
+		}
+		case primitive_batch::kind_cylinder:
+		{
+			const auto& p = b._cylinders[e.index];
+			tessellate_cone_slope_offset(w.sink, p.radius, p.radius, p.height, vec2(), vec2(), vec2(), p.segment_count, p.with_top_cap, p.with_bottom_cap);
+			break;
+		}
+		case primitive_batch::kind_cone:
+		{
+			const auto& p = b._cones[e.index];
+			tessellate_cone_slope_offset(w.sink, p.top_radius, p.bottom_radius, p.height, vec2(), vec2(), vec2(), p.segment_count,
+										 p.with_top_cap, p.with_bottom_cap);
+			break;
+		}
+		case primitive_batch::kind_cone_slope_offset:
+		{
+			const auto& p = b._sloped_cones[e.index];
+			tessellate_cone_slope_offset(w.sink, p.top_radius, p.bottom_radius, p.height, p.top_slope_angles, p.bottom_slope_angles, p.offset,
+										 p.segment_count, p.with_top_cap, p.with_bottom_cap);
+			break;
+		}
+		case primitive_batch::kind_circular_torus:
+		{
+			const auto& p = b._circular_tori[e.index];
+			tessellate_circular_torus(w.sink, p.in_radius, p.out_radius, p.sweep_angle, p.segment_count, p.sweep_count);
+			break;
+		}
+		case primitive_batch::kind_rectangular_torus:
+		{
+			const auto& p = b._rectangular_tori[e.index];
+			tessellate_rectangular_torus(w.sink, p.in_radius, p.out_radius, p.in_height, p.sweep_angle, p.sweep_count);
+			break;
+		}
+		case primitive_batch::kind_dish:
+		{
+			const auto& p = b._dishes[e.index];
+			tessellate_dish(w.sink, p.radius, p.height, p.horizontal_count, p.vertical_count);
+			break;
+		}
+		case primitive_batch::kind_sphere:
+		{
+			const auto& p = b._spheres[e.index];
+			tessellate_sphere(w.sink, p.radius, p.horizontal_count, p.vertical_count);
+			break;
+		}
+		case primitive_batch::kind_polygonal:
+		{
+			// invalid meshes produce nothing
+			triangle_mesh mesh;
+			if(!tessellate_polygonal(w, b._polygonals[e.index], mesh))
+			{
+				break;
+			}
+
+			std::copy(mesh.vertices.begin(), mesh.vertices.end(), w.sink.allocate_vertices(mesh.vertices.size()));
+			std::copy(mesh.elements.begin(), mesh.elements.end(), w.sink.allocate_elements(mesh.elements.size()));
+			break;
+		}
+		}
+	}
+
+	bool batch_tessellator::impl::tessellate_polygonal(worker& w, const polygonal& p, triangle_mesh& mesh)
+	{
+		const primitive_batch& b = *_batch;
+
+		w.tessellator.begin();
+		for(unsigned int i = 0; i < p.polygon_count; ++i)
+		{
+			w.tessellator.add_polygon(b._polygon_view(p.first_polygon + i));
+		}
+		mesh = w.tessellator.end();
+
+		if(!mesh.is_valid())
+		{
+			return false;
+		}
+
+		w.optimizer.optimize(mesh, _polygonal_flags);
+		return true;
+	}
+
+	void batch_tessellator::impl::tessellate_polygonal_lods(worker& w, unsigned int first)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		const auto& p = _batch->_polygonals[_batch->_entries[first].index];
+
+		triangle_mesh mesh;
+		const bool valid = tessellate_polygonal(w, p, mesh);
+		if(valid)
+		{
+			w.simplifier.simplify_lods(mesh, p.lod_count, _lod_ratio, _lod_max_error, w.lods, w.lod_errors);
+		}
+
+		for(unsigned int lod = 0; lod < p.lod_count; ++lod)
+		{
+			auto& s = _slots[first + lod];
+			s.owner = &w;
+			s.first_vertex = w.vertices.size();
+			s.first_element = w.elements.size();
+
+			// coarser levels lost the triangle and vertex order given by the optimizer
+			if(valid && lod + 1 < p.lod_count)
+			{
+				w.optimizer.optimize(w.lods[lod], _polygonal_flags);
+			}
+
+			if(valid && w.lods[lod].is_valid())
+			{
+				const auto& m = w.lods[lod];
+				std::copy(m.vertices.begin(), m.vertices.end(), w.sink.allocate_vertices(m.vertices.size()));
+				std::copy(m.elements.begin(), m.elements.end(), w.sink.allocate_elements(m.elements.size()));
+				_result->ranges[first + lod].error = w.lod_errors[lod];
+			}
+
+			s.vertex_count = w.vertices.size() - s.first_vertex;
+			s.element_count = w.elements.size() - s.first_element;
+			hash_polygonal(s);
+		}
+
+		_msecs[first] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	void batch_tessellator::impl::hash_polygonal(slot& s) const
+	{
+		// hashing is the expensive part of the lookup, so it is done here in parallel
+		if(_cache != nullptr)
+		{
+			s.hash = tessellation_cache::hash_mesh(s.owner->vertices.data() + s.first_vertex, s.vertex_count,
+												   s.owner->elements.data() + s.first_element, s.element_count);
+		}
+	}
+
+	// cap flags of truncated cones packed into a single cache key parameter
+	static float caps_key(bool with_top_cap, bool with_bottom_cap)
+	{
+		return static_cast<float>((with_top_cap? 1 : 0) | (with_bottom_cap? 2 : 0));
+	}
+
+	primitive_key batch_tessellator::impl::make_key(const primitive_batch::entry& e) const
+	{
+		// parameters must match the ones given to tessellate_* in tessellate_entry
+		const primitive_batch& b = *_batch;
+
+		switch(e.type)
+		{
+		case primitive_batch::kind_box:
+		{
+			const auto& p = b._boxes[e.index];
+			return _cache->make_key(e.type, {p.extents.x, p.extents.y, p.extents.z});
+		}
+		case primitive_batch::kind_pyramid:
+		{
+			const auto& p = b._pyramids[e.index];
+			return _cache->make_key(e.type, {p.top_extents.x, p.top_extents.y, p.bottom_extents.x, p.bottom_extents.y, p.height, p.offset.x, p.offset.y});
+		}
+		case primitive_batch::kind_cylinder:
+		{
+			const auto& p = b._cylinders[e.index];
+			return _cache->make_key(e.type, {p.radius, p.height, static_cast<float>(p.segment_count), caps_key(p.with_top_cap, p.with_bottom_cap)});
+		}
+		case primitive_batch::kind_cone:
+		{
+			const auto& p = b._cones[e.index];
+			return _cache->make_key(e.type, {p.top_radius, p.bottom_radius, p.height, static_cast<float>(p.segment_count),
+											 caps_key(p.with_top_cap, p.with_bottom_cap)});
+		}
+		case primitive_batch::kind_cone_slope_offset:
+		{
+			const auto& p = b._sloped_cones[e.index];
+			return _cache->make_key(e.type, {p.top_radius, p.bottom_radius, p.height, p.top_slope_angles.x, p.top_slope_angles.y,
+											 p.bottom_slope_angles.x, p.bottom_slope_angles.y, p.offset.x, p.offset.y, static_cast<float>(p.segment_count),
+											 caps_key(p.with_top_cap, p.with_bottom_cap)});
+		}
+		case primitive_batch::kind_circular_torus:
+		{
+			const auto& p = b._circular_tori[e.index];
+			return _cache->make_key(e.type, {p.in_radius, p.out_radius, p.sweep_angle, static_cast<float>(p.segment_count), static_cast<float>(p.sweep_count)});
+		}
+		case primitive_batch::kind_rectangular_torus:
+		{
+			const auto& p = b._rectangular_tori[e.index];
+			return _cache->make_key(e.type, {p.in_radius, p.out_radius, p.in_height, p.sweep_angle, static_cast<float>(p.sweep_count)});
+		}
+		case primitive_batch::kind_dish:
+		{
+			const auto& p = b._dishes[e.index];
+			return _cache->make_key(e.type, {p.radius, p.height, static_cast<float>(p.horizontal_count), static_cast<float>(p.vertical_count)});
+		}
+		case primitive_batch::kind_sphere:
+		{
+			const auto& p = b._spheres[e.index];
+			return _cache->make_key(e.type, {p.radius, static_cast<float>(p.horizontal_count), static_cast<float>(p.vertical_count)});
+		}
+		case primitive_batch::kind_polygonal:
+			break;
+		}
+
+		throw std::logic_error("Polygonal meshes cannot be stored in tess::tessellation_cache.");
+	}
+} // namespace tess
@@ -0,0 +1,159 @@
+#include <tess/cap_culler.h>
+#include <algorithm>
+#include <cmath>
+
+namespace tess
+{
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// cap_culler::public
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	cap_culler::cap_culler(float distance_tolerance /*= 1e-3f*/, float angle_tolerance /*= 1e-2f*/)
+		: _distance_tolerance(distance_tolerance), _min_opposite_cos(std::cos(angle_tolerance))
+	{
+	}
+
+	void cap_culler::add(unsigned int position, const cylinder& c, const mat4& transform, unsigned int position_count /*= 1*/)
+	{
+		_add_truncated_cone(position, position_count, c.radius, c.radius, c.height, vec2(), vec2(), vec2(), transform);
+	}
+
+	void cap_culler::add(unsigned int position, const cone& c, const mat4& transform, unsigned int position_count /*= 1*/)
+	{
+		_add_truncated_cone(position, position_count, c.top_radius, c.bottom_radius, c.height, vec2(), vec2(), vec2(), transform);
+	}
+
+	void cap_culler::add(unsigned int position, const cone_slope_offset& c, const mat4& transform, unsigned int position_count /*= 1*/)
+	{
+		_add_truncated_cone(position, position_count, c.top_radius, c.bottom_radius, c.height, c.top_slope_angles, c.bottom_slope_angles, c.offset, transform);
+	}
+
+	void cap_culler::add(const circular_torus& t, const mat4& transform)
+	{
+		// end sections are circles of radius in_radius around the sweep path, see tessellate_circular_torus
+		const auto end = vec3(cos(t.sweep_angle), sin(t.sweep_angle), 0.0f);
+		_add_disc(vec3(t.out_radius, 0.0f, 0.0f), vec3(0.0f, -1.0f, 0.0f), t.in_radius, transform, npos, true);
+		_add_disc(end * t.out_radius, vec3(-end.y, end.x, 0.0f), t.in_radius, transform, npos, false);
+	}
+
+	void cap_culler::add(const dish& d, const mat4& transform)
+	{
+		// dish is open at its base, which lies on the xy plane
+		_add_disc(vec3(0.0f), vec3(0.0f, 0.0f, -1.0f), d.radius, transform, npos, false);
+	}
+
+	unsigned int cap_culler::cull(primitive_batch& batch)
+	{
+		// sort and sweep along x: only discs with close centres are compared
+		std::vector<unsigned int> order(_discs.size());
+		for(unsigned int i = 0; i < order.size(); ++i)
+		{
+			order[i] = i;
+		}
+		std::sort(order.begin(), order.end(), [this](unsigned int a, unsigned int b){ return _discs[a].center.x < _discs[b].center.x; });
+
+		for(unsigned int i = 0; i < order.size(); ++i)
+		{
+			const auto& a = _discs[order[i]];
+
+			for(unsigned int j = i + 1; j < order.size(); ++j)
+			{
+				const auto& b = _discs[order[j]];
+
+				if(b.center.x - a.center.x > _distance_tolerance)
+				{
+					break;
+				}
+
+				// nothing to remove between uncapped primitives, and the two ends of a flat primitive do not hide each other
+				if(a.owner == b.owner)
+				{
+					continue;
+				}
+
+				if(std::abs(a.radius - b.radius) > _distance_tolerance ||
+				   distance(a.center, b.center) > _distance_tolerance ||
+				   dot(a.normal, b.normal) > -_min_opposite_cos)
+				{
+					continue;
+				}
+
+				for(const auto* d : {&a, &b})
+				{
+					if(d->owner != npos)
+					{
+						auto& o = _owners[d->owner];
+						(d->top? o.hide_top : o.hide_bottom) = true;
+					}
+				}
+			}
+		}
+
+		unsigned int removed = 0;
+
+		for(const auto& o : _owners)
+		{
+			if(!o.hide_top && !o.hide_bottom)
+			{
+				continue;
+			}
+
+			for(unsigned int p = 0; p < o.position_count; ++p)
+			{
+				batch.remove_caps(o.position + p, o.hide_top, o.hide_bottom);
+			}
+
+			removed += (o.hide_top? 1 : 0) + (o.hide_bottom? 1 : 0);
+		}
+
+		clear();
+		return removed;
+	}
+
+	void cap_culler::clear()
+	{
+		_discs.clear();
+		_owners.clear();
+	}
+
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// cap_culler::private
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	void cap_culler::_add_truncated_cone(unsigned int position, unsigned int position_count, float top_radius, float bottom_radius, float height,
+										 const vec2& top_slope_angles, const vec2& bottom_slope_angles, const vec2& offset, const mat4& transform)
+	{
+		// same cap placement as tessellate_cone_slope_offset
+		const auto owner_id = static_cast<unsigned int>(_owners.size());
+		_owners.push_back({position, position_count, false, false});
+
+		const auto top_center = vec3(offset.x*0.5f, offset.y*0.5f, height * 0.5f);
+		const auto bottom_center = vec3(-offset.x*0.5f, -offset.y*0.5f, -height * 0.5f);
+		const auto top_normal = quat(vec3(top_slope_angles.x, top_slope_angles.y, 0)) * vec3(0.0f, 0.0f, 1.0f);
+		const auto bottom_normal = quat(vec3(bottom_slope_angles.x, bottom_slope_angles.y, 0)) * vec3(0.0f, 0.0f, -1.0f);
+
+		_add_disc(top_center, top_normal, top_radius, transform, owner_id, true);
+		_add_disc(bottom_center, bottom_normal, bottom_radius, transform, owner_id, false);
+	}
+
+	void cap_culler::_add_disc(const vec3& center, const vec3& normal, float radius, const mat4& transform, unsigned int owner, bool top)
+	{
+		const auto m3 = mat3(transform);
+		const auto scale = max(length(m3[0]), max(length(m3[1]), length(m3[2])));
+
+		disc d;
+		d.center = vec3(transform * vec4(center, 1.0f));
+		d.normal = normalize(inverseTranspose(m3) * normal);
+		d.radius = radius * scale;
+		d.owner = owner;
+		d.top = top;
+
+		// apex of a cone has no cap
+		if(d.radius <= _distance_tolerance)
+		{
+			return;
+		}
+
+		_discs.push_back(d);
+	}
+} // namespace tess
@@ -0,0 +1,62 @@
+#pragma once
+#include <tess/batch_tessellator.h>
+
+namespace tess
+{
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// cap_culler: finds end discs shared by connected primitives (e.g. a pipe and its elbow) and removes the caps hidden between them
+	// primitives are registered with their model transform after being added to a batch; cull is called once the group of connected primitives is complete
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	class cap_culler
+	{
+	public:
+		// two discs are connected when their centres and radii differ by at most distance_tolerance (model units)
+		// and their outward normals are opposite within angle_tolerance (radians)
+		explicit cap_culler(float distance_tolerance = 1e-3f, float angle_tolerance = 1e-2f);
+
+		// position is the one returned by primitive_batch::add
+		// position_count > 1 registers consecutive batch entries that describe the same primitive (e.g. levels of detail)
+		void add(unsigned int position, const cylinder& c, const mat4& transform, unsigned int position_count = 1);
+		void add(unsigned int position, const cone& c, const mat4& transform, unsigned int position_count = 1);
+		void add(unsigned int position, const cone_slope_offset& c, const mat4& transform, unsigned int position_count = 1);
+
+		// uncapped primitives hide the caps connected to them
+		void add(const circular_torus& t, const mat4& transform);
+		void add(const dish& d, const mat4& transform);
+
+		// remove hidden caps of registered primitives from the batch and forget all registered primitives
+		// return number of caps removed
+		unsigned int cull(primitive_batch& batch);
+
+		void clear();
+
+	private:
+		struct disc
+		{
+			vec3 center;
+			vec3 normal;
+			float radius;
+			unsigned int owner; // npos for primitives without caps
+			bool top;
+		};
+
+		struct owner
+		{
+			unsigned int position;
+			unsigned int position_count;
+			bool hide_top;
+			bool hide_bottom;
+		};
+
+		static const unsigned int npos = ~0U;
+
+		void _add_truncated_cone(unsigned int position, unsigned int position_count, float top_radius, float bottom_radius, float height,
+								 const vec2& top_slope_angles, const vec2& bottom_slope_angles, const vec2& offset, const mat4& transform);
+		void _add_disc(const vec3& center, const vec3& normal, float radius, const mat4& transform, unsigned int owner, bool top);
+
+		float _distance_tolerance;
+		float _min_opposite_cos;
+		std::vector<disc> _discs;
+		std::vector<owner> _owners;
+	};
+} // namespace tess
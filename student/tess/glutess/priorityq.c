@@ -89,16 +89,122 @@ void pqDeletePriorityQ( PriorityQ *pq )
 }
 
 
-#define LT(x,y)		(! LEQ(y,x))
-#define GT(x,y)		(! LEQ(x,y))
-#define Swap(a,b)	if(1){PQkey *tmp = *a; *a = *b; *b = tmp;}else
+/* The initial events are sorted by copying their coordinates next to
+ * each other, rather than comparing them through pq->order and the
+ * vertex pointers.  Keys are vertices (see LEQ in priorityq-heap.c).
+ */
+typedef struct SortEntry {
+  double	s, t;
+  PQkey		*key;
+} SortEntry;
+
+/* Descending order, so that the minimum is extracted from the end. */
+#define Before(a,b)	((a).s > (b).s || ((a).s == (b).s && (a).t > (b).t))
+#define SwapEntries(a,b)	do{SortEntry tmp = a; a = b; b = tmp;}while(0)
+
+#define INSERTION_SORT_SIZE	16
+
+static void InsertionSort( SortEntry *a, long n )
+{
+  SortEntry x;
+  long i, j;
+
+  for( i = 1; i < n; ++i ) {
+    x = a[i];
+    for( j = i; j > 0 && Before( x, a[j-1] ); --j ) {
+      a[j] = a[j-1];
+    }
+    a[j] = x;
+  }
+}
+
+static void SiftDown( SortEntry *a, long i, long n )
+{
+  SortEntry x = a[i];
+  long child;
+
+  while( (child = 2*i + 1) < n ) {
+    if( child+1 < n && Before( a[child], a[child+1] )) ++child;
+    if( ! Before( x, a[child] )) break;
+    a[i] = a[child];
+    i = child;
+  }
+  a[i] = x;
+}
+
+static void HeapSort( SortEntry *a, long n )
+{
+  long i;
+
+  for( i = n/2 - 1; i >= 0; --i ) {
+    SiftDown( a, i, n );
+  }
+  for( i = n-1; i > 0; --i ) {
+    SwapEntries( a[0], a[i] );
+    SiftDown( a, 0, i );
+  }
+}
+
+/* Introsort: quicksort with a median-of-three pivot, which switches to
+ * heapsort for ranges that recurse too deeply, so that no input can
+ * make it quadratic.
+ */
+static void IntroSort( SortEntry *a, long n )
+{
+  struct { SortEntry *a; long n; int depth; } Stack[64], *top = Stack;
+  SortEntry piv;
+  long i, j;
+  int depth = 0;
+
+  for( i = n; i > 1; i >>= 1 ) depth += 2;
+
+  top->a = a; top->n = n; top->depth = depth; ++top;
+  while( --top >= Stack ) {
+    a = top->a;
+    n = top->n;
+    depth = top->depth;
+    while( n > INSERTION_SORT_SIZE ) {
+      if( depth-- == 0 ) {
+	HeapSort( a, n );
+	n = 0;
+	break;
+      }
+
+      /* Median of the first, middle and last entries, moved to a[0] */
+      if( Before( a[n/2], a[0] )) { SwapEntries( a[n/2], a[0] ); }
+      if( Before( a[n-1], a[n/2] )) { SwapEntries( a[n-1], a[n/2] ); }
+      if( Before( a[n/2], a[0] )) { SwapEntries( a[n/2], a[0] ); }
+      SwapEntries( a[0], a[n/2] );
+      piv = a[0];
+
+      i = -1;
+      j = n;
+      for( ;; ) {
+	do { ++i; } while( Before( a[i], piv ));
+	do { --j; } while( Before( piv, a[j] ));
+	if( i >= j ) break;
+	SwapEntries( a[i], a[j] );
+      }
+
+      /* Keep sorting the smaller side, so the stack stays logarithmic */
+      if( j+1 < n-j-1 ) {
+	top->a = a+j+1; top->n = n-j-1; top->depth = depth; ++top;
+	n = j+1;
+      } else {
+	top->a = a; top->n = j+1; top->depth = depth; ++top;
+	a += j+1;
+	n -= j+1;
+      }
+    }
+    InsertionSort( a, n );
+  }
+}
 
 /* really __tess_pqSortInit */
 int pqInit( PriorityQ *pq )
 {
-  PQkey **p, **r, **i, **j, *piv;
-  struct { PQkey **p, **r; } Stack[50], *top = Stack;
-  unsigned long seed = 2016473283;
+  SortEntry *entries;
+  long k;
 
   /* Create an array of indirect pointers to the keys, so that we
    * the handles we have returned are still valid.
@@ -115,59 +221,31 @@ int pqInit( PriorityQ *pq )
 /* fault four lines down. from fossum@austin.ibm.com.               */
   if (pq->order == NULL) return 0;
 
-  p = pq->order;
-  r = p + pq->size - 1;
-  for( piv = pq->keys, i = p; i <= r; ++piv, ++i ) {
-    *i = piv;
+  entries = (SortEntry *)memAlloc( (size_t)
+                                  ((pq->size+1) * sizeof(entries[0])) );
+  if (entries == NULL) return 0;
+
+  for( k = 0; k < pq->size; ++k ) {
+    entries[k].s = ((TESSvertex *)pq->keys[k])->s;
+    entries[k].t = ((TESSvertex *)pq->keys[k])->t;
+    entries[k].key = &pq->keys[k];
   }
 
-  /* Sort the indirect pointers in descending order,
-   * using randomized Quicksort
-   */
-  top->p = p; top->r = r; ++top;
-  while( --top >= Stack ) {
-    p = top->p;
-    r = top->r;
-    while( r > p + 10 ) {
-      seed = seed * 1539415821 + 1;
-      i = p + seed % (r - p + 1);
-      piv = *i;
-      *i = *p;
-      *p = piv;
-      i = p - 1;
-      j = r + 1;
-      do {
-	do { ++i; } while( GT( **i, *piv ));
-	do { --j; } while( LT( **j, *piv ));
-	Swap( i, j );
-      } while( i < j );
-      Swap( i, j );	/* Undo last swap */
-      if( i - p < r - j ) {
-	top->p = j+1; top->r = r; ++top;
-	r = i-1;
-      } else {
-	top->p = p; top->r = i-1; ++top;
-	p = j+1;
-      }
-    }
-    /* Insertion sort small lists */
-    for( i = p+1; i <= r; ++i ) {
-      piv = *i;
-      for( j = i; j > p && LT( **(j-1), *piv ); --j ) {
-	*j = *(j-1);
-      }
-      *j = piv;
-    }
+  /* Sort the indirect pointers in descending order */
+  IntroSort( entries, pq->size );
+
+  for( k = 0; k < pq->size; ++k ) {
+    pq->order[k] = entries[k].key;
   }
+  memFree( entries );
+
   pq->max = pq->size;
   pq->initialized = TRUE;
   __tess_pqHeapInit( pq->heap );	/* always succeeds */
 
 #ifndef NDEBUG
-  p = pq->order;
-  r = p + pq->size - 1;
-  for( i = p; i < r; ++i ) {
-    assert( LEQ( **(i+1), **i ));
+  for( k = 0; k+1 < pq->size; ++k ) {
+    assert( LEQ( *pq->order[k+1], *pq->order[k] ));
   }
 #endif
 
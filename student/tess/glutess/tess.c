@@ -135,16 +135,31 @@ tessNew( void )
 
   tess->polygonData= NULL;
 
+  __tess_arenaInit( &tess->arena );
+
   return tess;
 }
 
+/* The mesh, sweep structures and priority queue of a polygon are
+ * allocated from tess->arena, unless the client asked for the mesh
+ * itself, which must then outlive the polygon.
+ */
+static TESSarena *EnterArena( GLUTESS_tesselator *tess )
+{
+  return __tess_arenaEnter( (tess->callMesh == &noMesh) ? &tess->arena
+							: NULL );
+}
+
 static void MakeDormant( GLUTESS_tesselator *tess )
 {
   /* Return the tessellator to its original dormant state. */
 
   if( tess->mesh != NULL ) {
+	TESSarena *previous = EnterArena( tess );
 	__tess_meshDeleteMesh( tess->mesh );
+	__tess_arenaLeave( previous );
   }
+  __tess_arenaReset( &tess->arena );
   tess->state = T_DORMANT;
   tess->lastEdge = NULL;
   tess->mesh = NULL;
@@ -194,6 +209,7 @@ void
 tessDelete( GLUTESS_tesselator *tess )
 {
   RequireState( tess, T_DORMANT );
+  __tess_arenaFree( &tess->arena );
   memFree( tess );
 }
 
@@ -412,8 +428,7 @@ static int EmptyCache( GLUTESS_tesselator *tess )
 }
 
 
-void
-tessVertex( GLUTESS_tesselator *tess, double coords[3], void *data )
+static void Vertex( GLUTESS_tesselator *tess, double coords[3], void *data )
 {
   int i, tooLarge = FALSE;
   double x, clamped[3];
@@ -459,6 +474,15 @@ tessVertex( GLUTESS_tesselator *tess, double coords[3], void *data )
 }
 
 
+void
+tessVertex( GLUTESS_tesselator *tess, double coords[3], void *data )
+{
+  TESSarena *previous = EnterArena( tess );
+  Vertex( tess, coords, data );
+  __tess_arenaLeave( previous );
+}
+
+
 void
 tessBeginPolygon( GLUTESS_tesselator *tess, void *data )
 {
@@ -497,8 +521,7 @@ tessEndContour( GLUTESS_tesselator *tess )
   tess->state = T_IN_POLYGON;
 }
 
-void
-tessEndPolygon( GLUTESS_tesselator *tess )
+static void EndPolygon( GLUTESS_tesselator *tess )
 {
   TESSmesh *mesh;
 
@@ -592,6 +615,20 @@ tessEndPolygon( GLUTESS_tesselator *tess )
   tess->mesh = NULL;
 }
 
+void
+tessEndPolygon( GLUTESS_tesselator *tess )
+{
+  TESSarena *previous = EnterArena( tess );
+  EndPolygon( tess );
+  __tess_arenaLeave( previous );
+
+  /* Nothing of the polygon is referenced anymore, even if we ran out
+   * of memory, so all of it goes at once.
+   */
+  tess->mesh = NULL;
+  __tess_arenaReset( &tess->arena );
+}
+
 
 /*XXXblythe unused function*/
 #if 0
@@ -1,8 +1,12 @@
 #pragma once
-#include <tess/triangle_mesh.h>
+#include <tess/mesh_sink.h>
 
 namespace tess
 {
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// mesh_builder: converts triangles, fans and strips into an indexed triangle mesh
+	// vectors are kept between meshes, with a capacity that follows the sizes of recently built meshes
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
 	class mesh_builder
 	{
 	public:
@@ -11,11 +15,15 @@ namespace tess
 		void begin();
 		void set_primitive_mode(unsigned int mode);
 		void add_element(element element);
+		void add_triangle(element e0, element e1, element e2); // independent of the primitive mode
 		unsigned int add_vertex(const vertex& v); // return index of newly added vertex
 		const vertex& get_vertex(unsigned int idx);
 		triangle_mesh end();
+		void end(mesh_sink& sink);
 
 	private:
+		void _update_estimates();
+
 		void _add_triangle(element last_elem);
 
 		void _add_triangle_fan(element last_elem);
@@ -29,5 +37,9 @@ namespace tess
 		element _curr_elements[2]; // keeps track of last two elements of current triangle
 		unsigned int _num_curr_elements;
 		bool _invert_winding;
+
+		// decaying maxima of the sizes of built meshes
+		std::size_t _vertex_estimate;
+		std::size_t _element_estimate;
 	};
 } // namespace tess
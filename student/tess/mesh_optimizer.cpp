@@ -1,25 +1,10 @@
 #include <tess/mesh_optimizer.h>
-#include <unordered_map>
+#include <tess/vertex_hash.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <iostream>
-
-//----------------------------------------------------------------------------------------------------------------------------------------------------------
-// functor to compute hash value of a vertex
-//----------------------------------------------------------------------------------------------------------------------------------------------------------
-
-namespace std
-{
-	template<>
-	class hash<tess::vertex>
-	{
-	public:
-		size_t operator()(const tess::vertex& v) const
-		{
-			const unsigned int* h = reinterpret_cast<const unsigned int*>(&v);
-			unsigned int f = (h[0] + h[1] * 11 - (h[2] * 17) + h[3] * 7 + h[4] * 3 - h[5] * 13) & 0x7fffffff; // mask to avoid problems with +-0
-			return (f >> 22) ^ (f >> 12) ^ (f);
-		}
-	};
-} // namespace std
+#include <stdexcept>
 
 namespace tess
 {
@@ -29,10 +14,84 @@ namespace tess
 
 	static const element INVALID_ELEMENT = std::numeric_limits<element>::max();
 
+	// vertex fetch is simulated with a 4 KB FIFO cache of 64-byte lines
+	static const unsigned int FETCH_LINE_SIZE = 64;
+	static const unsigned int FETCH_CACHE_LINES = 64;
+
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+	// mesh_optimizer::stats
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	mesh_optimizer::stats& mesh_optimizer::stats::operator+=(const stats& other)
+	{
+		triangles += other.triangles;
+		vertices += other.vertices;
+		transformed_vertices += other.transformed_vertices;
+		vertex_bytes += other.vertex_bytes;
+		fetched_bytes += other.fetched_bytes;
+		return *this;
+	}
+
+	double mesh_optimizer::stats::acmr() const
+	{
+		return triangles > 0? static_cast<double>(transformed_vertices) / triangles : 0.0;
+	}
+
+	double mesh_optimizer::stats::atvr() const
+	{
+		return vertices > 0? static_cast<double>(transformed_vertices) / vertices : 0.0;
+	}
+
+	double mesh_optimizer::stats::overfetch() const
+	{
+		return vertex_bytes > 0? static_cast<double>(fetched_bytes) / vertex_bytes : 0.0;
+	}
+
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+	// mesh_optimizer::weld_stats
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	mesh_optimizer::weld_stats& mesh_optimizer::weld_stats::operator+=(const weld_stats& other)
+	{
+		removed_vertices += other.removed_vertices;
+		removed_triangles += other.removed_triangles;
+		msec += other.msec;
+		return *this;
+	}
+
 	//----------------------------------------------------------------------------------------------------------------------------------------------------------
 	// public
 	//----------------------------------------------------------------------------------------------------------------------------------------------------------
 
+	mesh_optimizer::stats mesh_optimizer::analyze(const triangle_mesh& mesh, unsigned int cache_size /*= VERTEX_CACHE_SIZE*/)
+	{
+		std::vector<unsigned int> vertex_stamps;
+		std::vector<unsigned int> line_stamps;
+		stats s;
+		_analyze(mesh, cache_size, vertex_stamps, line_stamps, s);
+		return s;
+	}
+
+	mesh_optimizer::mesh_optimizer() : _weld_distance(1e-4f), _weld_min_cos(std::cos(1e-2f)), _collect_stats(false)
+	{
+	}
+
+	void mesh_optimizer::set_collect_stats(bool collect)
+	{
+		_collect_stats = collect;
+	}
+
+	void mesh_optimizer::set_weld_tolerances(float distance, float angle)
+	{
+		if(!(distance > 0.0f) || !(angle >= 0.0f))
+		{
+			throw std::invalid_argument("Weld tolerances for tess::mesh_optimizer must be a positive distance and a non-negative angle.");
+		}
+
+		_weld_distance = distance;
+		_weld_min_cos = std::cos(angle);
+	}
+
 	void mesh_optimizer::optimize(triangle_mesh& mesh, flag flags)
 	{
 		if(!mesh.is_valid())
@@ -43,43 +102,18 @@ namespace tess
 		unsigned int original_vertex_count  = mesh.vertices.size();
 		unsigned int original_element_count = mesh.elements.size();
 
-		if(flags & flag_remove_unused_vertices)
-		{
-			// Store vertices that are actually referenced by an element
-			_temp_vertices.clear();
-			_temp_vertices.reserve(mesh.vertices.size());
-
-			// Element cross-reference table: for a given element of incoming value X, what is its updated value Y?
-			_temp_elements.clear();
-			_temp_elements.resize(mesh.vertices.size());
-			std::fill(std::begin(_temp_elements), std::end(_temp_elements), INVALID_ELEMENT);
-
-			for(unsigned int i = 0; i < mesh.elements.size(); ++i)
-			{
-				auto e = mesh.elements[i];
+		// simulating the caches costs about as much as welding a small mesh, so it is only done on demand
+		const bool analyze_mesh = _collect_stats || (flags & flag_check_results);
 
-				// If its the first time we encounter this element value
-				if(_temp_elements[e] == INVALID_ELEMENT)
-				{
-					// Get position where corresponding vertex will be inserted (i.e. the new element value)
-					auto pos = static_cast<element>(_temp_vertices.size());
-					// Save vertex
-					_temp_vertices.push_back(mesh.vertices[e]);
-					// Update element value
-					mesh.elements[i] = pos;
-					// Save new element value in cross-reference table
-					_temp_elements[e] = pos;
-				}
-				else
-				{
-					// We already encontered this element value, just update to its new value using cross-reference table
-					mesh.elements[i] = _temp_elements[e];
-				}
-			}
+		stats input_stats;
+		if(analyze_mesh)
+		{
+			_analyze(mesh, VERTEX_CACHE_SIZE, _time_stamps, _live_counts, input_stats);
+		}
 
-			// Copy unique vertices to result
-			mesh.vertices = _temp_vertices;
-			// Elements are already updated
+		if(flags & flag_remove_unused_vertices)
+		{
+			_reorder_vertices_by_first_use(mesh);
 		}
 
 		if(flags & flag_weld_vertices_exact)
@@ -91,20 +125,32 @@ namespace tess
 			_temp_elements.clear();
 			_temp_elements.resize(mesh.vertices.size());
 			// Quickly determine if, for a given vertex, already exists another with the exact same attributes
-			// key = vertex
-			// value = final vertex index (final element value to point to corresponding vertex)
-			std::unordered_map<vertex, element> hashTable;
+			// open addressing with linear probing, kept at most half full: each slot holds the final index of a unique vertex (i.e. its position in _temp_vertices)
+			unsigned int slot_count = 16;
+			while(slot_count < mesh.vertices.size() * 2)
+			{
+				slot_count *= 2;
+			}
+			const auto slot_mask = slot_count - 1;
+			_hash_slots.assign(slot_count, INVALID_ELEMENT);
 
 			for(unsigned int i = 0; i < mesh.vertices.size(); ++i)
 			{
 				const auto& v = mesh.vertices[i];
-				// Get position where vertex will be inserted if it is unique (i.e. the new element value)
-				auto pos = static_cast<element>(_temp_vertices.size());
-				auto ret = hashTable.emplace(v, pos);
+				auto slot = static_cast<unsigned int>(vertex_hash::of_vertex(v)) & slot_mask;
 
-				// If vertex was successfully inserted in hash table (i.e. is a unique vertex)
-				if(ret.second)
+				// Stop at the first empty slot or at a vertex with the same attributes
+				while(_hash_slots[slot] != INVALID_ELEMENT && !(_temp_vertices[_hash_slots[slot]] == v))
 				{
+					slot = (slot + 1) & slot_mask;
+				}
+
+				// If vertex is not in hash table (i.e. is a unique vertex)
+				if(_hash_slots[slot] == INVALID_ELEMENT)
+				{
+					// Get position where vertex will be inserted (i.e. the new element value)
+					auto pos = static_cast<element>(_temp_vertices.size());
+					_hash_slots[slot] = pos;
 					// Save unique vertex
 					_temp_vertices.push_back(v);
 					// Save new element value in cross-reference table
@@ -113,7 +159,7 @@ namespace tess
 				else
 				{
 					// Save exising element value in cross-reference table
-					_temp_elements[i] = ret.first->second;
+					_temp_elements[i] = _hash_slots[slot];
 				}
 			}
 
@@ -127,8 +173,52 @@ namespace tess
 			}
 		}
 
+		weld_stats welded;
+
+		if(flags & flag_weld_vertices_nearby)
+		{
+			_weld_vertices_nearby(mesh, welded);
+			_weld_stats += welded;
+
+			// vertices used only by collapsed triangles are left behind
+			if((flags & flag_remove_unused_vertices) && welded.removed_triangles > 0)
+			{
+				_reorder_vertices_by_first_use(mesh);
+			}
+		}
+
+		// overdraw ordering moves whole vertex cache clusters, so it needs the cache pass to find them
+		if(flags & (flag_optimize_vertex_cache | flag_optimize_overdraw))
+		{
+			_optimize_vertex_cache(mesh, (flags & flag_optimize_overdraw) != 0);
+		}
+
+		// done last, as it follows the final triangle order
+		if(flags & flag_optimize_vertex_fetch)
+		{
+			_reorder_vertices_by_first_use(mesh);
+		}
+
+		stats output_stats;
+		if(analyze_mesh)
+		{
+			_analyze(mesh, VERTEX_CACHE_SIZE, _time_stamps, _live_counts, output_stats);
+			_input_stats += input_stats;
+			_output_stats += output_stats;
+		}
+
 		if(flags & flag_check_results)
 		{
+			if(flags & flag_weld_vertices_nearby)
+			{
+				std::cout << "tess::mesh_optimizer: welded " << welded.removed_vertices << " nearby vertices and collapsed " << welded.removed_triangles <<
+				" triangles in " << welded.msec << " ms" << std::endl;
+			}
+
+			std::cout << "tess::mesh_optimizer: " << output_stats.triangles << " triangles, ACMR " << input_stats.acmr() << " -> " << output_stats.acmr() <<
+			", ATVR " << input_stats.atvr() << " -> " << output_stats.atvr() << ", overfetch " << input_stats.overfetch() << " -> " <<
+			output_stats.overfetch() << std::endl;
+
 			unsigned int ndup = 0;
 
 			for(unsigned int i = 0; i < mesh.vertices.size(); ++i)
@@ -169,4 +259,442 @@ namespace tess
 			}
 		}
 	}
+
+	const mesh_optimizer::stats& mesh_optimizer::get_input_stats() const
+	{
+		return _input_stats;
+	}
+
+	const mesh_optimizer::stats& mesh_optimizer::get_output_stats() const
+	{
+		return _output_stats;
+	}
+
+	const mesh_optimizer::weld_stats& mesh_optimizer::get_weld_stats() const
+	{
+		return _weld_stats;
+	}
+
+	void mesh_optimizer::reset_stats()
+	{
+		_input_stats = stats();
+		_output_stats = stats();
+		_weld_stats = weld_stats();
+	}
+
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+	// private
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	void mesh_optimizer::_reorder_vertices_by_first_use(triangle_mesh& mesh)
+	{
+		// Store vertices that are actually referenced by an element
+		_temp_vertices.clear();
+		_temp_vertices.reserve(mesh.vertices.size());
+
+		// Element cross-reference table: for a given element of incoming value X, what is its updated value Y?
+		_temp_elements.clear();
+		_temp_elements.resize(mesh.vertices.size());
+		std::fill(std::begin(_temp_elements), std::end(_temp_elements), INVALID_ELEMENT);
+
+		for(unsigned int i = 0; i < mesh.elements.size(); ++i)
+		{
+			auto e = mesh.elements[i];
+
+			// If its the first time we encounter this element value
+			if(_temp_elements[e] == INVALID_ELEMENT)
+			{
+				// Get position where corresponding vertex will be inserted (i.e. the new element value)
+				auto pos = static_cast<element>(_temp_vertices.size());
+				// Save vertex
+				_temp_vertices.push_back(mesh.vertices[e]);
+				// Update element value
+				mesh.elements[i] = pos;
+				// Save new element value in cross-reference table
+				_temp_elements[e] = pos;
+			}
+			else
+			{
+				// We already encontered this element value, just update to its new value using cross-reference table
+				mesh.elements[i] = _temp_elements[e];
+			}
+		}
+
+		// Copy unique vertices to result
+		mesh.vertices = _temp_vertices;
+		// Elements are already updated
+	}
+
+	void mesh_optimizer::_analyze(const triangle_mesh& mesh, unsigned int cache_size, std::vector<unsigned int>& vertex_stamps,
+								  std::vector<unsigned int>& line_stamps, stats& s)
+	{
+		if(mesh.vertices.empty())
+		{
+			return;
+		}
+
+		// FIFO caches: an entry is cached while fewer than cache size misses happened since it was stamped (stamp 0 = never loaded)
+		vertex_stamps.assign(mesh.vertices.size(), 0);
+		line_stamps.assign((mesh.vertices.size() * sizeof(vertex) + FETCH_LINE_SIZE - 1) / FETCH_LINE_SIZE, 0);
+		unsigned int vertex_misses = 0;
+		unsigned int line_misses = 0;
+
+		for(auto e : mesh.elements)
+		{
+			if(e >= mesh.vertices.size())
+			{
+				continue;
+			}
+
+			if(vertex_stamps[e] != 0 && vertex_misses - vertex_stamps[e] < cache_size)
+			{
+				continue;
+			}
+
+			vertex_stamps[e] = ++vertex_misses;
+
+			// a transformed vertex is fetched from memory, possibly spanning two lines
+			const auto first_line = e * sizeof(vertex) / FETCH_LINE_SIZE;
+			const auto last_line = ((e + 1) * sizeof(vertex) - 1) / FETCH_LINE_SIZE;
+
+			for(auto l = first_line; l <= last_line; ++l)
+			{
+				if(line_stamps[l] != 0 && line_misses - line_stamps[l] < FETCH_CACHE_LINES)
+				{
+					continue;
+				}
+
+				line_stamps[l] = ++line_misses;
+			}
+		}
+
+		unsigned int referenced = 0;
+		for(auto stamp : vertex_stamps)
+		{
+			referenced += stamp != 0? 1 : 0;
+		}
+
+		s.triangles += mesh.elements.size() / 3;
+		s.vertices += referenced;
+		s.transformed_vertices += vertex_misses;
+		s.vertex_bytes += referenced * sizeof(vertex);
+		s.fetched_bytes += static_cast<unsigned long long>(line_misses) * FETCH_LINE_SIZE;
+	}
+
+	void mesh_optimizer::_weld_vertices_nearby(triangle_mesh& mesh, weld_stats& s)
+	{
+		const auto start = std::chrono::steady_clock::now();
+
+		// cells are as wide as the distance tolerance, so any vertex close enough lies in one of the 27 cells around a position
+		// grid coordinates are packed into 21 bits each: wrapping around only adds candidates, which are then rejected by the distance test
+		const auto cell_of = [this](const vec3& p)
+		{
+			return i64vec3(floor(dvec3(p) / static_cast<double>(_weld_distance)));
+		};
+		const auto cell_key = [](const i64vec3& c)
+		{
+			const unsigned long long mask = (1ULL << 21) - 1;
+			return (static_cast<unsigned long long>(c.x) & mask) | ((static_cast<unsigned long long>(c.y) & mask) << 21) |
+				   ((static_cast<unsigned long long>(c.z) & mask) << 42);
+		};
+
+		// open addressing with linear probing over occupied cells, kept at most half full like the table of exact welding
+		unsigned int slot_count = 16;
+		while(slot_count < mesh.vertices.size() * 2)
+		{
+			slot_count *= 2;
+		}
+		const auto slot_mask = slot_count - 1;
+		_weld_cells.assign(slot_count, weld_cell());
+
+		// slot of a cell, or the empty slot where it would be inserted
+		const auto find_slot = [this, slot_mask](unsigned long long key)
+		{
+			auto slot = static_cast<unsigned int>(vertex_hash::finalize(key)) & slot_mask;
+			while(_weld_cells[slot].first != INVALID_ELEMENT && _weld_cells[slot].key != key)
+			{
+				slot = (slot + 1) & slot_mask;
+			}
+			return slot;
+		};
+
+		// welded vertices: the first vertex found in a neighbourhood keeps its attributes
+		_temp_vertices.clear();
+		_temp_vertices.reserve(mesh.vertices.size());
+		_temp_elements.resize(mesh.vertices.size());
+		_weld_next.clear();
+
+		const auto max_distance2 = _weld_distance * _weld_distance;
+
+		for(unsigned int i = 0; i < mesh.vertices.size(); ++i)
+		{
+			const auto& v = mesh.vertices[i];
+			const auto cell = cell_of(v.position);
+			auto found = INVALID_ELEMENT;
+
+			for(long long z = -1; z <= 1 && found == INVALID_ELEMENT; ++z)
+			{
+				for(long long y = -1; y <= 1 && found == INVALID_ELEMENT; ++y)
+				{
+					for(long long x = -1; x <= 1 && found == INVALID_ELEMENT; ++x)
+					{
+						const auto& c = _weld_cells[find_slot(cell_key(cell + i64vec3(x, y, z)))];
+						for(auto w = c.first; w != INVALID_ELEMENT; w = _weld_next[w])
+						{
+							const auto& other = _temp_vertices[w];
+							const auto d = other.position - v.position;
+
+							if(dot(d, d) <= max_distance2 && dot(other.normal, v.normal) >= _weld_min_cos)
+							{
+								found = w;
+								break;
+							}
+						}
+					}
+				}
+			}
+
+			if(found == INVALID_ELEMENT)
+			{
+				found = static_cast<element>(_temp_vertices.size());
+				_temp_vertices.push_back(v);
+
+				// push to the front of its cell, an empty slot has no vertex in front of it
+				const auto key = cell_key(cell);
+				auto& c = _weld_cells[find_slot(key)];
+				c.key = key;
+				_weld_next.push_back(c.first);
+				c.first = found;
+			}
+
+			_temp_elements[i] = found;
+		}
+
+		s.removed_vertices += mesh.vertices.size() - _temp_vertices.size();
+		mesh.vertices = _temp_vertices;
+
+		// translate elements and drop triangles that collapsed into a line or a point
+		unsigned int kept = 0;
+
+		for(unsigned int i = 0; i + 2 < mesh.elements.size(); i += 3)
+		{
+			const auto a = _temp_elements[mesh.elements[i]];
+			const auto b = _temp_elements[mesh.elements[i + 1]];
+			const auto c = _temp_elements[mesh.elements[i + 2]];
+
+			if(a == b || b == c || a == c)
+			{
+				++s.removed_triangles;
+				continue;
+			}
+
+			mesh.elements[kept++] = a;
+			mesh.elements[kept++] = b;
+			mesh.elements[kept++] = c;
+		}
+
+		mesh.elements.resize(kept);
+
+		s.msec += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	void mesh_optimizer::_optimize_vertex_cache(triangle_mesh& mesh, bool sort_clusters)
+	{
+		// Tipsify: Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw", 2007
+		// fan around one vertex at a time, then continue from a vertex of the last fans that will still be in the cache after its own fan
+		const unsigned int vertex_count = mesh.vertices.size();
+		const unsigned int triangle_count = mesh.elements.size() / 3;
+		const unsigned int cache_size = VERTEX_CACHE_SIZE;
+
+		// triangles adjacent to each vertex
+		_live_counts.assign(vertex_count, 0);
+		for(unsigned int i = 0; i < triangle_count * 3; ++i)
+		{
+			++_live_counts[mesh.elements[i]];
+		}
+
+		_adjacency_offsets.resize(vertex_count + 1);
+		_adjacency_offsets[0] = 0;
+		for(unsigned int v = 0; v < vertex_count; ++v)
+		{
+			_adjacency_offsets[v + 1] = _adjacency_offsets[v] + _live_counts[v];
+		}
+
+		// time stamps are used as insertion cursors before the actual reordering
+		_time_stamps.assign(_adjacency_offsets.begin(), _adjacency_offsets.end() - 1);
+		_adjacency.resize(triangle_count * 3);
+		for(unsigned int i = 0; i < triangle_count * 3; ++i)
+		{
+			_adjacency[_time_stamps[mesh.elements[i]]++] = i / 3;
+		}
+
+		_time_stamps.assign(vertex_count, 0);
+		_emitted.assign(triangle_count, false);
+		_dead_ends.clear();
+		_temp_elements.clear();
+		_temp_elements.reserve(triangle_count * 3);
+		_cluster_starts.assign(1, 0);
+
+		unsigned int time = cache_size + 1;
+		unsigned int scan = 0;
+
+		// next vertex with live triangles, first from the dead-end stack and then in input order
+		auto skip_dead_end = [&]() -> element
+		{
+			while(!_dead_ends.empty())
+			{
+				const auto d = _dead_ends.back();
+				_dead_ends.pop_back();
+				if(_live_counts[d] > 0)
+				{
+					return d;
+				}
+			}
+
+			for(; scan < vertex_count; ++scan)
+			{
+				if(_live_counts[scan] > 0)
+				{
+					return scan;
+				}
+			}
+
+			return INVALID_ELEMENT;
+		};
+
+		auto fanning = skip_dead_end();
+
+		while(fanning != INVALID_ELEMENT)
+		{
+			// emit all remaining triangles around the fanning vertex, their vertices become candidates for the next one
+			const auto first_candidate = _dead_ends.size();
+
+			for(unsigned int a = _adjacency_offsets[fanning]; a < _adjacency_offsets[fanning + 1]; ++a)
+			{
+				const auto t = _adjacency[a];
+				if(_emitted[t])
+				{
+					continue;
+				}
+
+				for(unsigned int k = 0; k < 3; ++k)
+				{
+					const auto v = mesh.elements[t * 3 + k];
+					_temp_elements.push_back(v);
+					_dead_ends.push_back(v);
+					--_live_counts[v];
+
+					if(time - _time_stamps[v] > cache_size)
+					{
+						_time_stamps[v] = time++;
+					}
+				}
+
+				_emitted[t] = true;
+			}
+
+			// prefer the oldest candidate that stays in the cache while its own remaining triangles are emitted
+			auto next = INVALID_ELEMENT;
+			int best_priority = -1;
+
+			for(auto c = first_candidate; c < _dead_ends.size(); ++c)
+			{
+				const auto v = _dead_ends[c];
+				if(_live_counts[v] == 0)
+				{
+					continue;
+				}
+
+				int priority = 0;
+				if(time - _time_stamps[v] + 2 * _live_counts[v] <= cache_size)
+				{
+					priority = time - _time_stamps[v];
+				}
+
+				if(priority > best_priority)
+				{
+					best_priority = priority;
+					next = v;
+				}
+			}
+
+			// dead end: locality is lost, so this is where a new cluster starts
+			if(next == INVALID_ELEMENT)
+			{
+				next = skip_dead_end();
+				if(next != INVALID_ELEMENT)
+				{
+					_cluster_starts.push_back(_temp_elements.size() / 3);
+				}
+			}
+
+			fanning = next;
+		}
+
+		std::copy(_temp_elements.begin(), _temp_elements.end(), mesh.elements.begin());
+
+		if(sort_clusters)
+		{
+			_sort_clusters(mesh);
+		}
+	}
+
+	void mesh_optimizer::_sort_clusters(triangle_mesh& mesh)
+	{
+		// viewpoint independent approximation: clusters facing away from the mesh centre tend to occlude the others, so they go first
+		const unsigned int triangle_count = mesh.elements.size() / 3;
+		const unsigned int cluster_count = _cluster_starts.size();
+
+		if(cluster_count < 2)
+		{
+			return;
+		}
+
+		vec3 mesh_center(0.0f);
+		for(unsigned int i = 0; i < triangle_count * 3; ++i)
+		{
+			mesh_center += mesh.vertices[mesh.elements[i]].position;
+		}
+		mesh_center /= static_cast<float>(triangle_count * 3);
+
+		_cluster_keys.resize(cluster_count);
+		_cluster_order.resize(cluster_count);
+
+		for(unsigned int c = 0; c < cluster_count; ++c)
+		{
+			const auto first = _cluster_starts[c];
+			const auto last = c + 1 < cluster_count? _cluster_starts[c + 1] : triangle_count;
+
+			vec3 center(0.0f);
+			vec3 normal(0.0f);
+
+			for(auto t = first; t < last; ++t)
+			{
+				const auto& p0 = mesh.vertices[mesh.elements[t * 3 + 0]].position;
+				const auto& p1 = mesh.vertices[mesh.elements[t * 3 + 1]].position;
+				const auto& p2 = mesh.vertices[mesh.elements[t * 3 + 2]].position;
+				center += p0 + p1 + p2;
+				normal += cross(p1 - p0, p2 - p0); // area weighted
+			}
+
+			center /= static_cast<float>((last - first) * 3);
+			const auto normal_length = length(normal);
+
+			_cluster_keys[c] = normal_length > 0.0f? dot(center - mesh_center, normal / normal_length) : 0.0f;
+			_cluster_order[c] = c;
+		}
+
+		std::stable_sort(_cluster_order.begin(), _cluster_order.end(), [this](unsigned int a, unsigned int b){ return _cluster_keys[a] > _cluster_keys[b]; });
+
+		_temp_elements.clear();
+
+		for(auto c : _cluster_order)
+		{
+			const auto first = _cluster_starts[c];
+			const auto last = c + 1 < cluster_count? _cluster_starts[c + 1] : triangle_count;
+			_temp_elements.insert(_temp_elements.end(), mesh.elements.begin() + first * 3, mesh.elements.begin() + last * 3);
+		}
+
+		std::copy(_temp_elements.begin(), _temp_elements.end(), mesh.elements.begin());
+	}
 } // namespace tess
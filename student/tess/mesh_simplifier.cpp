@@ -0,0 +1,584 @@
+#include <tess/mesh_simplifier.h>
+#include <tess/vertex_hash.h>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace tess
+{
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// global constants
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	static const element INVALID_ELEMENT = std::numeric_limits<element>::max();
+
+	// planes through borders and hard edges weigh more than faces, so their silhouette is the last thing to go
+	static const double CONSTRAINT_WEIGHT = 10.0;
+
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// helpers
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	template<typename Quadric>
+	static void add_plane(Quadric& q, const dvec3& n, double d, double weight)
+	{
+		q.a00 += weight * n.x * n.x;
+		q.a01 += weight * n.x * n.y;
+		q.a02 += weight * n.x * n.z;
+		q.a11 += weight * n.y * n.y;
+		q.a12 += weight * n.y * n.z;
+		q.a22 += weight * n.z * n.z;
+		q.b0 += weight * n.x * d;
+		q.b1 += weight * n.y * d;
+		q.b2 += weight * n.z * d;
+		q.c += weight * d * d;
+		q.w += weight;
+	}
+
+	template<typename Quadric>
+	static void add_quadric(Quadric& q, const Quadric& other)
+	{
+		q.a00 += other.a00;
+		q.a01 += other.a01;
+		q.a02 += other.a02;
+		q.a11 += other.a11;
+		q.a12 += other.a12;
+		q.a22 += other.a22;
+		q.b0 += other.b0;
+		q.b1 += other.b1;
+		q.b2 += other.b2;
+		q.c += other.c;
+		q.w += other.w;
+	}
+
+	// weighted mean of squared distances from p to the planes of both quadrics
+	template<typename Quadric>
+	static double evaluate(const Quadric& q, const Quadric& r, const dvec3& p)
+	{
+		const auto a00 = q.a00 + r.a00, a01 = q.a01 + r.a01, a02 = q.a02 + r.a02;
+		const auto a11 = q.a11 + r.a11, a12 = q.a12 + r.a12, a22 = q.a22 + r.a22;
+		const auto b0 = q.b0 + r.b0, b1 = q.b1 + r.b1, b2 = q.b2 + r.b2;
+		const auto w = q.w + r.w;
+
+		const auto e = a00 * p.x * p.x + a11 * p.y * p.y + a22 * p.z * p.z +
+					   2.0 * (a01 * p.x * p.y + a02 * p.x * p.z + a12 * p.y * p.z + b0 * p.x + b1 * p.y + b2 * p.z) + q.c + r.c;
+
+		return w > 0.0? std::max(e, 0.0) / w : 0.0;
+	}
+
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// public
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	float mesh_simplifier::simplify(triangle_mesh& mesh, unsigned int target_triangle_count, float max_error /*= std::numeric_limits<float>::max()*/)
+	{
+		_begin(mesh);
+		const auto error = _collapse_until(target_triangle_count, max_error);
+		_extract(mesh);
+		return error;
+	}
+
+	void mesh_simplifier::simplify_lods(const triangle_mesh& mesh, unsigned int lod_count, float ratio, float max_error,
+										std::vector<triangle_mesh>& lods, std::vector<float>& errors)
+	{
+		if(lod_count == 0 || !(ratio > 0.0f && ratio <= 1.0f))
+		{
+			throw std::invalid_argument("tess::mesh_simplifier requires at least one level of detail and a ratio in (0, 1].");
+		}
+
+		lods.resize(lod_count);
+		errors.resize(lod_count);
+
+		lods.back().vertices.assign(mesh.vertices.begin(), mesh.vertices.end());
+		lods.back().elements.assign(mesh.elements.begin(), mesh.elements.end());
+		errors.back() = 0.0f;
+
+		_begin(mesh);
+		auto target = static_cast<float>(mesh.elements.size() / 3);
+
+		for(auto lod = static_cast<int>(lod_count) - 2; lod >= 0; --lod)
+		{
+			target *= ratio;
+			errors[lod] = _collapse_until(static_cast<unsigned int>(target), max_error);
+			_extract(lods[lod]);
+		}
+	}
+
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// private
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	void mesh_simplifier::_begin(const triangle_mesh& mesh)
+	{
+		const unsigned int vertex_count = mesh.vertices.size();
+		_vertices.assign(mesh.vertices.begin(), mesh.vertices.end());
+		_max_cost = 0.0;
+
+		// 1- group vertices by position: open addressing table holding the first vertex of each group
+		unsigned int slot_count = 16;
+		while(slot_count < vertex_count * 2)
+		{
+			slot_count *= 2;
+		}
+		const auto slot_mask = slot_count - 1;
+		_hash_slots.assign(slot_count, INVALID_ELEMENT);
+		_group_of.resize(vertex_count);
+		_group_count = 0;
+
+		// group ids are stored in the slots next to their vertex, reusing _remap as the id of each first vertex
+		_remap.resize(vertex_count);
+
+		for(unsigned int v = 0; v < vertex_count; ++v)
+		{
+			const auto& p = _vertices[v].position;
+			auto slot = static_cast<unsigned int>(vertex_hash::of_position(p)) & slot_mask;
+
+			while(_hash_slots[slot] != INVALID_ELEMENT && !(_vertices[_hash_slots[slot]].position == p))
+			{
+				slot = (slot + 1) & slot_mask;
+			}
+
+			if(_hash_slots[slot] == INVALID_ELEMENT)
+			{
+				_hash_slots[slot] = v;
+				_remap[v] = _group_count++;
+			}
+
+			_group_of[v] = _remap[_hash_slots[slot]];
+		}
+
+		// 2- vertices of each group, in offset/list form
+		_group_offsets.assign(_group_count + 1, 0);
+		for(unsigned int v = 0; v < vertex_count; ++v)
+		{
+			++_group_offsets[_group_of[v] + 1];
+		}
+		for(unsigned int g = 0; g < _group_count; ++g)
+		{
+			_group_offsets[g + 1] += _group_offsets[g];
+		}
+
+		_stamps.assign(_group_offsets.begin(), _group_offsets.end() - 1);
+		_group_vertices.resize(vertex_count);
+		for(unsigned int v = 0; v < vertex_count; ++v)
+		{
+			_group_vertices[_stamps[_group_of[v]]++] = v;
+		}
+
+		// 3- keep triangles with three distinct positions
+		_elements.clear();
+		_elements.reserve(mesh.elements.size());
+
+		for(unsigned int i = 0; i + 2 < mesh.elements.size(); i += 3)
+		{
+			const auto a = mesh.elements[i], b = mesh.elements[i + 1], c = mesh.elements[i + 2];
+
+			if(a >= vertex_count || b >= vertex_count || c >= vertex_count ||
+			   _group_of[a] == _group_of[b] || _group_of[b] == _group_of[c] || _group_of[a] == _group_of[c])
+			{
+				continue;
+			}
+
+			_elements.push_back(a);
+			_elements.push_back(b);
+			_elements.push_back(c);
+		}
+
+		// 4- quadrics: planes of adjacent triangles weighted by area
+		_quadrics.assign(_group_count, quadric());
+
+		for(unsigned int i = 0; i < _elements.size(); i += 3)
+		{
+			const dvec3 p0(_vertices[_elements[i]].position);
+			const dvec3 p1(_vertices[_elements[i + 1]].position);
+			const dvec3 p2(_vertices[_elements[i + 2]].position);
+
+			auto n = cross(p1 - p0, p2 - p0);
+			const auto len = length(n);
+			if(len <= 0.0)
+			{
+				continue;
+			}
+			n /= len;
+
+			for(unsigned int k = 0; k < 3; ++k)
+			{
+				add_plane(_quadrics[_group_of[_elements[i + k]]], n, -dot(n, p0), len * 0.5);
+			}
+		}
+
+		// 5- constraint planes perpendicular to triangles along borders (sides without a twin) and hard edges (twins with different vertices)
+		_build_edges();
+
+		for(const auto& e : _edges)
+		{
+			const bool border = e.triangle_count == 1;
+			const bool crease = e.triangle_count == 2 && (e.vertices[0][0] != e.vertices[1][0] || e.vertices[0][1] != e.vertices[1][1]);
+
+			if(!border && !crease)
+			{
+				continue;
+			}
+
+			for(unsigned int k = 0; k < e.triangle_count; ++k)
+			{
+				const auto t = e.triangles[k] * 3;
+				const dvec3 p0(_vertices[_elements[t]].position);
+				const dvec3 p1(_vertices[_elements[t + 1]].position);
+				const dvec3 p2(_vertices[_elements[t + 2]].position);
+				const dvec3 pa(_vertices[e.vertices[k][0]].position);
+				const dvec3 pb(_vertices[e.vertices[k][1]].position);
+
+				const auto side = pb - pa;
+				auto n = cross(side, cross(p1 - p0, p2 - p0));
+				const auto len = length(n);
+				if(len <= 0.0)
+				{
+					continue;
+				}
+				n /= len;
+
+				const auto weight = CONSTRAINT_WEIGHT * dot(side, side);
+				add_plane(_quadrics[e.groups[0]], n, -dot(n, pa), weight);
+				add_plane(_quadrics[e.groups[1]], n, -dot(n, pa), weight);
+			}
+		}
+	}
+
+	void mesh_simplifier::_build_edges()
+	{
+		// triangles around each group
+		_triangle_offsets.assign(_group_count + 1, 0);
+		for(auto v : _elements)
+		{
+			++_triangle_offsets[_group_of[v] + 1];
+		}
+		for(unsigned int g = 0; g < _group_count; ++g)
+		{
+			_triangle_offsets[g + 1] += _triangle_offsets[g];
+		}
+
+		_stamps.assign(_triangle_offsets.begin(), _triangle_offsets.end() - 1);
+		_group_triangles.resize(_elements.size());
+		for(unsigned int i = 0; i < _elements.size(); ++i)
+		{
+			_group_triangles[_stamps[_group_of[_elements[i]]]++] = i / 3;
+		}
+
+		// each triangle side is found from its lower group: groups around it are few, so edges are gathered without sorting
+		_edges.clear();
+		_edge_of.resize(_group_count);
+		_stamps.assign(_group_count, 0);
+
+		for(unsigned int ga = 0; ga < _group_count; ++ga)
+		{
+			for(auto i = _triangle_offsets[ga]; i < _triangle_offsets[ga + 1]; ++i)
+			{
+				const auto t = _group_triangles[i];
+
+				for(unsigned int k = 0; k < 3; ++k)
+				{
+					auto a = _elements[t * 3 + k];
+					auto b = _elements[t * 3 + (k + 1) % 3];
+					if(_group_of[a] > _group_of[b])
+					{
+						std::swap(a, b);
+					}
+
+					if(_group_of[a] != ga)
+					{
+						continue;
+					}
+
+					const auto gb = _group_of[b];
+
+					// first side between ga and gb: new edge
+					if(_stamps[gb] != ga + 1)
+					{
+						_stamps[gb] = ga + 1;
+						_edge_of[gb] = _edges.size();
+						_edges.push_back(edge());
+						auto& e = _edges.back();
+						e.groups[0] = ga;
+						e.groups[1] = gb;
+						e.triangle_count = 0;
+					}
+
+					auto& e = _edges[_edge_of[gb]];
+					if(e.triangle_count < 2)
+					{
+						e.triangles[e.triangle_count] = t;
+						e.vertices[e.triangle_count][0] = a;
+						e.vertices[e.triangle_count][1] = b;
+					}
+					++e.triangle_count;
+				}
+			}
+		}
+
+		// border groups may only move along their border, groups on non-manifold edges do not move at all
+		_kinds.assign(_group_count, kind_interior);
+
+		for(const auto& e : _edges)
+		{
+			const auto k = e.triangle_count == 1? kind_border : (e.triangle_count > 2? kind_locked : kind_interior);
+			_kinds[e.groups[0]] = std::max<unsigned char>(_kinds[e.groups[0]], k);
+			_kinds[e.groups[1]] = std::max<unsigned char>(_kinds[e.groups[1]], k);
+		}
+
+		_stamps.assign(_group_count, 0);
+		_stamp = 0;
+	}
+
+	float mesh_simplifier::_collapse_until(unsigned int target_triangle_count, float max_error)
+	{
+		const auto max_cost = static_cast<double>(max_error) * max_error;
+
+		while(_elements.size() / 3 > target_triangle_count)
+		{
+			if(_pass(target_triangle_count, max_cost) == 0)
+			{
+				break;
+			}
+		}
+
+		return static_cast<float>(std::sqrt(_max_cost));
+	}
+
+	unsigned int mesh_simplifier::_pass(unsigned int target_triangle_count, double max_cost)
+	{
+		_build_edges();
+
+		// 1- cheapest valid direction of each edge
+		_collapses.clear();
+
+		for(const auto& e : _edges)
+		{
+			const auto ga = e.groups[0];
+			const auto gb = e.groups[1];
+			const bool border = e.triangle_count == 1;
+			const auto shared = e.triangle_count;
+
+			if(shared > 2)
+			{
+				continue;
+			}
+
+			const auto& pa = _vertices[_group_vertices[_group_offsets[ga]]].position;
+			const auto& pb = _vertices[_group_vertices[_group_offsets[gb]]].position;
+			const bool a_moves = _kinds[ga] == kind_interior || (_kinds[ga] == kind_border && border);
+			const bool b_moves = _kinds[gb] == kind_interior || (_kinds[gb] == kind_border && border);
+
+			if(!a_moves && !b_moves)
+			{
+				continue;
+			}
+
+			const auto cost_ab = a_moves? evaluate(_quadrics[ga], _quadrics[gb], dvec3(pb)) : std::numeric_limits<double>::max();
+			const auto cost_ba = b_moves? evaluate(_quadrics[ga], _quadrics[gb], dvec3(pa)) : std::numeric_limits<double>::max();
+
+			if(cost_ab <= cost_ba)
+			{
+				_collapses.push_back({static_cast<float>(cost_ab), ga, gb, shared});
+			}
+			else
+			{
+				_collapses.push_back({static_cast<float>(cost_ba), gb, ga, shared});
+			}
+		}
+
+		// only the cheapest candidates have a chance in this pass: most of the others end up next to an earlier collapse
+		const unsigned int triangle_excess = _elements.size() / 3 - target_triangle_count;
+		const auto sorted = _collapses.begin() + std::min<size_t>(_collapses.size(), std::max<size_t>(triangle_excess / 2 + 1, _collapses.size() / 4));
+		const auto cheaper = [](const collapse& x, const collapse& y)
+		{
+			return x.cost < y.cost || (x.cost == y.cost && (x.from < y.from || (x.from == y.from && x.to < y.to)));
+		};
+		std::nth_element(_collapses.begin(), sorted, _collapses.end(), cheaper);
+		std::sort(_collapses.begin(), sorted, cheaper);
+		_collapses.erase(sorted, _collapses.end());
+
+		// 2- apply independent collapses in order: groups around a collapse are left alone until the next pass, so adjacency stays valid
+		_touched.assign(_group_count, false);
+		_remap.resize(_vertices.size());
+		for(unsigned int v = 0; v < _remap.size(); ++v)
+		{
+			_remap[v] = v;
+		}
+
+		unsigned int triangle_count = _elements.size() / 3;
+		unsigned int collapse_count = 0;
+
+		for(const auto& c : _collapses)
+		{
+			if(c.cost > max_cost || triangle_count <= target_triangle_count)
+			{
+				break;
+			}
+
+			if(_touched[c.from] || _touched[c.to] || !_is_valid_collapse(c) || !_find_partners(c.from, c.to))
+			{
+				continue;
+			}
+
+			for(const auto& p : _partners)
+			{
+				_remap[p.first] = p.second;
+			}
+
+			for(auto i = _triangle_offsets[c.from]; i < _triangle_offsets[c.from + 1]; ++i)
+			{
+				const auto t = _group_triangles[i] * 3;
+				bool removed = false;
+
+				for(unsigned int k = 0; k < 3; ++k)
+				{
+					const auto g = _group_of[_elements[t + k]];
+					_touched[g] = true;
+					removed = removed || g == c.to;
+				}
+
+				triangle_count -= removed? 1 : 0;
+			}
+
+			add_quadric(_quadrics[c.to], _quadrics[c.from]);
+			_max_cost = std::max(_max_cost, static_cast<double>(c.cost));
+			++collapse_count;
+		}
+
+		// 3- move collapsed vertices and drop triangles that lost an edge
+		unsigned int kept = 0;
+
+		for(unsigned int i = 0; i < _elements.size(); i += 3)
+		{
+			const auto a = _remap[_elements[i]], b = _remap[_elements[i + 1]], c = _remap[_elements[i + 2]];
+
+			if(_group_of[a] == _group_of[b] || _group_of[b] == _group_of[c] || _group_of[a] == _group_of[c])
+			{
+				continue;
+			}
+
+			_elements[kept++] = a;
+			_elements[kept++] = b;
+			_elements[kept++] = c;
+		}
+
+		_elements.resize(kept);
+		return collapse_count;
+	}
+
+	bool mesh_simplifier::_find_partners(unsigned int from, unsigned int to)
+	{
+		// each vertex of from goes to the vertex of to with the closest normal, which must in turn be closest to it:
+		// along a hard edge both sides find their match, across it one side would have to take the normal of the other
+		_partners.clear();
+
+		for(auto i = _group_offsets[from]; i < _group_offsets[from + 1]; ++i)
+		{
+			const auto a = _group_vertices[i];
+			auto best = INVALID_ELEMENT;
+			auto best_dot = -std::numeric_limits<float>::max();
+
+			for(auto j = _group_offsets[to]; j < _group_offsets[to + 1]; ++j)
+			{
+				const auto b = _group_vertices[j];
+				const auto d = dot(_vertices[a].normal, _vertices[b].normal);
+				if(d > best_dot)
+				{
+					best_dot = d;
+					best = b;
+				}
+			}
+
+			for(auto j = _group_offsets[from]; j < _group_offsets[from + 1]; ++j)
+			{
+				if(dot(_vertices[_group_vertices[j]].normal, _vertices[best].normal) > best_dot)
+				{
+					return false;
+				}
+			}
+
+			_partners.push_back(std::make_pair(a, best));
+		}
+
+		return true;
+	}
+
+	bool mesh_simplifier::_is_valid_collapse(const collapse& c)
+	{
+		// link condition: from and to may only share the neighbours opposite to their common edge, otherwise the collapse pinches the surface
+		const auto around_to = ++_stamp;
+		const auto counted = ++_stamp;
+
+		for(auto i = _triangle_offsets[c.to]; i < _triangle_offsets[c.to + 1]; ++i)
+		{
+			const auto t = _group_triangles[i] * 3;
+			for(unsigned int k = 0; k < 3; ++k)
+			{
+				_stamps[_group_of[_elements[t + k]]] = around_to;
+			}
+		}
+
+		unsigned int shared = 0;
+		const dvec3 target(_vertices[_group_vertices[_group_offsets[c.to]]].position);
+
+		for(auto i = _triangle_offsets[c.from]; i < _triangle_offsets[c.from + 1]; ++i)
+		{
+			const auto t = _group_triangles[i] * 3;
+			bool has_to = false;
+
+			for(unsigned int k = 0; k < 3; ++k)
+			{
+				const auto g = _group_of[_elements[t + k]];
+				has_to = has_to || g == c.to;
+
+				if(g != c.from && g != c.to && _stamps[g] == around_to)
+				{
+					_stamps[g] = counted;
+					++shared;
+				}
+			}
+
+			// remaining triangles must not flip or collapse when from moves onto to
+			if(!has_to)
+			{
+				dvec3 p[3];
+				dvec3 q[3];
+				for(unsigned int k = 0; k < 3; ++k)
+				{
+					p[k] = dvec3(_vertices[_elements[t + k]].position);
+					q[k] = _group_of[_elements[t + k]] == c.from? target : p[k];
+				}
+
+				const auto before = cross(p[1] - p[0], p[2] - p[0]);
+				const auto after = cross(q[1] - q[0], q[2] - q[0]);
+				if(dot(before, after) <= 0.0)
+				{
+					return false;
+				}
+			}
+		}
+
+		return shared <= c.shared_triangles;
+	}
+
+	void mesh_simplifier::_extract(triangle_mesh& mesh)
+	{
+		// keep referenced vertices in order of first use
+		_remap.assign(_vertices.size(), INVALID_ELEMENT);
+		mesh.vertices.clear();
+		mesh.elements.resize(_elements.size());
+
+		for(unsigned int i = 0; i < _elements.size(); ++i)
+		{
+			const auto v = _elements[i];
+			if(_remap[v] == INVALID_ELEMENT)
+			{
+				_remap[v] = mesh.vertices.size();
+				mesh.vertices.push_back(_vertices[v]);
+			}
+
+			mesh.elements[i] = _remap[v];
+		}
+	}
+} // namespace tess
@@ -0,0 +1,142 @@
+#include <tess/meshlet_builder.h>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace tess
+{
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+	// unit normal of the triangle at elements[0..2] in front-face (counter-clockwise) order, zero for degenerate triangles
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	static vec3 face_normal(const vertex* vertices, const element* elements)
+	{
+		const auto& p0 = vertices[elements[0]].position;
+		const auto n = cross(vertices[elements[1]].position - p0, vertices[elements[2]].position - p0);
+		const auto len = length(n);
+		return len > 0.0f? n / len : vec3(0.0f);
+	}
+
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+	// meshlet_builder
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	meshlet_builder::meshlet_builder(unsigned int max_triangles /*= 128*/, unsigned int min_triangles /*= 64*/, float max_normal_angle /*= 1.0f*/)
+	{
+		if(max_triangles == 0 || min_triangles > max_triangles)
+		{
+			throw std::invalid_argument("Triangle limits of tess::meshlet_builder must satisfy 0 < min_triangles <= max_triangles.");
+		}
+
+		if(!(max_normal_angle >= 0.0f))
+		{
+			throw std::invalid_argument("Normal angle of tess::meshlet_builder must not be negative.");
+		}
+
+		_max_triangles = max_triangles;
+		_min_triangles = min_triangles;
+		_min_cos = std::cos(max_normal_angle);
+	}
+
+	void meshlet_builder::build(const vertex* vertices, const element* elements, unsigned int element_count, std::vector<meshlet>& result) const
+	{
+		meshlet current;
+		current.first_element = 0;
+		current.element_count = 0;
+		vec3 normal_sum(0.0f);
+
+		for(unsigned int e = 0; e + 2 < element_count; e += 3)
+		{
+			const auto n = face_normal(vertices, elements + e);
+			const auto triangles = current.element_count / 3;
+
+			// close the current meshlet when it is full, or when it is large enough and this triangle would widen its normal cone too much
+			bool split = triangles == _max_triangles;
+			if(!split && triangles >= _min_triangles && n != vec3(0.0f))
+			{
+				const auto len = length(normal_sum);
+				split = len > 0.0f && dot(n, normal_sum / len) < _min_cos;
+			}
+
+			if(split)
+			{
+				_finish(vertices, elements, current);
+				result.push_back(current);
+				current.first_element = e;
+				current.element_count = 0;
+				normal_sum = vec3(0.0f);
+			}
+
+			current.element_count += 3;
+			normal_sum += n;
+		}
+
+		if(current.element_count > 0)
+		{
+			_finish(vertices, elements, current);
+			result.push_back(current);
+		}
+	}
+
+	void meshlet_builder::build(const triangle_mesh& mesh, std::vector<meshlet>& result) const
+	{
+		build(mesh.vertices.data(), mesh.elements.data(), mesh.elements.size(), result);
+	}
+
+	void meshlet_builder::_finish(const vertex* vertices, const element* elements, meshlet& m) const
+	{
+		const auto first = elements + m.first_element;
+		const auto last = first + m.element_count;
+
+		// sphere around the center of the bounding box
+		vec3 min_corner(std::numeric_limits<float>::max());
+		vec3 max_corner(-std::numeric_limits<float>::max());
+		vec3 normal_sum(0.0f);
+
+		for(auto e = first; e != last; e += 3)
+		{
+			for(unsigned int i = 0; i < 3; ++i)
+			{
+				min_corner = min(min_corner, vertices[e[i]].position);
+				max_corner = max(max_corner, vertices[e[i]].position);
+			}
+
+			normal_sum += face_normal(vertices, e);
+		}
+
+		m.center = (min_corner + max_corner) * 0.5f;
+		m.radius = 0.0f;
+
+		for(auto e = first; e != last; ++e)
+		{
+			m.radius = max(m.radius, distance(m.center, vertices[*e].position));
+		}
+
+		// cone around the average normal, open (cutoff 1) when triangles may face any direction
+		m.cone_axis = vec3(0.0f, 0.0f, 1.0f);
+		m.cone_cutoff = 1.0f;
+
+		const auto len = length(normal_sum);
+		if(len <= 0.0f)
+		{
+			return;
+		}
+
+		m.cone_axis = normal_sum / len;
+
+		float min_dot = 1.0f;
+		for(auto e = first; e != last; e += 3)
+		{
+			const auto n = face_normal(vertices, e);
+			if(n != vec3(0.0f))
+			{
+				min_dot = min(min_dot, dot(n, m.cone_axis));
+			}
+		}
+
+		if(min_dot > 0.0f)
+		{
+			m.cone_cutoff = std::sqrt(1.0f - min_dot * min_dot);
+		}
+	}
+} // namespace tess
@@ -0,0 +1,46 @@
+#pragma once
+#include <tess/triangle_mesh.h>
+
+namespace tess
+{
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// meshlet: consecutive triangles of a mesh that are culled together
+	// bounds and cone are in the space of the mesh vertices
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	struct meshlet
+	{
+		unsigned int first_element; // relative to the first element given to meshlet_builder::build
+		unsigned int element_count;
+
+		vec3 center; // bounding sphere
+		float radius;
+
+		// normal cone: every triangle faces away from a viewer at p if dot(center - p, cone_axis) >= cone_cutoff * length(center - p) + radius
+		// cone_cutoff is the sine of the largest angle between cone_axis and a triangle normal, 1 when triangles may face any direction
+		vec3 cone_axis;
+		float cone_cutoff;
+	};
+
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// meshlet_builder: splits meshes into meshlets without reordering their triangles
+	// meshes optimized for the vertex cache already draw neighbouring triangles together, so consecutive triangles make compact meshlets
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	class meshlet_builder
+	{
+	public:
+		// meshlets hold at most max_triangles; once a meshlet holds min_triangles, a triangle whose normal is more than max_normal_angle (radians)
+		// away from the average normal of the meshlet starts a new one, which keeps normal cones narrow enough for back-face culling
+		explicit meshlet_builder(unsigned int max_triangles = 128, unsigned int min_triangles = 64, float max_normal_angle = 1.0f);
+
+		// append meshlets covering all triangles of elements to result
+		void build(const vertex* vertices, const element* elements, unsigned int element_count, std::vector<meshlet>& result) const;
+		void build(const triangle_mesh& mesh, std::vector<meshlet>& result) const;
+
+	private:
+		void _finish(const vertex* vertices, const element* elements, meshlet& m) const;
+
+		unsigned int _max_triangles;
+		unsigned int _min_triangles;
+		float _min_cos;
+	};
+} // namespace tess
@@ -1,10 +1,61 @@
 #include <tess/polygon_tessellator.h>
 #include <tess/mesh_builder.h>
 #include <tess/glutess/glutess_facade.h>
+#include <cmath>
 #include <cstring>
+#include <new>
 
 namespace tess
 {
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+	// global constants
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	// polygons whose projected area is below this fraction of their squared extent are left to glutess (edge-on to their normals or degenerate)
+	static const float MIN_RELATIVE_AREA = 1.0e-6f;
+
+	// ear clipping and its simplicity test are quadratic, longer contours are left to glutess
+	static const unsigned int MAX_EAR_CLIPPING_POINTS = 64;
+
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+	// 2D predicates
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	// twice the signed area of triangle abc, positive when counter-clockwise
+	static float orient(const vec2& a, const vec2& b, const vec2& c)
+	{
+		return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+	}
+
+	// p is on the closed segment ab, given that it is on its supporting line
+	static bool on_segment(const vec2& a, const vec2& b, const vec2& p)
+	{
+		return min(a.x, b.x) <= p.x && p.x <= max(a.x, b.x) && min(a.y, b.y) <= p.y && p.y <= max(a.y, b.y);
+	}
+
+	// closed segments ab and cd share at least one point
+	static bool segments_touch(const vec2& a, const vec2& b, const vec2& c, const vec2& d)
+	{
+		const auto d1 = orient(c, d, a);
+		const auto d2 = orient(c, d, b);
+		const auto d3 = orient(a, b, c);
+		const auto d4 = orient(a, b, d);
+
+		if(((d1 > 0.0f && d2 < 0.0f) || (d1 < 0.0f && d2 > 0.0f)) && ((d3 > 0.0f && d4 < 0.0f) || (d3 < 0.0f && d4 > 0.0f)))
+		{
+			return true;
+		}
+
+		return (d1 == 0.0f && on_segment(c, d, a)) || (d2 == 0.0f && on_segment(c, d, b)) ||
+			   (d3 == 0.0f && on_segment(a, b, c)) || (d4 == 0.0f && on_segment(a, b, d));
+	}
+
+	// p is inside or on the border of triangle abc, whose orientation has the sign of o
+	static bool in_triangle(const vec2& a, const vec2& b, const vec2& c, const vec2& p, float o)
+	{
+		return orient(a, b, p) * o >= 0.0f && orient(b, c, p) * o >= 0.0f && orient(c, a, p) * o >= 0.0f;
+	}
+
 	//----------------------------------------------------------------------------------------------------------------------------------------------------------
 	// Hidden implementation
 	//----------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -20,14 +71,28 @@ namespace tess
 
 		void addPolygon(const polygon& poly);
 
+		void addPolygon(const polygon_view& poly);
+
 		triangle_mesh end();
 
+		void end(mesh_sink& sink);
+
 		void begin(unsigned int type);
 
 		void vertex(void* vertex_data);
 
 		void combine(double coords[3], void* vertex_data[4], float weight[4], void** out_data);
 
+		bool triangulate_contour(const point* points, unsigned int count, element first);
+
+		bool project(const point* points, unsigned int count);
+
+		bool is_convex() const;
+
+		bool is_simple() const;
+
+		bool clip_ears(element first);
+
 		static void beginCB(unsigned int type, void* user_data);
 
 		static void vertexCB(void* vertex_data, void* user_data);
@@ -36,8 +101,36 @@ namespace tess
 
 		GLUTESS_tesselator* _tess_obj;
 		mesh_builder _builder;
+		path_stats _path_stats;
+
+		// scratch space of the direct paths, kept between polygons
+		std::vector<vec2> _projected;      // contour points in the plane of the polygon
+		float _orientation;                // sign of the area of _projected
+		std::vector<unsigned int> _corners; // contour points not yet clipped
+		std::vector<element> _triangles;    // ears clipped so far
+
+		// owning polygons flattened into a view, kept between polygons
+		std::vector<point> _polygon_points;
+		std::vector<unsigned int> _polygon_offsets;
 	};
 
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+	// polygon_tessellator::path_stats
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	polygon_tessellator::path_stats& polygon_tessellator::path_stats::operator+=(const path_stats& other)
+	{
+		fan_polygons += other.fan_polygons;
+		ear_clipped_polygons += other.ear_clipped_polygons;
+		swept_polygons += other.swept_polygons;
+		return *this;
+	}
+
+	unsigned long long polygon_tessellator::path_stats::polygons() const
+	{
+		return fan_polygons + ear_clipped_polygons + swept_polygons;
+	}
+
 	//----------------------------------------------------------------------------------------------------------------------------------------------------------
 	// polygon_tessellator::public
 	//----------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -61,63 +154,119 @@ namespace tess
 		_d->addPolygon(poly);
 	}
 
+	void polygon_tessellator::add_polygon(const polygon_view& poly)
+	{
+		_d->addPolygon(poly);
+	}
+
 	triangle_mesh polygon_tessellator::end()
 	{
 		return _d->end();
 	}
 
-	//----------------------------------------------------------------------------------------------------------------------------------------------------------
-	// polygon_tessellator::impl::public
-	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+	void polygon_tessellator::end(mesh_sink& sink)
+	{
+		_d->end(sink);
+	}
 
-	polygon_tessellator::impl::impl() : _tess_obj(nullptr)
+	const polygon_tessellator::path_stats& polygon_tessellator::get_path_stats() const
 	{
+		return _d->_path_stats;
 	}
 
-	polygon_tessellator::impl::~impl()
+	void polygon_tessellator::reset_path_stats()
 	{
-		if(_tess_obj != nullptr)
-		{
-			tessDelete(_tess_obj);
-		}
+		_d->_path_stats = path_stats();
 	}
 
-	void polygon_tessellator::impl::begin()
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+	// polygon_tessellator::impl::public
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	polygon_tessellator::impl::impl() : _orientation(1.0f)
 	{
-		if(_tess_obj != nullptr)
+		// every polygon leaves the tessellator dormant again, so one object serves all meshes
+		_tess_obj = tessNew();
+		if(_tess_obj == nullptr)
 		{
-			tessDelete(_tess_obj);
+			throw std::bad_alloc();
 		}
 
-		_tess_obj = tessNew();
 		tessCallback(_tess_obj, GLUTESS_BEGIN_DATA, reinterpret_cast<GLUTESS_CALLBACK>(&polygon_tessellator::impl::beginCB));
 		tessCallback(_tess_obj, GLUTESS_VERTEX_DATA, reinterpret_cast<GLUTESS_CALLBACK>(&polygon_tessellator::impl::vertexCB));
 		tessCallback(_tess_obj, GLUTESS_COMBINE_DATA, reinterpret_cast<GLUTESS_CALLBACK>(&polygon_tessellator::impl::combineCB));
+	}
+
+	polygon_tessellator::impl::~impl()
+	{
+		tessDelete(_tess_obj);
+	}
 
+	void polygon_tessellator::impl::begin()
+	{
 		_builder.begin();
 	}
 
 	void polygon_tessellator::impl::addPolygon(const polygon& poly)
 	{
+		// every path works on a view, the flat copy keeps its capacity
+		_polygon_points.clear();
+		_polygon_offsets.assign(1, 0);
+
+		for(const auto& cont : poly.contours)
+		{
+			_polygon_points.insert(_polygon_points.end(), cont.points.begin(), cont.points.end());
+			_polygon_offsets.push_back(_polygon_points.size());
+		}
+
+		polygon_view view;
+		view.points = _polygon_points.data();
+		view.contour_offsets = _polygon_offsets.data();
+		view.contour_count = poly.contours.size();
+		addPolygon(view);
+	}
+
+	void polygon_tessellator::impl::addPolygon(const polygon_view& poly)
+	{
+		if(poly.contour_count == 0)
+		{
+			return;
+		}
+
+		// store vertices first, every path refers to them by index
+		const unsigned int first_point = poly.contour_offsets[0];
+		const unsigned int last_point = poly.contour_offsets[poly.contour_count];
+
+		element first = 0;
+		for(unsigned int iPoint = first_point; iPoint < last_point; ++iPoint)
+		{
+			const point& p = poly.points[iPoint];
+			const element idx = _builder.add_vertex(tess::vertex(p.vertex, p.normal));
+			if(iPoint == first_point)
+			{
+				first = idx;
+			}
+		}
+
+		if(poly.contour_count == 1 && triangulate_contour(poly.points + first_point, last_point - first_point, first))
+		{
+			return;
+		}
+
 		// Tesselate the polygon
+		++_path_stats.swept_polygons;
 		tessBeginPolygon(_tess_obj, this);
 
-		for(unsigned int iContour = 0; iContour < poly.contours.size(); ++iContour)
+		element idx = first;
+		for(unsigned int iContour = 0; iContour < poly.contour_count; ++iContour)
 		{
-			const contour& cont = poly.contours[iContour];
 			tessBeginContour(_tess_obj);
 
-			for(unsigned int iPoint = 0; iPoint < cont.points.size(); ++iPoint)
+			for(unsigned int iPoint = poly.contour_offsets[iContour]; iPoint < poly.contour_offsets[iContour + 1]; ++iPoint, ++idx)
 			{
-				// get contour point
-				const point& p = cont.points[iPoint];
-
-				// convert to vertex and store it
-				tess::vertex v(p.vertex, p.normal);
-				unsigned int idx = _builder.add_vertex(v);
-
 				// convert float to double to send to tesselator
-				double coords[] = {v.position.x, v.position.y, v.position.z};
+				const vec3& p = poly.points[iPoint].vertex;
+				double coords[] = {p.x, p.y, p.z};
 
 				// last parameter is the index in _resultVertices array, used to recover the i-th vertex from tesselator.
 				// the libtess API actually expects a pointer, but since we are using std::vector's, they may get reallocated when growing.
@@ -137,6 +286,11 @@ namespace tess
 		return _builder.end();
 	}
 
+	void polygon_tessellator::impl::end(mesh_sink& sink)
+	{
+		_builder.end(sink);
+	}
+
 	void polygon_tessellator::impl::begin(unsigned int type)
 	{
 		// Begin new draw method
@@ -192,6 +346,211 @@ namespace tess
 		*out_data = reinterpret_cast<void*>(idx);
 	}
 
+	bool polygon_tessellator::impl::triangulate_contour(const point* points, unsigned int count, element first)
+	{
+		if(count < 3 || !project(points, count))
+		{
+			return false;
+		}
+
+		// triangles keep the winding of the contour, like glutess does for a single contour
+		if(is_convex())
+		{
+			for(element i = 2; i < count; ++i)
+			{
+				_builder.add_triangle(first, first + i - 1, first + i);
+			}
+
+			++_path_stats.fan_polygons;
+			return true;
+		}
+
+		if(count > MAX_EAR_CLIPPING_POINTS || !is_simple() || !clip_ears(first))
+		{
+			return false;
+		}
+
+		++_path_stats.ear_clipped_polygons;
+		return true;
+	}
+
+	bool polygon_tessellator::impl::project(const point* points, unsigned int count)
+	{
+		// plane of the polygon from the normals it came with, rather than estimating one from its points
+		vec3 normal(0.0f);
+		for(unsigned int i = 0; i < count; ++i)
+		{
+			normal += points[i].normal;
+		}
+
+		const auto len = length(normal);
+		if(!(len > 0.0f))
+		{
+			return false;
+		}
+
+		normal /= len;
+		const auto u = normalize(cross(normal, std::abs(normal.x) < 0.5f? vec3(1.0f, 0.0f, 0.0f) : vec3(0.0f, 1.0f, 0.0f)));
+		const auto v = cross(normal, u);
+
+		const auto& origin = points[0].vertex;
+		_projected.resize(count);
+		vec2 min_corner(0.0f);
+		vec2 max_corner(0.0f);
+
+		for(unsigned int i = 0; i < count; ++i)
+		{
+			const auto d = points[i].vertex - origin;
+			_projected[i] = vec2(dot(d, u), dot(d, v));
+			min_corner = min(min_corner, _projected[i]);
+			max_corner = max(max_corner, _projected[i]);
+		}
+
+		float area = 0.0f;
+		for(unsigned int i = 2; i < _projected.size(); ++i)
+		{
+			area += orient(_projected[0], _projected[i - 1], _projected[i]);
+		}
+
+		const auto extent = max(max_corner.x - min_corner.x, max_corner.y - min_corner.y);
+		if(!(std::abs(area) > MIN_RELATIVE_AREA * extent * extent))
+		{
+			return false;
+		}
+
+		_orientation = area > 0.0f? 1.0f : -1.0f;
+		return true;
+	}
+
+	bool polygon_tessellator::impl::is_convex() const
+	{
+		const unsigned int n = _projected.size();
+		unsigned int x_flips = 0;
+		float last_dx = 0.0f;
+
+		for(unsigned int i = 0; i < n; ++i)
+		{
+			const auto& a = _projected[i];
+			const auto& b = _projected[(i + 1) % n];
+			const auto& c = _projected[(i + 2) % n];
+
+			// every corner turns the same way as the contour, collinear and repeated points included
+			if(!(orient(a, b, c) * _orientation > 0.0f))
+			{
+				return false;
+			}
+
+			// turning the same way at every corner can still wind more than once (e.g. a pentagram)
+			// a contour that winds once changes horizontal direction exactly twice
+			const auto dx = b.x - a.x;
+			if(dx != 0.0f)
+			{
+				x_flips += (last_dx != 0.0f && (dx > 0.0f) != (last_dx > 0.0f));
+				last_dx = dx;
+			}
+		}
+
+		// the flip between the last and first edges is not counted above
+		return x_flips <= 2;
+	}
+
+	bool polygon_tessellator::impl::is_simple() const
+	{
+		const unsigned int n = _projected.size();
+
+		for(unsigned int i = 0; i < n; ++i)
+		{
+			const auto& a = _projected[i];
+			const auto& b = _projected[(i + 1) % n];
+			const auto& c = _projected[(i + 2) % n];
+
+			// consecutive edges only share their common point: no repeated points, no edge folding back over the previous one
+			if(orient(a, b, c) == 0.0f && dot(b - a, c - b) <= 0.0f)
+			{
+				return false;
+			}
+
+			// edges that are not consecutive share no point at all
+			for(unsigned int j = i + 2; j < n; ++j)
+			{
+				if(i == 0 && j == n - 1)
+				{
+					continue;
+				}
+
+				if(segments_touch(a, b, _projected[j], _projected[(j + 1) % n]))
+				{
+					return false;
+				}
+			}
+		}
+
+		return true;
+	}
+
+	bool polygon_tessellator::impl::clip_ears(element first)
+	{
+		_corners.resize(_projected.size());
+		for(unsigned int i = 0; i < _corners.size(); ++i)
+		{
+			_corners[i] = i;
+		}
+
+		// triangles go to the builder only once the whole contour is clipped, so a failure leaves it untouched
+		_triangles.clear();
+		unsigned int i = 0;
+		unsigned int misses = 0;
+
+		while(_corners.size() > 3)
+		{
+			const unsigned int n = _corners.size();
+			const auto prev = _corners[(i + n - 1) % n];
+			const auto curr = _corners[i % n];
+			const auto next = _corners[(i + 1) % n];
+			const auto& a = _projected[prev];
+			const auto& b = _projected[curr];
+			const auto& c = _projected[next];
+
+			// an ear is a convex corner whose triangle holds no other remaining point
+			bool ear = orient(a, b, c) * _orientation > 0.0f;
+			for(unsigned int j = 0; ear && j < n; ++j)
+			{
+				const auto k = _corners[j];
+				ear = k == prev || k == curr || k == next || !in_triangle(a, b, c, _projected[k], _orientation);
+			}
+
+			if(ear)
+			{
+				_triangles.push_back(first + prev);
+				_triangles.push_back(first + curr);
+				_triangles.push_back(first + next);
+				_corners.erase(_corners.begin() + i % n);
+				i = i % n;
+				misses = 0;
+			}
+			else
+			{
+				// a full turn without ears only happens with points the predicates cannot separate
+				i = (i + 1) % n;
+				if(++misses > n)
+				{
+					return false;
+				}
+			}
+		}
+
+		_triangles.push_back(first + _corners[0]);
+		_triangles.push_back(first + _corners[1]);
+		_triangles.push_back(first + _corners[2]);
+
+		for(unsigned int t = 0; t < _triangles.size(); t += 3)
+		{
+			_builder.add_triangle(_triangles[t], _triangles[t + 1], _triangles[t + 2]);
+		}
+
+		return true;
+	}
+
 	void polygon_tessellator::impl::beginCB(unsigned int type, void* user_data)
 	{
 		static_cast<polygon_tessellator::impl*>(user_data)->begin(type);
@@ -0,0 +1,258 @@
+#include <tess/tessellation_cache.h>
+#include <tess/vertex_hash.h>
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <stdexcept>
+
+namespace tess
+{
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// primitive_key
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	bool primitive_key::operator==(const primitive_key& other) const
+	{
+		if(type != other.type || param_count != other.param_count)
+		{
+			return false;
+		}
+
+		for(unsigned int i = 0; i < param_count; ++i)
+		{
+			if(params[i] != other.params[i])
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	size_t primitive_key_hash::operator()(const primitive_key& key) const
+	{
+		// 64-bit FNV-1a over type and parameters, followed by a final avalanche
+		unsigned long long h = 14695981039346656037ULL;
+
+		auto mix = [&h](unsigned long long value)
+		{
+			h ^= value;
+			h *= 1099511628211ULL;
+		};
+
+		mix(key.type);
+		mix(key.param_count);
+		for(unsigned int i = 0; i < key.param_count; ++i)
+		{
+			mix(static_cast<unsigned long long>(key.params[i]));
+		}
+
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccdULL;
+		h ^= h >> 33;
+
+		return static_cast<size_t>(h);
+	}
+
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// tessellation_cache
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	tessellation_cache::tessellation_cache(float quantum /*= 1e-4f*/) : _inv_quantum(1.0f / quantum)
+	{
+	}
+
+	primitive_key tessellation_cache::make_key(unsigned int type, std::initializer_list<float> params) const
+	{
+		if(params.size() > primitive_key::MAX_PARAMS)
+		{
+			throw std::invalid_argument("Too many parameters for tess::primitive_key.");
+		}
+
+		primitive_key key;
+		key.type = type;
+
+		for(auto p : params)
+		{
+			// llround maps both +0 and -0 to the same value
+			key.params[key.param_count++] = std::llround(static_cast<double>(p) * _inv_quantum);
+		}
+
+		return key;
+	}
+
+	unsigned int tessellation_cache::find(const primitive_key& key) const
+	{
+		auto it = _ids.find(key);
+		return it == _ids.end()? npos : it->second;
+	}
+
+	unsigned int tessellation_cache::insert(const primitive_key& key)
+	{
+		auto id = static_cast<unsigned int>(_entries.size());
+		_ids.emplace(key, id);
+		_entries.emplace_back();
+		return id;
+	}
+
+	size_t tessellation_cache::hash_mesh(const vertex* vertices, unsigned int vertex_count, const element* elements, unsigned int element_count)
+	{
+		// same mixing as primitive_key_hash, over the bits of every attribute and element
+		unsigned long long h = 14695981039346656037ULL;
+
+		auto mix = [&h](unsigned long long value)
+		{
+			h ^= value;
+			h *= 1099511628211ULL;
+		};
+
+		mix(vertex_count);
+		mix(element_count);
+
+		for(unsigned int i = 0; i < vertex_count; ++i)
+		{
+			const auto& v = vertices[i];
+			const float attributes[6] = {v.position.x, v.position.y, v.position.z, v.normal.x, v.normal.y, v.normal.z};
+
+			for(auto a : attributes)
+			{
+				mix(vertex_hash::bits(a));
+			}
+		}
+
+		for(unsigned int i = 0; i < element_count; ++i)
+		{
+			mix(elements[i]);
+		}
+
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccdULL;
+		h ^= h >> 33;
+
+		return static_cast<size_t>(h);
+	}
+
+	void tessellation_cache::set_mesh_comparator(const mesh_comparator& compare)
+	{
+		_compare_mesh = compare;
+	}
+
+	bool tessellation_cache::compare_mesh(unsigned int id, const vertex* vertices, unsigned int vertex_count, const element* elements,
+										  unsigned int element_count) const
+	{
+		return _compare_mesh && _compare_mesh(id, vertices, vertex_count, elements, element_count);
+	}
+
+	unsigned int tessellation_cache::find_mesh(size_t hash, const vertex* vertices, unsigned int vertex_count, const element* elements,
+											   unsigned int element_count, const mesh_comparator& compare) const
+	{
+		// different meshes with the same hash are told apart by comparing their contents
+		const auto candidates = _mesh_ids.equal_range(hash);
+		for(auto it = candidates.first; it != candidates.second; ++it)
+		{
+			const auto& e = _entries[it->second];
+			if(e.vertex_count == vertex_count && e.element_count == element_count && compare(it->second, vertices, vertex_count, elements, element_count))
+			{
+				return it->second;
+			}
+		}
+
+		return npos;
+	}
+
+	unsigned int tessellation_cache::insert_mesh(size_t hash, unsigned int vertex_count, unsigned int element_count)
+	{
+		auto id = static_cast<unsigned int>(_entries.size());
+		_mesh_ids.emplace(hash, id);
+		_entries.emplace_back();
+		_entries.back().by_content = true;
+		_entries.back().vertex_count = vertex_count;
+		_entries.back().element_count = element_count;
+		return id;
+	}
+
+	void tessellation_cache::set_mesh(unsigned int id, const triangle_mesh& mesh, double tessellation_msec)
+	{
+		_entries[id].mesh = mesh;
+		_entries[id].msec = tessellation_msec;
+	}
+
+	void tessellation_cache::set_mesh(unsigned int id, const vertex* vertices, unsigned int vertex_count, const element* elements, unsigned int element_count,
+									  double tessellation_msec)
+	{
+		_entries[id].mesh.vertices.assign(vertices, vertices + vertex_count);
+		_entries[id].mesh.elements.assign(elements, elements + element_count);
+		_entries[id].msec = tessellation_msec;
+	}
+
+	const triangle_mesh& tessellation_cache::get_mesh(unsigned int id) const
+	{
+		return _entries[id].mesh;
+	}
+
+	void tessellation_cache::record_hit(unsigned int id)
+	{
+		const auto& e = _entries[id];
+
+		// meshes found by content were already tessellated, only their memory is saved
+		if(e.by_content)
+		{
+			++_stats.mesh_hits;
+			_stats.saved_mesh_bytes += e.vertex_count * sizeof(vertex) + e.element_count * sizeof(element);
+			return;
+		}
+
+		++_stats.hits;
+		_stats.saved_msec += e.msec;
+		_stats.saved_vertex_bytes += e.mesh.vertices.size() * sizeof(vertex);
+		_stats.saved_element_bytes += e.mesh.elements.size() * sizeof(element);
+	}
+
+	void tessellation_cache::record_miss(unsigned int id)
+	{
+		if(_entries[id].by_content)
+		{
+			++_stats.mesh_misses;
+			return;
+		}
+
+		++_stats.misses;
+	}
+
+	const tessellation_cache::stats& tessellation_cache::get_stats() const
+	{
+		return _stats;
+	}
+
+	void tessellation_cache::reset_stats()
+	{
+		_stats = stats();
+	}
+
+	unsigned int tessellation_cache::size() const
+	{
+		return _entries.size();
+	}
+
+	void tessellation_cache::clear()
+	{
+		_ids.clear();
+		_mesh_ids.clear();
+		_entries.clear();
+	}
+
+	void tessellation_cache::rollback(unsigned int size)
+	{
+		for(auto it = _ids.begin(); it != _ids.end();)
+		{
+			it = it->second >= size? _ids.erase(it) : std::next(it);
+		}
+
+		for(auto it = _mesh_ids.begin(); it != _mesh_ids.end();)
+		{
+			it = it->second >= size? _mesh_ids.erase(it) : std::next(it);
+		}
+
+		_entries.resize(std::min<size_t>(_entries.size(), size));
+	}
+} // namespace tess
@@ -0,0 +1,115 @@
+#pragma once
+#include <tess/triangle_mesh.h>
+#include <functional>
+#include <initializer_list>
+#include <unordered_map>
+
+namespace tess
+{
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// primitive_key: primitive type plus its quantized parameters (dimensions, angles and segment counts)
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	struct primitive_key
+	{
+		static const unsigned int MAX_PARAMS = 12;
+
+		bool operator==(const primitive_key& other) const;
+
+		unsigned int type = 0;
+		unsigned int param_count = 0;
+		long long params[MAX_PARAMS] = {};
+	};
+
+	struct primitive_key_hash
+	{
+		size_t operator()(const primitive_key& key) const;
+	};
+
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// tessellation_cache: keeps the mesh generated for each distinct parametric primitive so repeated shapes are tessellated only once
+	// polygonal meshes have no parameters: they are found by content once tessellated, so repeated meshes are stored only once
+	// the cache keeps no copy of polygonal meshes, whoever stores their geometry compares it through a mesh_comparator
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	class tessellation_cache
+	{
+	public:
+		static const unsigned int npos = ~0U;
+
+		struct stats
+		{
+			unsigned int hits = 0;
+			unsigned int misses = 0;
+			double saved_msec = 0.0;        // tessellation time that would have been spent on hits
+			size_t saved_vertex_bytes = 0;  // vertex memory that would have been allocated for hits
+			size_t saved_element_bytes = 0; // element memory that would have been allocated for hits
+
+			unsigned int mesh_hits = 0;     // meshes found by content, not included in hits
+			unsigned int mesh_misses = 0;
+			size_t saved_mesh_bytes = 0;    // vertex and element memory that would have been allocated for mesh hits
+		};
+
+		// return whether entry id holds exactly the given mesh, sizes are already known to match
+		typedef std::function<bool(unsigned int id, const vertex* vertices, unsigned int vertex_count, const element* elements, unsigned int element_count)>
+			mesh_comparator;
+
+		// parameters are rounded to the nearest multiple of quantum (in model units / radians) before comparison
+		explicit tessellation_cache(float quantum = 1e-4f);
+
+		primitive_key make_key(unsigned int type, std::initializer_list<float> params) const;
+
+		// return id of the entry with the given key or npos if not found
+		unsigned int find(const primitive_key& key) const;
+
+		// add a new entry without mesh and return its id, mesh must be given later through set_mesh
+		unsigned int insert(const primitive_key& key);
+
+		// hash of mesh contents, consistent with the comparison done by find_mesh (vertex::operator== and equal elements, in the same order)
+		static size_t hash_mesh(const vertex* vertices, unsigned int vertex_count, const element* elements, unsigned int element_count);
+
+		// compares the given mesh with the geometry stored by the caller for entries of previous batches
+		// without a comparator, meshes are only found within the batch that inserted them
+		void set_mesh_comparator(const mesh_comparator& compare);
+		bool compare_mesh(unsigned int id, const vertex* vertices, unsigned int vertex_count, const element* elements, unsigned int element_count) const;
+
+		// return id of the first entry with the given hash and sizes for which compare returns true or npos if not found
+		unsigned int find_mesh(size_t hash, const vertex* vertices, unsigned int vertex_count, const element* elements, unsigned int element_count,
+							   const mesh_comparator& compare) const;
+
+		// add a new entry found by content and return its id, only its sizes are kept
+		unsigned int insert_mesh(size_t hash, unsigned int vertex_count, unsigned int element_count);
+
+		void set_mesh(unsigned int id, const triangle_mesh& mesh, double tessellation_msec);
+		void set_mesh(unsigned int id, const vertex* vertices, unsigned int vertex_count, const element* elements, unsigned int element_count,
+					  double tessellation_msec);
+		const triangle_mesh& get_mesh(unsigned int id) const; // empty for entries found by content
+
+		void record_hit(unsigned int id);
+		void record_miss(unsigned int id);
+
+		const stats& get_stats() const;
+		void reset_stats();
+
+		unsigned int size() const;
+		void clear();
+
+		// drop every entry added since size() returned the given value, e.g. entries of a batch whose tessellation failed
+		void rollback(unsigned int size);
+
+	private:
+		struct entry
+		{
+			triangle_mesh mesh;
+			double msec = 0.0;
+			bool by_content = false;
+			unsigned int vertex_count = 0;  // only for entries found by content
+			unsigned int element_count = 0;
+		};
+
+		float _inv_quantum;
+		std::unordered_map<primitive_key, unsigned int, primitive_key_hash> _ids;
+		std::unordered_multimap<size_t, unsigned int> _mesh_ids;
+		std::vector<entry> _entries;
+		mesh_comparator _compare_mesh;
+		stats _stats;
+	};
+} // namespace tess
@@ -0,0 +1,178 @@
+#include <tess/tessellation_quality.h>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace tess
+{
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// tessellation_quality
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	tessellation_quality::tessellation_quality(float max_chord_error, int min_segment_count /*= 8*/, int max_segment_count /*= 32*/,
+											   int min_sweep_count /*= 1*/, int max_sweep_count /*= 16*/)
+		: _max_chord_error(max_chord_error), _min_segment_count(min_segment_count), _max_segment_count(max_segment_count),
+		  _min_sweep_count(min_sweep_count), _max_sweep_count(max_sweep_count)
+	{
+		if(max_chord_error <= 0.0f)
+		{
+			throw std::invalid_argument("tess::tessellation_quality requires a positive chord error.");
+		}
+
+		// caps of truncated cones need at least four segments
+		if(min_segment_count < 4 || min_segment_count > max_segment_count || min_sweep_count < 1 || min_sweep_count > max_sweep_count)
+		{
+			throw std::invalid_argument("Invalid segment or sweep count limits for tess::tessellation_quality.");
+		}
+	}
+
+	float tessellation_quality::get_max_chord_error() const
+	{
+		return _max_chord_error;
+	}
+
+	int tessellation_quality::segment_count(float radius) const
+	{
+		auto count = _count(radius, 2.0f * pi<float>(), _min_segment_count, _max_segment_count);
+
+		// caps are closed two triangles at a time, so they need an even number of segments
+		if(count % 2 != 0)
+		{
+			count = (count + 1 <= _max_segment_count)? count + 1 : count - 1;
+		}
+
+		return count;
+	}
+
+	int tessellation_quality::sweep_count(float radius, float arc_angle) const
+	{
+		return _count(radius, arc_angle, _min_sweep_count, _max_sweep_count);
+	}
+
+	void tessellation_quality::apply(cylinder& c, float scale /*= 1.0f*/) const
+	{
+		c.segment_count = segment_count(c.radius * scale);
+	}
+
+	void tessellation_quality::apply(cylinder_offset& c, float scale /*= 1.0f*/) const
+	{
+		c.segment_count = segment_count(c.radius * scale);
+	}
+
+	void tessellation_quality::apply(cone& c, float scale /*= 1.0f*/) const
+	{
+		c.segment_count = segment_count(std::max(c.top_radius, c.bottom_radius) * scale);
+	}
+
+	void tessellation_quality::apply(cone_offset& c, float scale /*= 1.0f*/) const
+	{
+		c.segment_count = segment_count(std::max(c.top_radius, c.bottom_radius) * scale);
+	}
+
+	void tessellation_quality::apply(cone_slope_offset& c, float scale /*= 1.0f*/) const
+	{
+		c.segment_count = segment_count(std::max(c.top_radius, c.bottom_radius) * scale);
+	}
+
+	void tessellation_quality::apply(circular_torus& t, float scale /*= 1.0f*/) const
+	{
+		t.segment_count = segment_count(t.in_radius * scale);
+
+		// the outer side of the torus has the longest arc
+		t.sweep_count = sweep_count((t.out_radius + t.in_radius) * scale, t.sweep_angle);
+	}
+
+	void tessellation_quality::apply(rectangular_torus& t, float scale /*= 1.0f*/) const
+	{
+		t.sweep_count = sweep_count((t.out_radius + t.in_radius) * scale, t.sweep_angle);
+	}
+
+	void tessellation_quality::apply(dish& d, float scale /*= 1.0f*/) const
+	{
+		// use the largest semi-axis as radius of the elliptic profile
+		d.horizontal_count = segment_count(d.radius * scale);
+		d.vertical_count = sweep_count(std::max(d.radius, d.height) * scale, half_pi<float>());
+	}
+
+	void tessellation_quality::apply(sphere& s, float scale /*= 1.0f*/) const
+	{
+		// a sphere needs at least one ring of vertices between its poles
+		s.horizontal_count = segment_count(s.radius * scale);
+		s.vertical_count = std::max(sweep_count(s.radius * scale, pi<float>()), 2);
+	}
+
+	int tessellation_quality::_count(float radius, float arc_angle, int min_count, int max_count) const
+	{
+		radius = std::abs(radius);
+		arc_angle = std::abs(arc_angle);
+
+		if(radius <= _max_chord_error)
+		{
+			return min_count;
+		}
+
+		// chord deviation of a segment spanning angle a is r * (1 - cos(a/2)), so the largest allowed segment spans 2 * acos(1 - e/r)
+		const auto max_segment_angle = 2.0f * std::acos(1.0f - _max_chord_error / radius);
+		const auto count = std::ceil(arc_angle / max_segment_angle);
+
+		return static_cast<int>(std::min(std::max(count, static_cast<float>(min_count)), static_cast<float>(max_count)));
+	}
+
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// triangle counts
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	// truncated cone: two triangles per side plus two triangles per pair of cap segments
+	static unsigned int cone_triangle_count(int segment_count, bool with_top_cap, bool with_bottom_cap)
+	{
+		const unsigned int cap_triangles = 2 * ((segment_count - 2) / 2);
+		return 2 * segment_count + (with_top_cap? cap_triangles : 0) + (with_bottom_cap? cap_triangles : 0);
+	}
+
+	unsigned int triangle_count(const cylinder& c)
+	{
+		return cone_triangle_count(c.segment_count, c.with_top_cap, c.with_bottom_cap);
+	}
+
+	unsigned int triangle_count(const cylinder_offset& c)
+	{
+		return cone_triangle_count(c.segment_count, c.with_top_cap, c.with_bottom_cap);
+	}
+
+	unsigned int triangle_count(const cone& c)
+	{
+		return cone_triangle_count(c.segment_count, c.with_top_cap, c.with_bottom_cap);
+	}
+
+	unsigned int triangle_count(const cone_offset& c)
+	{
+		return cone_triangle_count(c.segment_count, c.with_top_cap, c.with_bottom_cap);
+	}
+
+	unsigned int triangle_count(const cone_slope_offset& c)
+	{
+		return cone_triangle_count(c.segment_count, c.with_top_cap, c.with_bottom_cap);
+	}
+
+	unsigned int triangle_count(const circular_torus& t)
+	{
+		return 2 * t.segment_count * t.sweep_count;
+	}
+
+	unsigned int triangle_count(const rectangular_torus& t)
+	{
+		return 8 * t.sweep_count;
+	}
+
+	unsigned int triangle_count(const dish& d)
+	{
+		// top fan plus one band of quads per vertical step
+		return d.horizontal_count + 2 * d.horizontal_count * (d.vertical_count - 1);
+	}
+
+	unsigned int triangle_count(const sphere& s)
+	{
+		// top and bottom fans plus quad bands between them
+		return 2 * s.horizontal_count * (s.vertical_count - 1);
+	}
+} // namespace tess
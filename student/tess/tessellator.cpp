@@ -1,8 +1,71 @@
 #include <tess/tessellator.h>
 #include <tess/polygon_tessellator.h>
+#include <tess/unit_circle.h>
+#include <algorithm>
+#include <cmath>
 
 namespace tess
 {
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// output
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// writes sequentially into memory already reserved in a sink, with the subset of std::vector used by the generators below
+	template<typename T>
+	class output_range
+	{
+	public:
+		typedef unsigned int size_type;
+
+		explicit output_range(T* data) : _data(data), _size(0)
+		{
+		}
+
+		void push_back(const T& value)
+		{
+			_data[_size++] = value;
+		}
+
+		T& operator[](size_type i)
+		{
+			return _data[i];
+		}
+
+		size_type size() const
+		{
+			return _size;
+		}
+
+	private:
+		T* _data;
+		size_type _size;
+	};
+
+	// room for exactly one mesh in a sink
+	struct mesh_writer
+	{
+		mesh_writer(mesh_sink& sink, int vertex_count, int element_count)
+			: vertices(sink.allocate_vertices(vertex_count)), elements(sink.allocate_elements(element_count))
+		{
+		}
+
+		output_range<vertex> vertices;
+		output_range<element> elements;
+	};
+
+	// temporary positions reused by every mesh generated on the same thread, so generating into a sink does not allocate
+	static thread_local std::vector<vec3> s_positions;
+	static thread_local std::vector<vec3> s_more_positions;
+
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// approximation error
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	float arc_chord_error(float radius, float arc_angle, int segment_count)
+	{
+		// sagitta of a single segment: distance from the chord midpoint to the arc
+		const auto half_segment_angle = std::abs(arc_angle) / static_cast<float>(std::max(segment_count, 1)) * 0.5f;
+		return std::abs(radius) * (1.0f - cos(half_segment_angle));
+	}
+
 	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
 	// rectangular-base pyramid
 	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -13,6 +76,20 @@ namespace tess
 	}
 
 	triangle_mesh tessellate_pyramid(const vec2& top_extents, const vec2& bottom_extents, float height, const vec2& offset /*= {0.0f, 0.0f}*/)
+	{
+		triangle_mesh mesh;
+		vector_sink sink(mesh.vertices, mesh.elements);
+		tessellate_pyramid(sink, top_extents, bottom_extents, height, offset);
+		return mesh;
+	}
+
+	void tessellate_box(mesh_sink& sink, const vec3& extents)
+	{
+		const auto ext = vec2(extents.x, extents.y);
+		tessellate_pyramid(sink, ext, ext, extents.z);
+	}
+
+	void tessellate_pyramid(mesh_sink& sink, const vec2& top_extents, const vec2& bottom_extents, float height, const vec2& offset /*= {0.0f, 0.0f}*/)
 	{
 		// vertices are computed as follows
 		//     7+------+6
@@ -46,7 +123,8 @@ namespace tess
 
 		const vec3 unit_z(0.0f, 0.0f, 1.0f);
 
-		triangle_mesh mesh;
+		// four vertices and two triangles per face
+		mesh_writer mesh(sink, 24, 36);
 
 		// -----------------------------------------------------------------------------------------------------------------------------------------------------
 		// vertices
@@ -94,8 +172,6 @@ namespace tess
 			mesh.elements.push_back(2+i*4);
 			mesh.elements.push_back(3+i*4);
 		}
-
-		return mesh;
 	}
 
 	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -146,11 +222,74 @@ namespace tess
 	triangle_mesh tessellate_cone_slope_offset(float top_radius, float bottom_radius, float height, const vec2& top_slope_angles, const vec2& bottom_slope_angles,
 											   const vec2& offset, int segment_count /*= 16*/, bool with_caps /*= true*/)
 	{
-		std::vector<vec3> top_positions;
-		std::vector<vec3> bottom_positions;
+		return tessellate_cone_slope_offset(top_radius, bottom_radius, height, top_slope_angles, bottom_slope_angles, offset, segment_count, with_caps, with_caps);
+	}
 
-		top_positions.reserve(segment_count);
-		bottom_positions.reserve(segment_count);
+	triangle_mesh tessellate_cone_slope_offset(float top_radius, float bottom_radius, float height, const vec2& top_slope_angles, const vec2& bottom_slope_angles,
+											   const vec2& offset, int segment_count, bool with_top_cap, bool with_bottom_cap)
+	{
+		triangle_mesh mesh;
+		vector_sink sink(mesh.vertices, mesh.elements);
+		tessellate_cone_slope_offset(sink, top_radius, bottom_radius, height, top_slope_angles, bottom_slope_angles, offset, segment_count, with_top_cap, with_bottom_cap);
+		return mesh;
+	}
+
+	void tessellate_cylinder(mesh_sink& sink, float radius, float height,
+							 int segment_count /*= 16*/, bool with_caps /*= true*/)
+	{
+		tessellate_cone_slope_offset(sink, radius, radius, height, vec2(), vec2(), vec2(), segment_count, with_caps);
+	}
+
+	void tessellate_cylinder_offset(mesh_sink& sink, float radius, float height, const vec2& offset,
+									int segment_count /*= 16*/, bool with_caps /*= true*/)
+	{
+		tessellate_cone_slope_offset(sink, radius, radius, height, vec2(), vec2(), offset, segment_count, with_caps);
+	}
+
+	void tessellate_cylinder_slope(mesh_sink& sink, float radius, float height, const vec2& top_slope_angles, const vec2& bottom_slope_angles,
+								   int segment_count /*= 16*/, const bool with_caps /*= true*/)
+	{
+		tessellate_cone_slope_offset(sink, radius, radius, height, top_slope_angles, bottom_slope_angles, vec2(), segment_count, with_caps);
+	}
+
+	void tessellate_cylinder_slope_offset(mesh_sink& sink, float radius, float height, const vec2& top_slope_angles, const vec2& bottom_slope_angles, const vec2& offset,
+										  int segment_count /*= 16*/, bool with_caps /*= true*/)
+	{
+		tessellate_cone_slope_offset(sink, radius, radius, height, top_slope_angles, bottom_slope_angles, offset, segment_count, with_caps);
+	}
+
+	void tessellate_cone(mesh_sink& sink, float top_radius, float bottom_radius, float height,
+						 int segment_count /*= 16*/, bool with_caps /*= true*/)
+	{
+		tessellate_cone_slope_offset(sink, top_radius, bottom_radius, height, vec2(), vec2(), vec2(), segment_count, with_caps);
+	}
+
+	void tessellate_cone_offset(mesh_sink& sink, float top_radius, float bottom_radius, float height, const vec2& offset,
+								int segment_count /*= 16*/, bool with_caps /*= true*/)
+	{
+		tessellate_cone_slope_offset(sink, top_radius, bottom_radius, height, vec2(), vec2(), offset, segment_count, with_caps);
+	}
+
+	void tessellate_cone_slope(mesh_sink& sink, float top_radius, float bottom_radius, float height, const vec2& top_slope_angles, const vec2& bottom_slope_angles,
+							   int segment_count /*= 16*/, const bool with_caps /*= true*/)
+	{
+		tessellate_cone_slope_offset(sink, top_radius, bottom_radius, height, top_slope_angles, bottom_slope_angles, vec2(), segment_count, with_caps);
+	}
+
+	void tessellate_cone_slope_offset(mesh_sink& sink, float top_radius, float bottom_radius, float height, const vec2& top_slope_angles, const vec2& bottom_slope_angles,
+									  const vec2& offset, int segment_count /*= 16*/, bool with_caps /*= true*/)
+	{
+		tessellate_cone_slope_offset(sink, top_radius, bottom_radius, height, top_slope_angles, bottom_slope_angles, offset, segment_count, with_caps, with_caps);
+	}
+
+	void tessellate_cone_slope_offset(mesh_sink& sink, float top_radius, float bottom_radius, float height, const vec2& top_slope_angles, const vec2& bottom_slope_angles,
+									  const vec2& offset, int segment_count, bool with_top_cap, bool with_bottom_cap)
+	{
+		auto& top_positions = s_positions;
+		auto& bottom_positions = s_more_positions;
+
+		top_positions.clear();
+		bottom_positions.clear();
 
 		const auto top_scale = epsilonEqual(top_radius, 0.0f, 1e-6f)? 1e-6f : top_radius;
 		const auto bottom_scale = epsilonEqual(bottom_radius, 0.0f, 1e-6f)? 1e-6f : bottom_radius;
@@ -158,16 +297,15 @@ namespace tess
 		const auto top_offset = vec3(offset.x*0.5f, offset.y*0.5f, height * 0.5f);
 		const auto bottom_offset = vec3(-offset.x*0.5f, -offset.y*0.5f, -height * 0.5f);
 
-		auto delta_angle = (2.0f * pi<float>()) / static_cast<float>(segment_count);
-		auto angle = 0.0f;
+		const circle_steps circle(segment_count);
 
 		const auto top_slope_quat = quat(vec3(top_slope_angles.x, top_slope_angles.y, 0));
 		const auto bottom_slope_quat = quat(vec3(bottom_slope_angles.x, bottom_slope_angles.y, 0));
 
 		for(int i = 0; i < segment_count; ++i)
 		{
-			auto x = cos(angle);
-			auto y = sin(angle);
+			const auto x = circle[i].x;
+			const auto y = circle[i].y;
 
 			// top position
 			auto top_pos = vec3(x*top_scale, y*top_scale, 0.0f);
@@ -180,13 +318,14 @@ namespace tess
 			bottom_pos = bottom_slope_quat * bottom_pos;
 			bottom_pos += bottom_offset;
 			bottom_positions.push_back(bottom_pos);
-
-			angle += delta_angle;
 		}
 
 		const vec3 unit_z(0.0f, 0.0f, 1.0f);
 
-		triangle_mesh mesh;
+		// two body vertices per segment, one vertex per segment on each cap, two triangles per segment on the body and per pair of segments on each cap
+		const int cap_count = (segment_count - 2) / 2;
+		const int cap_flags = (with_top_cap? 1 : 0) + (with_bottom_cap? 1 : 0);
+		mesh_writer mesh(sink, segment_count * (2 + cap_flags), (segment_count * 2 + cap_count * 2 * cap_flags) * 3);
 
 		// -----------------------------------------------------------------------------------------------------------------------------------------------------
 		// vertices
@@ -195,16 +334,19 @@ namespace tess
 		int top_cap_start = 0;
 		int bottom_cap_start = 0;
 
-		if(with_caps)
+		// top cap
+		if(with_top_cap)
 		{
-			// top cap
 			top_cap_start = mesh.vertices.size();
 			for(int i = 0; i < segment_count; ++i)
 			{
 				mesh.vertices.push_back({top_positions[i], top_slope_quat * unit_z});
 			}
+		}
 
-			// bottom cap
+		// bottom cap
+		if(with_bottom_cap)
+		{
 			bottom_cap_start = mesh.vertices.size();
 			for(int i = 0; i < segment_count; ++i)
 			{
@@ -235,11 +377,9 @@ namespace tess
 		// elements
 		// -----------------------------------------------------------------------------------------------------------------------------------------------------
 
-		if(with_caps)
+		// top cap
+		if(with_top_cap)
 		{
-			int cap_count = (segment_count - 2) / 2;
-
-			// top cap
 			for(int i = 0; i < cap_count; ++i)
 			{
 				mesh.elements.push_back(top_cap_start + i + 1);
@@ -250,8 +390,11 @@ namespace tess
 				mesh.elements.push_back(top_cap_start + segment_count - (i+1));
 				mesh.elements.push_back(top_cap_start + i + 1);
 			}
+		}
 
-			// bottom cap
+		// bottom cap
+		if(with_bottom_cap)
+		{
 			for(int i = 0; i < cap_count; ++i)
 			{
 				mesh.elements.push_back(bottom_cap_start + i);
@@ -277,10 +420,24 @@ namespace tess
 			mesh.elements.push_back(body_start + (curr + 3) % body_limit);
 			mesh.elements.push_back(body_start + curr + 1);
 		}
+	}
 
-		return mesh;
+	triangle_mesh tessellate_cylinder(float radius, float height, const tessellation_quality& quality, bool with_caps /*= true*/)
+	{
+		return tessellate_cylinder(radius, height, quality.segment_count(radius), with_caps);
 	}
 
+	triangle_mesh tessellate_cone(float top_radius, float bottom_radius, float height, const tessellation_quality& quality, bool with_caps /*= true*/)
+	{
+		return tessellate_cone(top_radius, bottom_radius, height, quality.segment_count(std::max(top_radius, bottom_radius)), with_caps);
+	}
+
+	triangle_mesh tessellate_cone_slope_offset(float top_radius, float bottom_radius, float height, const vec2& top_slope_angles, const vec2& bottom_slope_angles,
+											   const vec2& offset, const tessellation_quality& quality, bool with_caps /*= true*/)
+	{
+		return tessellate_cone_slope_offset(top_radius, bottom_radius, height, top_slope_angles, bottom_slope_angles, offset,
+											quality.segment_count(std::max(top_radius, bottom_radius)), with_caps);
+	}
 
 	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
 	// truncated toroid
@@ -288,30 +445,56 @@ namespace tess
 	triangle_mesh tessellate_circular_torus(float in_radius, float out_radius, float sweep_angle,
 											int segment_count /*= 16*/, int sweep_count /*= 8*/, bool with_caps /*= false*/)
 	{
-		std::vector<vec3> positions;
-		std::vector<vec3> section_centers;
+		triangle_mesh mesh;
+		vector_sink sink(mesh.vertices, mesh.elements);
+		tessellate_circular_torus(sink, in_radius, out_radius, sweep_angle, segment_count, sweep_count, with_caps);
+		return mesh;
+	}
+
+	triangle_mesh tessellate_rectangular_torus(float in_radius, float out_radius, float in_height, float sweep_angle,
+											   int sweep_count /*= 8*/, bool with_caps /*= false*/)
+	{
+		triangle_mesh mesh;
+		vector_sink sink(mesh.vertices, mesh.elements);
+		tessellate_rectangular_torus(sink, in_radius, out_radius, in_height, sweep_angle, sweep_count, with_caps);
+		return mesh;
+	}
+
+	void tessellate_circular_torus(mesh_sink& sink, float in_radius, float out_radius, float sweep_angle,
+								   int segment_count /*= 16*/, int sweep_count /*= 8*/, bool with_caps /*= false*/)
+	{
+		auto& positions = s_positions;
+		auto& section_centers = s_more_positions;
+
+		positions.clear();
+		section_centers.clear();
 
-		auto xy_angle = 0.0f;
-		const auto xy_delta_angle = (2.0f * pi<float>()) / static_cast<float>(segment_count);
+		const circle_steps cross_section(segment_count);
 
 		auto sweep = 0.0f;
 		const auto sweep_delta_angle = sweep_angle / static_cast<float>(sweep_count);
 
 		for(int i = 0; i < sweep_count+1; ++i)
 		{
-			section_centers.push_back(vec3(out_radius * cos(sweep), out_radius * sin(sweep), 0.0f));
+			const auto sweep_cos = cos(sweep);
+			const auto sweep_sin = sin(sweep);
+
+			section_centers.push_back(vec3(out_radius * sweep_cos, out_radius * sweep_sin, 0.0f));
 			for(int j = 0; j < segment_count; ++j)
 			{
-				float section = out_radius + in_radius * sin(xy_angle);
-				positions.push_back({section * cos(sweep), section * sin(sweep), in_radius * cos(xy_angle)});
-				xy_angle += xy_delta_angle;
+				const auto xy = cross_section[j];
+				float section = out_radius + in_radius * xy.y;
+				positions.push_back({section * sweep_cos, section * sweep_sin, in_radius * xy.x});
 			}
 			sweep += sweep_delta_angle;
 		}
 
 		const vec3 unit_y = vec3(0.0f, 1.0f, 0.0f);
 
-		triangle_mesh mesh;
+		// one ring of vertices per sweep step plus the cap rings, two triangles per segment between rings and per pair of segments on each cap
+		const int cap_count = (segment_count - 2) / 2;
+		const int cap_flags = with_caps? 2 : 0;
+		mesh_writer mesh(sink, segment_count * (sweep_count + 1 + cap_flags), (segment_count * sweep_count * 2 + cap_count * 2 * cap_flags) * 3);
 
 		// -----------------------------------------------------------------------------------------------------------------------------------------------------
 		// vertices
@@ -362,8 +545,6 @@ namespace tess
 
 		if(with_caps)
 		{
-			int cap_count = (segment_count - 2) / 2;
-
 			// first cap
 			for(int i = 0; i < cap_count; ++i)
 			{
@@ -406,14 +587,13 @@ namespace tess
 				mesh.elements.push_back(body_start+curr_start+(j+1) % segment_count);
 			}
 		}
-
-		return mesh;
 	}
 
-	triangle_mesh tessellate_rectangular_torus(float in_radius, float out_radius, float in_height, float sweep_angle,
-											   int sweep_count /*= 8*/, bool with_caps /*= false*/)
+	void tessellate_rectangular_torus(mesh_sink& sink, float in_radius, float out_radius, float in_height, float sweep_angle,
+									  int sweep_count /*= 8*/, bool with_caps /*= false*/)
 	{
-		std::vector<vec3> positions;
+		auto& positions = s_positions;
+		positions.clear();
 
 		auto sweep = 0.0f;
 		const auto sweep_delta_angle = sweep_angle / static_cast<float>(sweep_count);
@@ -424,23 +604,27 @@ namespace tess
 		{
 			const auto inner_scale = out_radius - in_radius;
 			const auto outer_scale = out_radius + in_radius;
+			const auto sweep_cos = cos(sweep);
+			const auto sweep_sin = sin(sweep);
 
 			// lower inner corner
-			positions.push_back({inner_scale * cos(sweep), inner_scale * sin(sweep), -hh});
+			positions.push_back({inner_scale * sweep_cos, inner_scale * sweep_sin, -hh});
 
 			// lower outer corner
-			positions.push_back({outer_scale * cos(sweep), outer_scale * sin(sweep), -hh});
+			positions.push_back({outer_scale * sweep_cos, outer_scale * sweep_sin, -hh});
 
 			// upper outer corner
-			positions.push_back({outer_scale * cos(sweep), outer_scale * sin(sweep), hh});
+			positions.push_back({outer_scale * sweep_cos, outer_scale * sweep_sin, hh});
 
 			// upper inner corner
-			positions.push_back({inner_scale * cos(sweep), inner_scale * sin(sweep), hh});
+			positions.push_back({inner_scale * sweep_cos, inner_scale * sweep_sin, hh});
 
 			sweep += sweep_delta_angle;
 		}
 
-		triangle_mesh mesh;
+		// four vertices and two triangles on each cap, two vertices per sweep step and two triangles per sweep segment on each of the four sides
+		const int cap_flags = with_caps? 2 : 0;
+		mesh_writer mesh(sink, 4 * cap_flags + 8 * (sweep_count + 1), (2 * cap_flags + 8 * sweep_count) * 3);
 
 		// -----------------------------------------------------------------------------------------------------------------------------------------------------
 		// vertices
@@ -542,8 +726,22 @@ namespace tess
 			v1.normal = n;
 			v2.normal = n;
 		}
+	}
 
-		return mesh;
+	triangle_mesh tessellate_circular_torus(float in_radius, float out_radius, float sweep_angle, const tessellation_quality& quality, bool with_caps /*= false*/)
+	{
+		circular_torus t;
+		t.in_radius = in_radius;
+		t.out_radius = out_radius;
+		t.sweep_angle = sweep_angle;
+		quality.apply(t);
+		return tessellate_circular_torus(in_radius, out_radius, sweep_angle, t.segment_count, t.sweep_count, with_caps);
+	}
+
+	triangle_mesh tessellate_rectangular_torus(float in_radius, float out_radius, float in_height, float sweep_angle, const tessellation_quality& quality,
+											   bool with_caps /*= false*/)
+	{
+		return tessellate_rectangular_torus(in_radius, out_radius, in_height, sweep_angle, quality.sweep_count(out_radius + in_radius, sweep_angle), with_caps);
 	}
 
 	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -564,15 +762,36 @@ namespace tess
 									   float max_vertical_angle /*= glm::pi<float>()*/, bool bottom_cap /*= true*/)
 	{
 		triangle_mesh mesh;
+		vector_sink sink(mesh.vertices, mesh.elements);
+		tessellate_ellipsoid(sink, radii, horizontal_count, vertical_count, max_vertical_angle, bottom_cap);
+		return mesh;
+	}
+
+	void tessellate_dish(mesh_sink& sink, float radius, float height, int horizontal_count /*= 16*/, int vertical_count /*= 8*/, bool with_cap /*= false*/)
+	{
+		tessellate_ellipsoid(sink, vec3(radius, radius, height), horizontal_count, vertical_count, pi<float>()*0.5f, with_cap);
+	}
 
+	void tessellate_sphere(mesh_sink& sink, float radius, int horizontal_count /*= 16*/, int vertical_count /*= 16*/)
+	{
+		tessellate_ellipsoid(sink, vec3(radius, radius, radius), horizontal_count, vertical_count);
+	}
+
+	void tessellate_ellipsoid(mesh_sink& sink, const vec3& radii, int horizontal_count /*= 16*/, int vertical_count /*= 16*/,
+							  float max_vertical_angle /*= glm::pi<float>()*/, bool bottom_cap /*= true*/)
+	{
 		// -----------------------------------------------------------------------------------------------------------------------------------------------------
 		// vertices
 		// -----------------------------------------------------------------------------------------------------------------------------------------------------
 
-		const auto delta_horizontal_angle = (2.0f * pi<float>()) / static_cast<float>(horizontal_count);
+		const circle_steps ring(horizontal_count);
 		const auto delta_vertical_angle = max_vertical_angle / static_cast<float>(vertical_count);
 
-		auto vertical_angle = delta_vertical_angle;
+		// spheres and dishes step along a meridian of a circle with twice or four times as many segments as vertical steps
+		const auto vertical_turn_fraction = max_vertical_angle / (2.0f * pi<float>());
+		const auto meridian_segment_count = vertical_turn_fraction > 0.0f? static_cast<int>(std::round(vertical_count / vertical_turn_fraction)) : 0;
+		const bool has_meridian = std::abs(meridian_segment_count * vertical_turn_fraction - vertical_count) < 1e-4f;
+		const circle_steps meridian(has_meridian? meridian_segment_count : 1);
 
 		if(max_vertical_angle < glm::pi<float>())
 		{
@@ -581,6 +800,16 @@ namespace tess
 
 		const vec3 unit_z(0.0f, 0.0f, 1.0f);
 
+		// top vertex and one ring per vertical step, closed at the bottom by a single vertex or by a ring facing down
+		// top fan and one band of quads between consecutive rings, closed by a bottom fan or by a flat cap
+		const bool flat_bottom = max_vertical_angle < glm::pi<float>();
+		const int ring_count = std::max(vertical_count - 1, 0);
+		const int band_count = std::max(vertical_count - 2, 0);
+		const int bottom_vertex_count = bottom_cap? (flat_bottom? horizontal_count : 1) : 0;
+		const int bottom_triangle_count = bottom_cap? (flat_bottom? ((horizontal_count - 2) / 2) * 2 : horizontal_count) : 0;
+		mesh_writer mesh(sink, 1 + ring_count * horizontal_count + bottom_vertex_count,
+						 (horizontal_count + band_count * horizontal_count * 2 + bottom_triangle_count) * 3);
+
 		// top vertex
 		mesh.vertices.push_back({unit_z * radii.z, unit_z});
 
@@ -589,21 +818,20 @@ namespace tess
 		const auto inv_raddi_sqr = vec3(1.0f/radii2.x, 1.0f/radii2.y, 1.0f/radii2.z);
 		for(int v = 0; v < vertical_count-1; ++v)
 		{
-			float horizontal_angle = 0.0f;
+			const auto vertical_angle = delta_vertical_angle * static_cast<float>(v + 1);
+			const auto vertical = has_meridian? meridian[v + 1] : vec2(cos(vertical_angle), sin(vertical_angle));
 
 			for(int h = 0; h < horizontal_count; ++h)
 			{
+				const auto horizontal = ring[h];
 				vec3 pos;
-				pos.x = radii.x*sin(vertical_angle)*cos(horizontal_angle);
-				pos.y = radii.y*sin(vertical_angle)*sin(horizontal_angle);
-				pos.z = radii.z*cos(vertical_angle);
+				pos.x = radii.x*vertical.y*horizontal.x;
+				pos.y = radii.y*vertical.y*horizontal.y;
+				pos.z = radii.z*vertical.x;
 				vec3 nrm = pos;
 				nrm *= inv_raddi_sqr;
 				mesh.vertices.push_back({pos, normalize(nrm)});
-				horizontal_angle += delta_horizontal_angle;
 			}
-
-			vertical_angle += delta_vertical_angle;
 		}
 
 		// bottom vertices
@@ -682,14 +910,32 @@ namespace tess
 				}
 			}
 		}
+	}
 
-		return mesh;
+	triangle_mesh tessellate_dish(float radius, float height, const tessellation_quality& quality, bool with_cap /*= false*/)
+	{
+		return tessellate_ellipsoid(vec3(radius, radius, height), quality, pi<float>()*0.5f, with_cap);
+	}
+
+	triangle_mesh tessellate_sphere(float radius, const tessellation_quality& quality)
+	{
+		return tessellate_ellipsoid(vec3(radius, radius, radius), quality);
+	}
+
+	triangle_mesh tessellate_ellipsoid(const vec3& radii, const tessellation_quality& quality, float max_vertical_angle /*= glm::pi<float>()*/,
+									   bool bottom_cap /*= true*/)
+	{
+		// largest semi-axes bound the curvature of the horizontal and vertical profiles
+		const auto horizontal_count = quality.segment_count(std::max(radii.x, radii.y));
+		const auto vertical_count = std::max(quality.sweep_count(std::max(std::max(radii.x, radii.y), radii.z), max_vertical_angle), 2);
+		return tessellate_ellipsoid(radii, horizontal_count, vertical_count, max_vertical_angle, bottom_cap);
 	}
 
 	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
 	// polygonal mesh
 	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
-	static polygon_tessellator s_polygon_tessellator;
+	// one tessellator per thread, so polygonal meshes can be tessellated concurrently from different threads
+	static thread_local polygon_tessellator s_polygon_tessellator;
 
 	void tessellate_polygonal_begin()
 	{
@@ -701,8 +947,18 @@ namespace tess
 		s_polygon_tessellator.add_polygon(poly);
 	}
 
+	void tessellate_polygonal_add(const polygon_view& poly)
+	{
+		s_polygon_tessellator.add_polygon(poly);
+	}
+
 	triangle_mesh tessellate_polygonal_end()
 	{
 		return s_polygon_tessellator.end();
 	}
+
+	void tessellate_polygonal_end(mesh_sink& sink)
+	{
+		s_polygon_tessellator.end(sink);
+	}
 } // namespace tess
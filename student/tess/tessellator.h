@@ -1,14 +1,27 @@
 #pragma once
+#include <tess/mesh_sink.h>
 #include <tess/triangle_mesh.h>
+#include <tess/tessellation_quality.h>
 
 namespace tess
 {
+	// every generator also has an overload that writes into a caller-provided mesh_sink instead of returning a new triangle_mesh
+
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// approximation error
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// maximum distance between a circular arc and the polyline that approximates it using segment_count segments (chord deviation)
+	float arc_chord_error(float radius, float arc_angle, int segment_count);
+
 	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
 	// rectangular-base pyramid
 	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
 	triangle_mesh tessellate_box(const vec3& extents);
 	triangle_mesh tessellate_pyramid(const vec2& top_extents, const vec2& bottom_extents, float height, const vec2& offset = {0.0f, 0.0f});
 
+	void tessellate_box(mesh_sink& sink, const vec3& extents);
+	void tessellate_pyramid(mesh_sink& sink, const vec2& top_extents, const vec2& bottom_extents, float height, const vec2& offset = {0.0f, 0.0f});
+
 	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
 	// truncated cone
 	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -28,6 +41,33 @@ namespace tess
 										int segment_count = 16, const bool with_caps = true);
 	triangle_mesh tessellate_cone_slope_offset(float top_radius, float bottom_radius, float height, const vec2& top_slope_angles, const vec2& bottom_slope_angles,
 											   const vec2& offset, int segment_count = 16, bool with_caps = true);
+	triangle_mesh tessellate_cone_slope_offset(float top_radius, float bottom_radius, float height, const vec2& top_slope_angles, const vec2& bottom_slope_angles,
+											   const vec2& offset, int segment_count, bool with_top_cap, bool with_bottom_cap);
+
+	void tessellate_cylinder(mesh_sink& sink, float radius, float height,
+							 int segment_count = 16, bool with_caps = true);
+	void tessellate_cylinder_offset(mesh_sink& sink, float radius, float height, const vec2& offset,
+									int segment_count = 16, bool with_caps = true);
+	void tessellate_cylinder_slope(mesh_sink& sink, float radius, float height, const vec2& top_slope_angles, const vec2& bottom_slope_angles,
+								   int segment_count = 16, const bool with_caps = true);
+	void tessellate_cylinder_slope_offset(mesh_sink& sink, float radius, float height, const vec2& top_slope_angles, const vec2& bottom_slope_angles, const vec2& offset,
+										  int segment_count = 16, bool with_caps = true);
+	void tessellate_cone(mesh_sink& sink, float top_radius, float bottom_radius, float height,
+						 int segment_count = 16, bool with_caps = true);
+	void tessellate_cone_offset(mesh_sink& sink, float top_radius, float bottom_radius, float height, const vec2& offset,
+								int segment_count = 16, bool with_caps = true);
+	void tessellate_cone_slope(mesh_sink& sink, float top_radius, float bottom_radius, float height, const vec2& top_slope_angles, const vec2& bottom_slope_angles,
+							   int segment_count = 16, const bool with_caps = true);
+	void tessellate_cone_slope_offset(mesh_sink& sink, float top_radius, float bottom_radius, float height, const vec2& top_slope_angles, const vec2& bottom_slope_angles,
+									  const vec2& offset, int segment_count = 16, bool with_caps = true);
+	void tessellate_cone_slope_offset(mesh_sink& sink, float top_radius, float bottom_radius, float height, const vec2& top_slope_angles, const vec2& bottom_slope_angles,
+									  const vec2& offset, int segment_count, bool with_top_cap, bool with_bottom_cap);
+
+	// segment count derived from the chord error of the quality policy
+	triangle_mesh tessellate_cylinder(float radius, float height, const tessellation_quality& quality, bool with_caps = true);
+	triangle_mesh tessellate_cone(float top_radius, float bottom_radius, float height, const tessellation_quality& quality, bool with_caps = true);
+	triangle_mesh tessellate_cone_slope_offset(float top_radius, float bottom_radius, float height, const vec2& top_slope_angles, const vec2& bottom_slope_angles,
+											   const vec2& offset, const tessellation_quality& quality, bool with_caps = true);
 
 	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
 	// truncated toroid
@@ -37,6 +77,16 @@ namespace tess
 	triangle_mesh tessellate_rectangular_torus(float in_radius, float out_radius, float in_height, float sweep_angle,
 											   int sweep_count = 8, bool with_caps = false);
 
+	void tessellate_circular_torus(mesh_sink& sink, float in_radius, float out_radius, float sweep_angle,
+								   int segment_count = 16, int sweep_count = 8, bool with_caps = false);
+	void tessellate_rectangular_torus(mesh_sink& sink, float in_radius, float out_radius, float in_height, float sweep_angle,
+									  int sweep_count = 8, bool with_caps = false);
+
+	// segment and sweep counts derived from the chord error of the quality policy
+	triangle_mesh tessellate_circular_torus(float in_radius, float out_radius, float sweep_angle, const tessellation_quality& quality, bool with_caps = false);
+	triangle_mesh tessellate_rectangular_torus(float in_radius, float out_radius, float in_height, float sweep_angle, const tessellation_quality& quality,
+											   bool with_caps = false);
+
 	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
 	// ellipsoid
 	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -45,6 +95,16 @@ namespace tess
 	triangle_mesh tessellate_ellipsoid(const vec3& radii, int horizontal_count = 16, int vertical_count = 16,
 									   float max_vertical_angle = glm::pi<float>(), bool bottom_cap = true);
 
+	void tessellate_dish(mesh_sink& sink, float radius, float height, int horizontal_count = 16, int vertical_count = 8, bool with_cap = false);
+	void tessellate_sphere(mesh_sink& sink, float radius, int horizontal_count = 16, int vertical_count = 16);
+	void tessellate_ellipsoid(mesh_sink& sink, const vec3& radii, int horizontal_count = 16, int vertical_count = 16,
+							  float max_vertical_angle = glm::pi<float>(), bool bottom_cap = true);
+
+	// horizontal and vertical counts derived from the chord error of the quality policy
+	triangle_mesh tessellate_dish(float radius, float height, const tessellation_quality& quality, bool with_cap = false);
+	triangle_mesh tessellate_sphere(float radius, const tessellation_quality& quality);
+	triangle_mesh tessellate_ellipsoid(const vec3& radii, const tessellation_quality& quality, float max_vertical_angle = glm::pi<float>(), bool bottom_cap = true);
+
 	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
 	// polygonal mesh
 	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -61,7 +121,19 @@ namespace tess
 	{
 		std::vector<contour> contours;
 	};
+
+	// non-owning polygon: contour i goes from points[contour_offsets[i]] up to points[contour_offsets[i + 1]], so there are contour_count + 1 offsets
+	// the points of many polygons can share a buffer reused from one mesh to the next, so polygons are added without allocating anything per face
+	struct polygon_view
+	{
+		const point* points = nullptr;
+		const unsigned int* contour_offsets = nullptr;
+		unsigned int contour_count = 0;
+	};
+
 	void tessellate_polygonal_begin();
 	void tessellate_polygonal_add(const polygon& poly);
+	void tessellate_polygonal_add(const polygon_view& poly);
 	triangle_mesh tessellate_polygonal_end();
+	void tessellate_polygonal_end(mesh_sink& sink);
 } // namespace tess
@@ -0,0 +1,53 @@
+#include <tess/unit_circle.h>
+#include <array>
+#include <cmath>
+#include <utility>
+
+namespace tess
+{
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+	// baked circles, indexed by (segment_count - 4) / 2
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	struct baked_circle
+	{
+		const float* cos;
+		const float* sin;
+	};
+
+	static const int BAKED_CIRCLE_COUNT = (circle_steps::MAX_BAKED_SEGMENT_COUNT - 4) / 2 + 1;
+
+	template<int... I>
+	static std::array<baked_circle, sizeof...(I)> make_baked_circles(std::integer_sequence<int, I...>)
+	{
+		return {{{unit_circle<4 + 2 * I>::table.cos, unit_circle<4 + 2 * I>::table.sin}...}};
+	}
+
+	static const auto s_baked_circles = make_baked_circles(std::make_integer_sequence<int, BAKED_CIRCLE_COUNT>());
+
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+	// circle_steps
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	circle_steps::circle_steps(int segment_count) : _cos(nullptr), _sin(nullptr), _segment_count(segment_count)
+	{
+		if(segment_count >= 4 && segment_count <= MAX_BAKED_SEGMENT_COUNT && segment_count % 2 == 0)
+		{
+			const auto& baked = s_baked_circles[(segment_count - 4) / 2];
+			_cos = baked.cos;
+			_sin = baked.sin;
+		}
+	}
+
+	bool circle_steps::is_baked() const
+	{
+		return _cos != nullptr;
+	}
+
+	vec2 circle_steps::_compute(int i) const
+	{
+		// same angles as the baked tables, in double precision
+		const auto angle = 2.0 * ct::PI * (i % _segment_count) / _segment_count;
+		return vec2(static_cast<float>(std::cos(angle)), static_cast<float>(std::sin(angle)));
+	}
+} // namespace tess
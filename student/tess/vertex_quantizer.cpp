@@ -0,0 +1,126 @@
+#include <tess/vertex_quantizer.h>
+#include <cmath>
+#include <limits>
+
+namespace tess
+{
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+	// global constants
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	static const float MAX_UNORM16 = 65535.0f;
+	static const float MAX_SNORM16 = 32767.0f;
+
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+	// octahedral mapping: the unit sphere is projected onto the octahedron |x| + |y| + |z| = 1, whose lower half is folded over the upper one
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	static float sign_not_zero(float v)
+	{
+		return v >= 0.0f? 1.0f : -1.0f;
+	}
+
+	static short encode_snorm16(float v)
+	{
+		return static_cast<short>(std::round(clamp(v, -1.0f, 1.0f) * MAX_SNORM16));
+	}
+
+	static void encode_octahedral(const vec3& n, short result[2])
+	{
+		const auto l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+		if(!(l1 > 0.0f))
+		{
+			result[0] = 0;
+			result[1] = 0;
+			return;
+		}
+
+		auto p = vec2(n.x, n.y) / l1;
+		if(n.z < 0.0f)
+		{
+			p = vec2((1.0f - std::abs(p.y)) * sign_not_zero(p.x), (1.0f - std::abs(p.x)) * sign_not_zero(p.y));
+		}
+
+		result[0] = encode_snorm16(p.x);
+		result[1] = encode_snorm16(p.y);
+	}
+
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+	// quantization
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	bool quantization::operator==(const quantization& other) const
+	{
+		return origin == other.origin && size == other.size;
+	}
+
+	mat4 quantization::to_matrix() const
+	{
+		return scale(translate(mat4(1.0f), origin), vec3(size));
+	}
+
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+	// vertex_quantizer
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	quantization vertex_quantizer::fit(const vertex* vertices, unsigned int count)
+	{
+		vec3 min_corner(std::numeric_limits<float>::max());
+		vec3 max_corner(-std::numeric_limits<float>::max());
+
+		for(unsigned int i = 0; i < count; ++i)
+		{
+			min_corner = min(min_corner, vertices[i].position);
+			max_corner = max(max_corner, vertices[i].position);
+		}
+
+		if(count == 0)
+		{
+			return {vec3(0.0f), 1.0f};
+		}
+
+		const auto extents = max_corner - min_corner;
+		const auto size = max(extents.x, max(extents.y, extents.z));
+
+		// a single point still needs an invertible matrix
+		return {min_corner, size > 0.0f? size : 1.0f};
+	}
+
+	float vertex_quantizer::pack(const vertex* vertices, unsigned int count, const quantization& q, packed_vertex* result)
+	{
+		float max_error = 0.0f;
+
+		for(unsigned int i = 0; i < count; ++i)
+		{
+			const auto p = clamp((vertices[i].position - q.origin) / q.size, 0.0f, 1.0f) * MAX_UNORM16;
+
+			auto& v = result[i];
+			v.position[0] = static_cast<unsigned short>(std::round(p.x));
+			v.position[1] = static_cast<unsigned short>(std::round(p.y));
+			v.position[2] = static_cast<unsigned short>(std::round(p.z));
+			v.position[3] = 0;
+			encode_octahedral(vertices[i].normal, v.normal);
+
+			max_error = max(max_error, distance(vertices[i].position, decode_position(v, q)));
+		}
+
+		return max_error;
+	}
+
+	vec3 vertex_quantizer::decode_position(const packed_vertex& v, const quantization& q)
+	{
+		return q.origin + q.size * vec3(v.position[0], v.position[1], v.position[2]) / MAX_UNORM16;
+	}
+
+	vec3 vertex_quantizer::decode_normal(const packed_vertex& v)
+	{
+		// same as the vertex shaders
+		auto n = vec3(max(v.normal[0] / MAX_SNORM16, -1.0f), max(v.normal[1] / MAX_SNORM16, -1.0f), 0.0f);
+		n.z = 1.0f - std::abs(n.x) - std::abs(n.y);
+
+		const auto t = max(-n.z, 0.0f);
+		n.x += n.x >= 0.0f? -t : t;
+		n.y += n.y >= 0.0f? -t : t;
+		return normalize(n);
+	}
+} // namespace tess
@@ -0,0 +1,47 @@
+#pragma once
+#include <tess/triangle_mesh.h>
+
+namespace tess
+{
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// packed_vertex: 12-byte vertex, half the size of vertex
+	// position holds unsigned normalized 16-bit coordinates inside a quantization cube (the fourth one is padding)
+	// normal holds a signed normalized 16-bit octahedral encoding of the unit normal
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	struct packed_vertex
+	{
+		unsigned short position[4];
+		short normal[2];
+	};
+
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// quantization: cube that position coordinates are quantized in, decoded as origin + size * position / 65535
+	// a cube keeps dequantization a uniform scale, so it can be folded into a model matrix without changing how normals transform
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	struct quantization
+	{
+		vec3 origin;
+		float size;
+
+		bool operator==(const quantization& other) const;
+
+		// affine transform from normalized packed positions in [0, 1] back to vertex positions
+		mat4 to_matrix() const;
+	};
+
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// vertex_quantizer: packs vertices into packed_vertex
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	class vertex_quantizer
+	{
+	public:
+		// smallest cube with the same minimum corner as the bounds of vertices
+		static quantization fit(const vertex* vertices, unsigned int count);
+
+		// pack vertices, which must lie inside q, and return the largest distance between a position and its decoded value
+		static float pack(const vertex* vertices, unsigned int count, const quantization& q, packed_vertex* result);
+
+		static vec3 decode_position(const packed_vertex& v, const quantization& q);
+		static vec3 decode_normal(const packed_vertex& v);
+	};
+} // namespace tess
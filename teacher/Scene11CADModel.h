@@ -5,10 +5,36 @@
 #include <ShaderData.h>
 #include <ShaderLoader.h>
 #include <Random.h>
+#include <Timer.h>
 #include <rvm/FileReader.h>
 #include <rvm/StatsCollector.h>
-#include <tess/tessellator.h>
-#include <tess/mesh_optimizer.h>
+#include <tess/batch_tessellator.h>
+#include <tess/cap_culler.h>
+#include <tess/tessellation_quality.h>
+#include <tess/vertex_quantizer.h>
+#include <algorithm>
+
+// maximum distance between curved surfaces and their tessellation, in model units
+static const float TESS_MAX_CHORD_ERROR = 0.005f;
+
+// optimizations applied to polygonal meshes: compare frame times in the window title against e.g. flag_remove_unused_vertices | flag_weld_vertices_exact
+static const tess::mesh_optimizer::flag TESS_POLYGONAL_OPTIMIZATIONS = tess::mesh_optimizer::flag_all_optimizations;
+
+// with flag_weld_vertices_nearby added to the optimizations above, polygonal vertices closer than this (model units) with normals within this angle (radians)
+// are welded, and triangles collapsed by welding are dropped
+static const float TESS_WELD_DISTANCE = 1e-4f;
+static const float TESS_WELD_ANGLE = 1e-2f;
+
+// meshes with at most this many vertices store their elements in 16 bits, larger ones in 32 bits
+static const unsigned int MAX_SHORT_ELEMENT_VERTICES = 65536;
+
+// boxes, cylinders and spheres are tessellated at unit size, their dimensions folded into the transform (the vertex shader already corrects normals),
+// and all parametric primitives sharing a cached mesh are drawn with a single instanced command: compare the GPU memory printed when loading against true
+static const bool TESS_UNIT_PRIMITIVES = false;
+
+// cylinders, cones, tori, dishes and spheres are not tessellated: Scene11CADModelProcedural.vert generates their triangles from a PrimitiveData record
+// this takes precedence over TESS_UNIT_PRIMITIVES, which is usually smaller because procedural primitives need one record and draw command each
+static const bool TESS_PROCEDURAL_PRIMITIVES = false;
 
 struct ModelData
 {
@@ -20,138 +46,703 @@ struct ModelData
 	GLuint materialsSSBO;
 	std::vector<MaterialData> materials;
 
+	// drawables are drawn in two batches, one per element type: commands of 16-bit elements come first in the buffer
 	GLuint drawCmdsBuffer;
+	std::vector<DrawCommand> shortDrawCmds;
 	std::vector<DrawCommand> drawCmds;
 	std::vector<tess::vertex> vertices;
+	std::vector<tess::packed_vertex> packedVertices; // same indices as vertices, uploaded instead of them if QUANTIZE_VERTICES
+
+	GLuint shortElementsBuffer;
+	std::vector<GLushort> shortElements;
+	GLuint elementsBuffer;
 	std::vector<tess::element> elements;
 
 	GLuint program;
+
+	// procedural primitives have their own drawables, drawn without vertex and element buffers by their own program
+	GLuint proceduralVao;
+	GLuint primitivesSSBO;
+	std::vector<PrimitiveData> primitives;
+	GLuint proceduralTransformsSSBO;
+	std::vector<TransformData> proceduralTransforms;
+	GLuint proceduralMaterialsSSBO;
+	std::vector<MaterialData> proceduralMaterials;
+	GLuint proceduralDrawCmdsBuffer;
+	std::vector<DrawArraysCommand> proceduralDrawCmds;
+	GLuint proceduralProgram;
 };
 
 class ModelLoader : public rvm::FileReader::IObserver
 {
 public:
-	ModelLoader(ModelData* model) {_model = model;}
+	// threadCount = 0 uses one tessellation thread per hardware core
+	ModelLoader(ModelData* model, unsigned int threadCount = 0) : _tessellator(threadCount), _quality(TESS_MAX_CHORD_ERROR)
+	{
+		_model = model;
+		_tessellator.set_cache(&_cache);
+		_cache.set_mesh_comparator([this](unsigned int id, const tess::vertex* vertices, unsigned int vertexCount, const tess::element* elements, unsigned int elementCount)
+		{
+			return sameMesh(id, vertices, vertexCount, elements, elementCount);
+		});
+		_tessellator.set_polygonal_optimizations(TESS_POLYGONAL_OPTIMIZATIONS);
+		_tessellator.set_polygonal_weld_tolerances(TESS_WELD_DISTANCE, TESS_WELD_ANGLE);
+		_tessellator.set_collect_polygonal_stats(true);
+	}
 
 	virtual void validPrimitive(const rvm::Box& b)
 	{
-		storeMesh(tess::tessellate_box(glm::make_vec3(b.lengths)), glm::make_mat4(b.transform));
+		tess::box p;
+		p.extents = glm::make_vec3(b.lengths);
+
+		auto m4 = glm::make_mat4(b.transform);
+		toUnit(p, m4);
+		_batch.add(p);
+		queuePrimitive(m4);
 	}
 
 	virtual void validPrimitive(const rvm::Sphere& s)
 	{
-		storeMesh(tess::tessellate_sphere(s.radius), glm::make_mat4(s.transform));
+		tess::sphere p;
+		p.radius = s.radius;
+		addAdaptive(p, glm::make_mat4(s.transform));
 	}
 
 	virtual void validPrimitive(const rvm::Cylinder& c)
 	{
-		storeMesh(tess::tessellate_cylinder(c.radius, c.height), glm::make_mat4(c.transform));
+		tess::cylinder p;
+		p.radius = c.radius;
+		p.height = c.height;
+
+		const auto m4 = glm::make_mat4(c.transform);
+		_caps.add(addAdaptive(p, m4), p, m4);
 	}
 
 	virtual void validPrimitive(const rvm::Dish& d)
 	{
-		storeMesh(tess::tessellate_dish(d.radius, d.height), glm::make_mat4(d.transform));
+		tess::dish p;
+		p.radius = d.radius;
+		p.height = d.height;
+
+		const auto m4 = glm::make_mat4(d.transform);
+		addAdaptive(p, m4);
+		_caps.add(p, m4);
 	}
 
 	virtual void validPrimitive(const rvm::Pyramid& p)
 	{
-		storeMesh(tess::tessellate_pyramid(glm::make_vec2(p.topLengths), glm::make_vec2(p.bottomLengths), p.height, glm::make_vec2(p.offset)),
-				  glm::make_mat4(p.transform));
+		tess::pyramid t;
+		t.top_extents = glm::make_vec2(p.topLengths);
+		t.bottom_extents = glm::make_vec2(p.bottomLengths);
+		t.height = p.height;
+		t.offset = glm::make_vec2(p.offset);
+		_batch.add(t);
+		queuePrimitive(glm::make_mat4(p.transform));
 	}
 
 	virtual void validPrimitive(const rvm::RectangularTorus& t)
 	{
-		storeMesh(tess::tessellate_rectangular_torus(t.internalRadius, t.externalRadius, t.height, t.sweepAngle), glm::make_mat4(t.transform));
+		tess::rectangular_torus p;
+		p.in_radius = t.internalRadius;
+		p.out_radius = t.externalRadius;
+		p.in_height = t.height;
+		p.sweep_angle = t.sweepAngle;
+		addAdaptive(p, glm::make_mat4(t.transform));
 	}
 
 	virtual void validPrimitive(const rvm::CircularTorus& t)
 	{
-		storeMesh(tess::tessellate_circular_torus(t.internalRadius, t.externalRadius, t.sweepAngle), glm::make_mat4(t.transform));
+		tess::circular_torus p;
+		p.in_radius = t.internalRadius;
+		p.out_radius = t.externalRadius;
+		p.sweep_angle = t.sweepAngle;
+
+		const auto m4 = glm::make_mat4(t.transform);
+		addAdaptive(p, m4);
+		_caps.add(p, m4);
 	}
 
 	virtual void validPrimitive(const rvm::Cone& c)
 	{
-		storeMesh(tess::tessellate_cone(c.radiusTop, c.radiusBottom, c.height),  glm::make_mat4(c.transform));
+		tess::cone p;
+		p.top_radius = c.radiusTop;
+		p.bottom_radius = c.radiusBottom;
+		p.height = c.height;
+
+		const auto m4 = glm::make_mat4(c.transform);
+		_caps.add(addAdaptive(p, m4), p, m4);
 	}
 
 	virtual void validPrimitive(const rvm::SlopedCone& c)
 	{
-		storeMesh(tess::tessellate_cone_slope_offset(c.radiusTop, c.radiusBottom, c.height, glm::make_vec2(c.topSlopeAngle),
-											   glm::make_vec2(c.bottomSlopeAngle), glm::make_vec2(c.offset)),
-				  glm::make_mat4(c.transform));
+		tess::cone_slope_offset p;
+		p.top_radius = c.radiusTop;
+		p.bottom_radius = c.radiusBottom;
+		p.height = c.height;
+		p.top_slope_angles = glm::make_vec2(c.topSlopeAngle);
+		p.bottom_slope_angles = glm::make_vec2(c.bottomSlopeAngle);
+		p.offset = glm::make_vec2(c.offset);
+
+		const auto m4 = glm::make_mat4(c.transform);
+		_caps.add(addAdaptive(p, m4), p, m4);
 	}
 
 	virtual void validPrimitive(const rvm::Mesh& mesh)
 	{
-		tess::tessellate_polygonal_begin();
+		_batch.begin_polygonal();
 
 		for(const auto& face : mesh.faces)
 		{
-			tess::polygon tpoly;
-			tpoly.contours.reserve(face.polygons.size());
+			// every face is read into the same buffers, so faces are added without allocating once they are large enough
+			_facePoints.clear();
+			_faceContours.assign(1, 0);
 
 			for(const auto& poly : face.polygons)
 			{
-				tess::contour tcontour;
-				tcontour.points.reserve(poly.points.size());
-
 				for(const auto& point : poly.points)
 				{
 					tess::point tpoint;
 					tpoint.vertex = make_vec3(point.vertex);
 					tpoint.normal = make_vec3(point.normal);
-					tcontour.points.push_back(tpoint);
+					_facePoints.push_back(tpoint);
 				}
 
-				tpoly.contours.push_back(tcontour);
+				_faceContours.push_back(_facePoints.size());
 			}
 
-			tess::tessellate_polygonal_add(tpoly);
+			tess::polygon_view view;
+			view.points = _facePoints.data();
+			view.contour_offsets = _faceContours.data();
+			view.contour_count = face.polygons.size();
+			_batch.add_polygon(view);
 		}
 
-		auto data = tess::tessellate_polygonal_end();
-
-		if(!data.is_valid())
-		{
-			return;
-		}
-
-		tess::mesh_optimizer opt;
-		opt.optimize(data, tess::mesh_optimizer::flag_all_optimizations);
-
-		storeMesh(data, make_mat4(mesh.transform));
+		_batch.end_polygonal();
+		queuePrimitive(make_mat4(mesh.transform), true);
 	}
 
 	virtual void beginBlock(rvm::CntBegin& block)
 	{
+		// primitives of the previous group are complete: remove the caps hidden between them
+		cullCaps();
+
 		rvm::Material m = _materials.getMaterial(block.colorCode);
 		_currMaterial.diffuse = glm::make_vec4(m.diffuseColor);
 		_currMaterial.specular = glm::make_vec4(m.specularColor);
 		_currMaterial.specular.w = m.shininess;
 	}
 
+	virtual void endRead()
+	{
+		// the last group ends with the file
+		cullCaps();
+
+		// tessellate everything read from the file in parallel and append results in file order
+		Timer t;
+		_tessellator.tessellate(_batch, _result);
+		double msec = t.msec();
+
+		std::cout << "tessellated " << _batch.size() << " primitives in " << msec << " ms using " << _tessellator.get_thread_count() << " threads... ";
+
+		const auto& stats = _cache.get_stats();
+		const auto lookups = stats.hits + stats.misses;
+		std::cout << "cache hits: " << stats.hits << "/" << lookups << " (" << (lookups > 0? 100.0 * stats.hits / lookups : 0.0) << "%), saved " <<
+		             stats.saved_msec << " ms, " << stats.saved_vertex_bytes / 1024 << " KB vertices, " << stats.saved_element_bytes / 1024 << " KB elements... ";
+
+		// identical polygonal meshes share the geometry of the first one, they only get a transform and a material of their own
+		const auto meshes = stats.mesh_hits + stats.mesh_misses;
+		std::cout << "unique polygonal meshes: " << stats.mesh_misses << "/" << meshes << " (" << (meshes > 0? 100.0 * stats.mesh_misses / meshes : 0.0) <<
+		             "%), saved " << stats.saved_mesh_bytes / 1024 << " KB... ";
+		_cache.reset_stats();
+
+		std::cout << "adaptive tessellation: " << _adaptiveTriangles << " triangles instead of " << _fixedTriangles << " (" <<
+		             (_fixedTriangles > 0? 100.0 - 100.0 * _adaptiveTriangles / _fixedTriangles : 0.0) << "% fewer)... ";
+		_adaptiveTriangles = 0;
+		_fixedTriangles = 0;
+
+		std::cout << "hidden caps removed: " << _capsRemoved << "... ";
+		_capsRemoved = 0;
+
+		const auto before = _tessellator.get_polygonal_input_stats();
+		const auto after = _tessellator.get_polygonal_output_stats();
+		std::cout << "polygonal meshes: ACMR " << before.acmr() << " -> " << after.acmr() << ", ATVR " << before.atvr() << " -> " << after.atvr() <<
+		             ", overfetch " << before.overfetch() << " -> " << after.overfetch() << "... ";
+
+		const auto welded = _tessellator.get_polygonal_weld_stats();
+		std::cout << "nearby vertices welded: " << welded.removed_vertices << " (" << welded.removed_triangles << " collapsed triangles) in " <<
+		             welded.msec << " ms... ";
+
+		const auto paths = _tessellator.get_polygon_path_stats();
+		const auto polygons = static_cast<double>(paths.polygons());
+		std::cout << "polygons: " << (polygons > 0.0? 100.0 * paths.fan_polygons / polygons : 0.0) << "% fans, " <<
+		             (polygons > 0.0? 100.0 * paths.ear_clipped_polygons / polygons : 0.0) << "% ear clipped, " <<
+		             (polygons > 0.0? 100.0 * paths.swept_polygons / polygons : 0.0) << "% glutess... ";
+		_tessellator.reset_polygonal_stats();
+
+		storeBatch();
+		storeProcedural();
+
+		const auto elementCount = _model->shortElements.size() + _model->elements.size();
+		std::cout << "elements: " << (_model->shortElements.size() * sizeof(GLushort) + _model->elements.size() * sizeof(tess::element)) / 1024 <<
+		             " KB instead of " << elementCount * sizeof(tess::element) / 1024 << " KB in 32 bits (" <<
+		             (elementCount > 0? 100.0 * _model->shortElements.size() / elementCount : 0.0) << "% in 16 bits)... ";
+
+		if(QUANTIZE_VERTICES)
+		{
+			std::cout << "vertices: " << _model->packedVertices.size() * sizeof(tess::packed_vertex) / 1024 << " KB instead of " <<
+			             _model->vertices.size() * sizeof(tess::vertex) / 1024 << " KB, max quantization error " << _maxQuantizationError << "... ";
+		}
+
+		const auto drawCmdCount = _model->shortDrawCmds.size() + _model->drawCmds.size();
+		std::cout << "unit primitives: " << _unitPrimitives << ", " << _model->transforms.size() << " drawables in " << drawCmdCount << " draw commands... ";
+		_unitPrimitives = 0;
+
+		const auto proceduralCount = _model->primitives.size();
+		std::cout << "procedural primitives: " << proceduralCount << "... ";
+
+		// every buffer Scene::initialize creates, the draw ID buffer holding one int per drawable of the larger of both sets
+		const auto vertexBytes = QUANTIZE_VERTICES? _model->packedVertices.size() * sizeof(tess::packed_vertex) : _model->vertices.size() * sizeof(tess::vertex);
+		const auto elementBytes = _model->shortElements.size() * sizeof(GLushort) + _model->elements.size() * sizeof(tess::element);
+		const auto drawableBytes = (_model->transforms.size() + proceduralCount) * (sizeof(TransformData) + sizeof(MaterialData)) +
+		                           std::max(_model->transforms.size(), proceduralCount) * sizeof(int);
+		const auto primitiveBytes = proceduralCount * sizeof(PrimitiveData);
+		const auto drawCmdBytes = drawCmdCount * sizeof(DrawCommand) + proceduralCount * sizeof(DrawArraysCommand);
+		std::cout << "GPU memory: " << (vertexBytes + elementBytes + drawableBytes + primitiveBytes + drawCmdBytes) / 1024 << " KB (" <<
+		             vertexBytes / 1024 << " KB vertices, " << elementBytes / 1024 << " KB elements, " << drawableBytes / 1024 << " KB drawables, " <<
+		             primitiveBytes / 1024 << " KB procedural primitives, " << drawCmdBytes / 1024 << " KB draw commands)... ";
+
+		_batch.clear();
+		_queued.clear();
+		_proceduralBatch.clear();
+		_proceduralQueued.clear();
+	}
+
 private:
-	void storeMesh(const tess::triangle_mesh& mesh, const glm::mat4& m4)
+	struct QueuedPrimitive
+	{
+		glm::mat4 transform;
+		MaterialData material;
+		bool polygonal; // identical polygonal meshes share geometry but keep one draw command each
+	};
+
+	struct CachedRange
+	{
+		unsigned int firstElement;
+		unsigned int baseVertex;
+		bool shortElements;
+		tess::quantization quantization;
+		float quantizationError; // in model units
+	};
+
+	struct QueuedProcedural
+	{
+		unsigned int position; // in _proceduralBatch, whose only purpose is cap culling
+		PrimitiveData data;
+		unsigned int triangleCount; // with all caps of a cone
+		glm::mat4 transform;
+		MaterialData material;
+	};
+
+	// drawable waiting to be grouped with the others sharing its cache entry
+	struct Instance
+	{
+		unsigned int cacheEntry;
+		unsigned int range;
+		CachedRange cachedRange;
+	};
+
+	void queuePrimitive(const glm::mat4& m4, bool polygonal = false)
+	{
+		_queued.push_back({m4, _currMaterial, polygonal});
+	}
+
+	// derive segment counts of a curved primitive from its size in model units
+	template<typename T>
+	unsigned int addAdaptive(T& p, const glm::mat4& m4)
+	{
+		// default counts of the primitive are the fixed ones used without a quality policy
+		_fixedTriangles += tess::triangle_count(p);
+
+		const auto scale = glm::max(glm::length(glm::vec3(m4[0])), glm::max(glm::length(glm::vec3(m4[1])), glm::length(glm::vec3(m4[2]))));
+		_quality.apply(p, scale);
+		_adaptiveTriangles += tess::triangle_count(p);
+
+		// round primitives drawn procedurally are only added to a batch to have their hidden caps removed
+		PrimitiveData data;
+		if(TESS_PROCEDURAL_PRIMITIVES && toProcedural(p, data))
+		{
+			const auto position = _proceduralBatch.add(p);
+			_proceduralQueued.push_back({position, data, tess::triangle_count(p), m4, _currMaterial});
+			return position;
+		}
+
+		// segment counts still come from the actual size, callers keep using p and m4 for cap culling
+		auto unit = p;
+		auto transform = m4;
+		toUnit(unit, transform);
+
+		const auto position = _batch.add(unit);
+		queuePrimitive(transform);
+		return position;
+	}
+
+	// map a primitive onto its unit-sized version and fold its dimensions into the transform
+	// flat primitives are kept as they are, their scaled transform would not be invertible
+	void toUnit(tess::box& p, glm::mat4& m4)
+	{
+		if(TESS_UNIT_PRIMITIVES && p.extents.x > 0.0f && p.extents.y > 0.0f && p.extents.z > 0.0f)
+		{
+			m4 = glm::scale(m4, p.extents);
+			p.extents = glm::vec3(1.0f);
+			++_unitPrimitives;
+		}
+	}
+
+	void toUnit(tess::cylinder& p, glm::mat4& m4)
+	{
+		if(TESS_UNIT_PRIMITIVES && p.radius > 0.0f && p.height > 0.0f)
+		{
+			m4 = glm::scale(m4, glm::vec3(p.radius, p.radius, p.height));
+			p.radius = 1.0f;
+			p.height = 1.0f;
+			++_unitPrimitives;
+		}
+	}
+
+	void toUnit(tess::sphere& p, glm::mat4& m4)
+	{
+		if(TESS_UNIT_PRIMITIVES && p.radius > 0.0f)
+		{
+			m4 = glm::scale(m4, glm::vec3(p.radius));
+			p.radius = 1.0f;
+			++_unitPrimitives;
+		}
+	}
+
+	// other primitives have more than one independent dimension per axis (e.g. both radii of a torus)
+	template<typename T>
+	void toUnit(T&, glm::mat4&)
+	{
+	}
+
+	// parameters read by Scene11CADModelProcedural.vert, cone caps are set once hidden ones are removed
+	static bool toProcedural(const tess::cylinder& c, PrimitiveData& p)
+	{
+		setCone(c.radius, c.radius, c.height, glm::vec2(), glm::vec2(), glm::vec2(), c.segment_count, p);
+		return true;
+	}
+
+	static bool toProcedural(const tess::cone& c, PrimitiveData& p)
+	{
+		setCone(c.top_radius, c.bottom_radius, c.height, glm::vec2(), glm::vec2(), glm::vec2(), c.segment_count, p);
+		return true;
+	}
+
+	static bool toProcedural(const tess::cone_slope_offset& c, PrimitiveData& p)
+	{
+		setCone(c.top_radius, c.bottom_radius, c.height, c.top_slope_angles, c.bottom_slope_angles, c.offset, c.segment_count, p);
+		return true;
+	}
+
+	static bool toProcedural(const tess::circular_torus& t, PrimitiveData& p)
+	{
+		p.params = glm::vec4(t.in_radius, t.out_radius, t.sweep_angle, 0.0f);
+		p.topSlope = glm::vec4(0.0f);
+		p.bottomSlope = glm::vec4(0.0f);
+		p.type = PRIMITIVE_TORUS;
+		p.segmentCount = t.segment_count;
+		p.sweepCount = t.sweep_count;
+		p.caps = 0;
+		return true;
+	}
+
+	static bool toProcedural(const tess::dish& d, PrimitiveData& p)
+	{
+		setEllipsoid(glm::vec3(d.radius, d.radius, d.height), glm::half_pi<float>(), d.horizontal_count, d.vertical_count, p);
+		return true;
+	}
+
+	static bool toProcedural(const tess::sphere& s, PrimitiveData& p)
+	{
+		setEllipsoid(glm::vec3(s.radius), glm::pi<float>(), s.horizontal_count, s.vertical_count, p);
+		return true;
+	}
+
+	template<typename T>
+	static bool toProcedural(const T&, PrimitiveData&)
+	{
+		return false;
+	}
+
+	static void setCone(float topRadius, float bottomRadius, float height, const glm::vec2& topSlopeAngles, const glm::vec2& bottomSlopeAngles,
+	                    const glm::vec2& offset, int segmentCount, PrimitiveData& p)
+	{
+		// same rotations and degenerate radii as tess::tessellate_cone_slope_offset, quaternions negated to have w >= 0
+		auto topSlope = glm::quat(glm::vec3(topSlopeAngles.x, topSlopeAngles.y, 0.0f));
+		auto bottomSlope = glm::quat(glm::vec3(bottomSlopeAngles.x, bottomSlopeAngles.y, 0.0f));
+		topSlope = topSlope.w < 0.0f? -topSlope : topSlope;
+		bottomSlope = bottomSlope.w < 0.0f? -bottomSlope : bottomSlope;
+
+		p.params = glm::vec4(glm::abs(topRadius) < 1e-6f? 1e-6f : topRadius, glm::abs(bottomRadius) < 1e-6f? 1e-6f : bottomRadius, height, offset.x);
+		p.topSlope = glm::vec4(topSlope.x, topSlope.y, topSlope.z, offset.y);
+		p.bottomSlope = glm::vec4(bottomSlope.x, bottomSlope.y, bottomSlope.z, 0.0f);
+		p.type = PRIMITIVE_CONE;
+		p.segmentCount = segmentCount;
+		p.sweepCount = 0;
+		p.caps = PRIMITIVE_CAP_TOP | PRIMITIVE_CAP_BOTTOM;
+	}
+
+	static void setEllipsoid(const glm::vec3& radii, float maxVerticalAngle, int horizontalCount, int verticalCount, PrimitiveData& p)
+	{
+		p.params = glm::vec4(radii, maxVerticalAngle);
+		p.topSlope = glm::vec4(0.0f);
+		p.bottomSlope = glm::vec4(0.0f);
+		p.type = PRIMITIVE_ELLIPSOID;
+		p.segmentCount = horizontalCount;
+		p.sweepCount = verticalCount;
+		p.caps = maxVerticalAngle < glm::pi<float>()? 0 : PRIMITIVE_CAP_BOTTOM; // dishes are open, spheres end at the bottom pole
+	}
+
+	// model-space box around a procedural primitive: each end of a cone is a disc, which lies inside the rotated square around it
+	static void localBounds(const PrimitiveData& p, glm::vec3& minCorner, glm::vec3& maxCorner)
+	{
+		if(p.type == PRIMITIVE_CONE)
+		{
+			minCorner = glm::vec3(std::numeric_limits<float>::max());
+			maxCorner = glm::vec3(-std::numeric_limits<float>::max());
+
+			const auto offset = glm::vec3(p.params.w, p.topSlope.w, p.params.z) * 0.5f;
+			for(unsigned int end = 0; end < 2; ++end)
+			{
+				const auto top = end == 0;
+				const auto& slope = top? p.topSlope : p.bottomSlope;
+				const auto q = glm::quat(glm::sqrt(glm::max(1.0f - glm::dot(glm::vec3(slope), glm::vec3(slope)), 0.0f)), slope.x, slope.y, slope.z);
+				const auto r = top? p.params.x : p.params.y;
+
+				for(const auto& corner : {glm::vec2(-1.0f, -1.0f), glm::vec2(1.0f, -1.0f), glm::vec2(1.0f, 1.0f), glm::vec2(-1.0f, 1.0f)})
+				{
+					const auto v = q * glm::vec3(corner * r, 0.0f) + (top? offset : -offset);
+					minCorner = glm::min(minCorner, v);
+					maxCorner = glm::max(maxCorner, v);
+				}
+			}
+		}
+		else if(p.type == PRIMITIVE_TORUS)
+		{
+			const auto r = p.params.y + p.params.x;
+			minCorner = glm::vec3(-r, -r, -p.params.x);
+			maxCorner = glm::vec3(r, r, p.params.x);
+		}
+		else
+		{
+			const auto radii = glm::vec3(p.params);
+			minCorner = glm::vec3(-radii.x, -radii.y, radii.z * glm::cos(p.params.w));
+			maxCorner = radii;
+		}
+	}
+
+	void cullCaps()
+	{
+		// all primitives with caps are in the procedural batch when they are drawn procedurally
+		_capsRemoved += _caps.cull(TESS_PROCEDURAL_PRIMITIVES? _proceduralBatch : _batch);
+	}
+
+	void storeProcedural()
 	{
-		_model->transforms.push_back(toTransform(m4));
+		for(auto& q : _proceduralQueued)
+		{
+			auto& p = q.data;
+
+			// hidden caps of cones are simply not drawn: they come first, before the body
+			if(p.type == PRIMITIVE_CONE)
+			{
+				bool top, bottom;
+				_proceduralBatch.get_caps(q.position, top, bottom);
+
+				tess::cone_slope_offset c;
+				c.segment_count = p.segmentCount;
+				c.with_top_cap = top;
+				c.with_bottom_cap = bottom;
+				q.triangleCount = tess::triangle_count(c);
+				p.caps = (top? PRIMITIVE_CAP_TOP : 0) | (bottom? PRIMITIVE_CAP_BOTTOM : 0);
+			}
+
+			DrawArraysCommand drawCmd;
+			drawCmd.vertexCount = q.triangleCount * 3;
+			drawCmd.instanceCount = 1;
+			drawCmd.firstVertex = 0; // gl_VertexID starts at firstVertex, the shader expects it to start at 0
+			drawCmd.baseInstance = _model->proceduralTransforms.size(); // automatically fetch the drawID instanced attribute
+			_model->proceduralDrawCmds.push_back(drawCmd);
+
+			_model->primitives.push_back(p);
+			_model->proceduralTransforms.push_back(toTransform(q.transform));
+			_model->proceduralMaterials.push_back(q.material);
+
+			glm::vec3 minCorner, maxCorner;
+			localBounds(p, minCorner, maxCorner);
+			for(unsigned int c = 0; c < 8; ++c)
+			{
+				const auto corner = glm::vec3(c & 1? maxCorner.x : minCorner.x, c & 2? maxCorner.y : minCorner.y, c & 4? maxCorner.z : minCorner.z);
+				_model->bounds.expand(glm::vec3(q.transform * glm::vec4(corner, 1.0f)));
+			}
+		}
+	}
+
+	// append the elements of a batch range to the model, in 16 bits if its mesh has few enough vertices, and return whether they were
+	bool storeElements(const tess::batch_range& range, unsigned int& firstElement)
+	{
+		// elements are relative to the base vertex of their mesh, so only its vertex count matters
+		const auto first = _result.elements.begin() + range.first_element;
+		const auto last = first + range.element_count;
+
+		if(range.vertex_count <= MAX_SHORT_ELEMENT_VERTICES)
+		{
+			firstElement = _model->shortElements.size();
+			_model->shortElements.insert(_model->shortElements.end(), first, last);
+			return true;
+		}
+
+		firstElement = _model->elements.size();
+		_model->elements.insert(_model->elements.end(), first, last);
+		return false;
+	}
+
+	// whether the geometry stored for a cached range is exactly the given mesh, the cache keeps no copy of polygonal meshes
+	bool sameMesh(unsigned int cacheEntry, const tess::vertex* vertices, unsigned int vertexCount, const tess::element* elements, unsigned int elementCount) const
+	{
+		if(cacheEntry >= _cachedRanges.size())
+		{
+			return false;
+		}
+
+		const auto& r = _cachedRanges[cacheEntry];
+		if(!std::equal(vertices, vertices + vertexCount, _model->vertices.begin() + r.baseVertex))
+		{
+			return false;
+		}
+
+		if(r.shortElements)
+		{
+			return std::equal(elements, elements + elementCount, _model->shortElements.begin() + r.firstElement);
+		}
+
+		return std::equal(elements, elements + elementCount, _model->elements.begin() + r.firstElement);
+	}
+
+	// pack the vertices of a batch range stored at r.baseVertex, quantized with q or inside a cube around their bounds if q is null
+	void packVertices(const tess::vertex* vertices, unsigned int count, CachedRange& r, const tess::quantization* q = nullptr)
+	{
+		r.quantization = q != nullptr? *q : tess::vertex_quantizer::fit(vertices, count);
+		r.quantizationError = tess::vertex_quantizer::pack(vertices, count, r.quantization, _model->packedVertices.data() + r.baseVertex);
+	}
+
+	void storeBatch()
+	{
+		// tessellation results are already merged, so append all vertices at once
+		const unsigned int baseVertex = _model->vertices.size();
+		_model->vertices.insert(_model->vertices.end(), _result.vertices.begin(), _result.vertices.end());
+		if(QUANTIZE_VERTICES)
+		{
+			_model->packedVertices.resize(_model->vertices.size());
+		}
+
+		for(unsigned int i = 0; i < _result.ranges.size(); ++i)
+		{
+			const auto& range = _result.ranges[i];
+
+			// skip primitives that produced an invalid mesh
+			if(range.element_count == 0)
+			{
+				continue;
+			}
+
+			// geometry of cached primitives is stored only once, the first time it is seen
+			CachedRange r;
+
+			if(range.reused)
+			{
+				r = _cachedRanges[range.cache_entry];
+			}
+			else
+			{
+				r.baseVertex = baseVertex + range.base_vertex;
+				r.shortElements = storeElements(range, r.firstElement);
+				if(QUANTIZE_VERTICES)
+				{
+					packVertices(_result.vertices.data() + range.base_vertex, range.vertex_count, r);
+				}
+
+				if(range.cache_entry != tess::tessellation_cache::npos)
+				{
+					_cachedRanges.resize(std::max<size_t>(_cachedRanges.size(), range.cache_entry + 1));
+					_cachedRanges[range.cache_entry] = r;
+				}
+			}
+
+			// drawables sharing a parametric mesh are drawn together once the whole batch is stored
+			if(TESS_UNIT_PRIMITIVES && range.cache_entry != tess::tessellation_cache::npos && !_queued[i].polygonal)
+			{
+				_instances.push_back({range.cache_entry, i, r});
+				continue;
+			}
 
+			storeDrawCommand(range, r, 1);
+			storeDrawable(range, r, i);
+		}
+
+		// one instanced command per cache entry: instances are consecutive drawables, fetching their drawID from baseInstance + gl_InstanceID
+		std::stable_sort(_instances.begin(), _instances.end(), [](const Instance& a, const Instance& b){ return a.cacheEntry < b.cacheEntry; });
+
+		for(unsigned int first = 0, last = 0; first < _instances.size(); first = last)
+		{
+			while(last < _instances.size() && _instances[last].cacheEntry == _instances[first].cacheEntry)
+			{
+				++last;
+			}
+
+			const auto& r = _instances[first].cachedRange;
+			storeDrawCommand(_result.ranges[_instances[first].range], r, last - first);
+
+			for(auto i = first; i < last; ++i)
+			{
+				storeDrawable(_result.ranges[_instances[i].range], r, _instances[i].range);
+			}
+		}
+
+		_instances.clear();
+	}
+
+	// next drawable is the first instance of the command
+	void storeDrawCommand(const tess::batch_range& range, const CachedRange& r, unsigned int instanceCount)
+	{
 		DrawCommand drawCmd;
-		drawCmd.elementCount = mesh.elements.size();
-		drawCmd.instanceCount = 1;
-		drawCmd.firstElement = _model->elements.size();
-		drawCmd.baseVertex = _model->vertices.size();
-		drawCmd.baseInstance = _model->drawCmds.size(); // automatically fetch the drawID instanced attribute
-		_model->drawCmds.push_back(drawCmd);
+		drawCmd.elementCount = range.element_count;
+		drawCmd.instanceCount = instanceCount;
+		drawCmd.firstElement = r.firstElement;
+		drawCmd.baseVertex = r.baseVertex;
+		drawCmd.baseInstance = _model->transforms.size(); // automatically fetch the drawID instanced attribute
+		(r.shortElements? _model->shortDrawCmds : _model->drawCmds).push_back(drawCmd);
+	}
 
-		_model->vertices.insert(_model->vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
-		_model->elements.insert(_model->elements.end(), mesh.elements.begin(), mesh.elements.end());
+	// append the transform and material of the primitive queued at index i
+	void storeDrawable(const tess::batch_range& range, const CachedRange& r, unsigned int i)
+	{
+		const auto& m4 = _queued[i].transform;
 
-		for(auto v : mesh.vertices)
+		// dequantization of positions is folded into the model matrix, scaling quantization errors like any other length
+		if(QUANTIZE_VERTICES)
 		{
-			_model->bounds.expand(glm::vec3(m4 * glm::vec4(v.position, 1.0f)));
+			const auto scale = glm::max(glm::length(glm::vec3(m4[0])), glm::max(glm::length(glm::vec3(m4[1])), glm::length(glm::vec3(m4[2]))));
+			_maxQuantizationError = glm::max(_maxQuantizationError, r.quantizationError * scale);
 		}
+		_model->transforms.push_back(toTransform(QUANTIZE_VERTICES? m4 * r.quantization.to_matrix() : m4));
 
-		_model->materials.push_back(_currMaterial);
+		for(unsigned int v = 0; v < range.vertex_count; ++v)
+		{
+			_model->bounds.expand(glm::vec3(m4 * glm::vec4(_model->vertices[r.baseVertex + v].position, 1.0f)));
+		}
+
+		_model->materials.push_back(_queued[i].material);
 	}
 
 	TransformData toTransform(const glm::mat4& m)
@@ -181,6 +772,25 @@ private:
 	ModelData* _model;
 	rvm::MaterialTable _materials;
 	MaterialData _currMaterial;
+
+	tess::primitive_batch _batch;
+	std::vector<tess::point> _facePoints; // points of the mesh face being read
+	std::vector<unsigned int> _faceContours; // first point of each contour of that face, plus its end (see tess::polygon_view)
+	std::vector<QueuedPrimitive> _queued;
+	tess::primitive_batch _proceduralBatch;
+	std::vector<QueuedProcedural> _proceduralQueued;
+	tess::batch_tessellator _tessellator;
+	tess::batch_result _result;
+	tess::tessellation_cache _cache;
+	std::vector<CachedRange> _cachedRanges;
+	std::vector<Instance> _instances;
+	unsigned int _unitPrimitives = 0;
+	tess::tessellation_quality _quality;
+	unsigned long long _fixedTriangles = 0;
+	unsigned long long _adaptiveTriangles = 0;
+	tess::cap_culler _caps;
+	unsigned int _capsRemoved = 0;
+	float _maxQuantizationError = 0.0f; // in world units
 };
 
 class Scene
@@ -220,11 +830,21 @@ public:
 
 		GLuint vbo;
 		glCreateBuffers(1, &vbo);
-		glNamedBufferStorage(vbo, _model.vertices.size()*sizeof(tess::vertex), _model.vertices.data(), 0); // flags = 0
+		if(QUANTIZE_VERTICES)
+		{
+			glNamedBufferStorage(vbo, _model.packedVertices.size()*sizeof(tess::packed_vertex), _model.packedVertices.data(), 0); // flags = 0
+		}
+		else
+		{
+			glNamedBufferStorage(vbo, _model.vertices.size()*sizeof(tess::vertex), _model.vertices.data(), 0); // flags = 0
+		}
+
+		// buffers cannot be empty, and usually no mesh needs 32-bit elements
+		glCreateBuffers(1, &_model.shortElementsBuffer);
+		glNamedBufferStorage(_model.shortElementsBuffer, std::max<size_t>(_model.shortElements.size(), 1)*sizeof(GLushort), _model.shortElements.data(), 0); // flags = 0
 
-		GLuint ebo;
-		glCreateBuffers(1, &ebo);
-		glNamedBufferStorage(ebo, _model.elements.size()*sizeof(tess::element), _model.elements.data(), 0); // flags = 0
+		glCreateBuffers(1, &_model.elementsBuffer);
+		glNamedBufferStorage(_model.elementsBuffer, std::max<size_t>(_model.elements.size(), 1)*sizeof(tess::element), _model.elements.data(), 0); // flags = 0
 
 		// ------------------------------------------------------------------------
 		// 3- Setup vertex array object
@@ -236,20 +856,28 @@ public:
 		glCreateVertexArrays(1, &_model.vao);
 
 		// bind vbo to vao
-		glVertexArrayVertexBuffer(_model.vao, bufferIndex, vbo, 0, sizeof(tess::vertex)); // offset = 0, stride = sizeof(tess::vertex)
+		const GLsizei stride = QUANTIZE_VERTICES? sizeof(tess::packed_vertex) : sizeof(tess::vertex);
+		glVertexArrayVertexBuffer(_model.vao, bufferIndex, vbo, 0, stride); // offset = 0
 
 		// setup position attrib
 		glEnableVertexArrayAttrib(_model.vao, IN_POSITION);
 		glVertexArrayAttribBinding(_model.vao, IN_POSITION, bufferIndex);
-		glVertexArrayAttribFormat(_model.vao, IN_POSITION, 3, GL_FLOAT, GL_FALSE, 0); // size = 3, normalized = false, offset = 0
 
 		// setup normal attrib
 		glEnableVertexArrayAttrib(_model.vao, IN_NORMAL);
 		glVertexArrayAttribBinding(_model.vao, IN_NORMAL, bufferIndex);
-		glVertexArrayAttribFormat(_model.vao, IN_NORMAL, 3, GL_FLOAT, GL_FALSE, sizeof(tess::vertex::position)); // size = 3, normalized = false, offset = sizeof(tess::vertex::position)
 
-		// bind ebo
-		glVertexArrayElementBuffer(_model.vao, ebo);
+		if(QUANTIZE_VERTICES)
+		{
+			// positions are mapped back from [0, 1] by the model matrix, octahedral normals are decoded by the vertex shader
+			glVertexArrayAttribFormat(_model.vao, IN_POSITION, 3, GL_UNSIGNED_SHORT, GL_TRUE, 0); // size = 3, normalized = true, offset = 0
+			glVertexArrayAttribFormat(_model.vao, IN_NORMAL, 2, GL_SHORT, GL_TRUE, sizeof(tess::packed_vertex::position)); // size = 2, normalized = true, offset = sizeof(tess::packed_vertex::position)
+		}
+		else
+		{
+			glVertexArrayAttribFormat(_model.vao, IN_POSITION, 3, GL_FLOAT, GL_FALSE, 0); // size = 3, normalized = false, offset = 0
+			glVertexArrayAttribFormat(_model.vao, IN_NORMAL, 3, GL_FLOAT, GL_FALSE, sizeof(tess::vertex::position)); // size = 3, normalized = false, offset = sizeof(tess::vertex::position)
+		}
 
 		// ------------------------------------------------------------------------
 		// 4- Create shader program
@@ -283,14 +911,19 @@ public:
 		// 6- Setup draw command buffer
 		// ------------------------------------------------------------------------
 
+		const auto shortDrawCmdsSize = _model.shortDrawCmds.size()*sizeof(DrawCommand);
+
 		glCreateBuffers(1, &_model.drawCmdsBuffer);
-		glNamedBufferStorage(_model.drawCmdsBuffer, _model.drawCmds.size()*sizeof(DrawCommand), _model.drawCmds.data(), 0); // flags = 0
+		glNamedBufferStorage(_model.drawCmdsBuffer, shortDrawCmdsSize + _model.drawCmds.size()*sizeof(DrawCommand), nullptr, GL_DYNAMIC_STORAGE_BIT); // data = nullptr
+		glNamedBufferSubData(_model.drawCmdsBuffer, 0, shortDrawCmdsSize, _model.shortDrawCmds.data()); // offset = 0
+		glNamedBufferSubData(_model.drawCmdsBuffer, shortDrawCmdsSize, _model.drawCmds.size()*sizeof(DrawCommand), _model.drawCmds.data());
 
 		// ------------------------------------------------------------------------
 		// 7- Setup custom draw ID
 		// ------------------------------------------------------------------------
 
-		std::vector<int> drawIDs(_model.drawCmds.size());
+		// procedural primitives use the same draw IDs for their own drawables
+		std::vector<int> drawIDs(std::max(_model.transforms.size(), _model.primitives.size()));
 		for(unsigned int i = 0; i < drawIDs.size(); ++i)
 		{
 			drawIDs[i] = i;
@@ -317,6 +950,50 @@ public:
 		glVertexArrayAttribBinding(_model.vao, IN_DRAWID, bufferIndex);
 		glVertexArrayAttribIFormat(_model.vao, IN_DRAWID, 1, GL_INT, 0); // size = 1, offset = 0
 
+		// ------------------------------------------------------------------------
+		// 8- Setup procedural primitives
+		// ------------------------------------------------------------------------
+
+		// buffers cannot be empty
+		if(_model.primitives.empty())
+		{
+			return true;
+		}
+
+		glCreateBuffers(1, &_model.primitivesSSBO);
+		glNamedBufferStorage(_model.primitivesSSBO, _model.primitives.size()*sizeof(PrimitiveData), _model.primitives.data(), 0); // flags = 0
+
+		glCreateBuffers(1, &_model.proceduralTransformsSSBO);
+		glNamedBufferStorage(_model.proceduralTransformsSSBO, _model.proceduralTransforms.size()*sizeof(TransformData), _model.proceduralTransforms.data(), 0); // flags = 0
+
+		glCreateBuffers(1, &_model.proceduralMaterialsSSBO);
+		glNamedBufferStorage(_model.proceduralMaterialsSSBO, _model.proceduralMaterials.size()*sizeof(MaterialData), _model.proceduralMaterials.data(), 0); // flags = 0
+
+		glCreateBuffers(1, &_model.proceduralDrawCmdsBuffer);
+		glNamedBufferStorage(_model.proceduralDrawCmdsBuffer, _model.proceduralDrawCmds.size()*sizeof(DrawArraysCommand), _model.proceduralDrawCmds.data(), 0); // flags = 0
+
+		// vertices come from gl_VertexID: the vao only holds the drawID attribute
+		glCreateVertexArrays(1, &_model.proceduralVao);
+		glVertexArrayVertexBuffer(_model.proceduralVao, 0, drawIdBuffer, 0, sizeof(int)); // bindingindex = 0, offset = 0, stride = sizeof(int)
+		glVertexArrayBindingDivisor(_model.proceduralVao, 0, 1);
+		glEnableVertexArrayAttrib(_model.proceduralVao, IN_DRAWID);
+		glVertexArrayAttribBinding(_model.proceduralVao, IN_DRAWID, 0);
+		glVertexArrayAttribIFormat(_model.proceduralVao, IN_DRAWID, 1, GL_INT, 0); // size = 1, offset = 0
+
+		ShaderLoader proceduralLoader;
+		if(!proceduralLoader.addFile(GL_VERTEX_SHADER, "../src/Scene11CADModelProcedural.vert", "../src/ShaderData.h"))
+		{
+			return false;
+		}
+		if(!proceduralLoader.addFile(GL_FRAGMENT_SHADER, "../src/Scene11CADModel.frag", "../src/ShaderData.h"))
+		{
+			return false;
+		}
+		if(!proceduralLoader.link(_model.proceduralProgram))
+		{
+			return false;
+		}
+
 		return true;
 	}
 
@@ -335,7 +1012,25 @@ public:
 		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SB_TRANSFORM, _model.transformsSSBO);
 		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SB_MATERIAL, _model.materialsSSBO);
 		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _model.drawCmdsBuffer);
-		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, 0, _model.drawCmds.size(), 0); // offset = 0, stride = 0
+
+		// one batch per element type, each with its own element buffer
+		glVertexArrayElementBuffer(_model.vao, _model.shortElementsBuffer);
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT, 0, _model.shortDrawCmds.size(), 0); // offset = 0, stride = 0
+
+		glVertexArrayElementBuffer(_model.vao, _model.elementsBuffer);
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (const void*)(_model.shortDrawCmds.size()*sizeof(DrawCommand)), _model.drawCmds.size(), 0); // stride = 0
+
+		// procedural primitives: non-indexed, triangles generated by the vertex shader
+		if(!_model.proceduralDrawCmds.empty())
+		{
+			glUseProgram(_model.proceduralProgram);
+			glBindVertexArray(_model.proceduralVao);
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SB_TRANSFORM, _model.proceduralTransformsSSBO);
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SB_MATERIAL, _model.proceduralMaterialsSSBO);
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SB_PRIMITIVE, _model.primitivesSSBO);
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _model.proceduralDrawCmdsBuffer);
+			glMultiDrawArraysIndirect(GL_TRIANGLES, 0, _model.proceduralDrawCmds.size(), 0); // offset = 0, stride = 0
+		}
 	}
 
 private:
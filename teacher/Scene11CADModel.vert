@@ -12,8 +12,13 @@ layout(std430, binding = SB_TRANSFORM) buffer Transform
     readonly TransformData data[];
 } sb_Transform;
 
+#if QUANTIZE_VERTICES
+layout(location = IN_POSITION) in vec3 in_Position; // normalized inside the quantization cube, which the model matrix maps back
+layout(location = IN_NORMAL) in vec2 in_Normal;     // octahedral encoding
+#else
 layout(location = IN_POSITION) in vec3 in_Position;
 layout(location = IN_NORMAL) in vec3 in_Normal;
+#endif
 layout(location = IN_DRAWID) in int in_DrawID;
 
 //-------------------------------------------------------------------------------------------------
@@ -31,6 +36,19 @@ out Instancing
     flat int id;
 } out_Instancing;
 
+//-------------------------------------------------------------------------------------------------
+// AUX FUNCTIONS
+//-------------------------------------------------------------------------------------------------
+
+vec3 decodeNormal(in const vec2 e)
+{
+    // unfold the lower half of the octahedron (see tess::vertex_quantizer)
+    vec3 n = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+    const float t = max(-n.z, 0.0f);
+    n.xy += vec2(n.x >= 0.0f ? -t : t, n.y >= 0.0f ? -t : t);
+    return normalize(n);
+}
+
 //-------------------------------------------------------------------------------------------------
 // MAIN
 //-------------------------------------------------------------------------------------------------
@@ -42,9 +60,16 @@ void main()
                             vec4(t.row0.y, t.row1.y, t.row2.y, 0.0f),  // col 1
                             vec4(t.row0.z, t.row1.z, t.row2.z, 0.0f),  // col 2
                             vec4(t.row0.w, t.row1.w, t.row2.w, 1.0f)); // col 3
+
+#if QUANTIZE_VERTICES
+    const vec3 normal = decodeNormal(in_Normal);
+#else
+    const vec3 normal = in_Normal;
+#endif
+
     gl_Position = ub_Camera.data.viewProjMatrix * modelMatrix * vec4(in_Position, 1.0f);
 
-    out_Lighting.eyeNormal = mat3(ub_Camera.data.viewMatrix) * mat3(transpose(inverse(modelMatrix))) * in_Normal;
+    out_Lighting.eyeNormal = mat3(ub_Camera.data.viewMatrix) * mat3(transpose(inverse(modelMatrix))) * normal;
     out_Lighting.eyePosition = vec3(ub_Camera.data.viewMatrix * modelMatrix * vec4(in_Position, 1.0f));
 
     out_Instancing.id = in_DrawID;
@@ -0,0 +1,214 @@
+//-------------------------------------------------------------------------------------------------
+// INPUTS
+//-------------------------------------------------------------------------------------------------
+
+layout(std140, binding = UB_CAMERA) uniform Camera
+{
+    CameraData data;
+} ub_Camera;
+
+layout(std430, binding = SB_TRANSFORM) buffer Transform
+{
+    readonly TransformData data[];
+} sb_Transform;
+
+layout(std430, binding = SB_PRIMITIVE) buffer Primitive
+{
+    readonly PrimitiveData data[];
+} sb_Primitive;
+
+layout(location = IN_DRAWID) in int in_DrawID;
+
+//-------------------------------------------------------------------------------------------------
+// OUTPUTS
+//-------------------------------------------------------------------------------------------------
+
+out Lighting
+{
+    vec3 eyePosition;
+    vec3 eyeNormal;
+} out_Lighting;
+
+out Instancing
+{
+    flat int id;
+} out_Instancing;
+
+//-------------------------------------------------------------------------------------------------
+// AUX FUNCTIONS
+//-------------------------------------------------------------------------------------------------
+
+const float TWO_PI = 6.28318530717958647692f;
+
+// unit vector at step i of a circle divided in n steps (i >= 0)
+vec2 circleStep(const int i, const int n)
+{
+    const float angle = TWO_PI * float(i % n) / float(n);
+    return vec2(cos(angle), sin(angle));
+}
+
+// rotate v by the unit quaternion with imaginary part q and non-negative real part
+vec3 rotate(const vec3 q, const vec3 v)
+{
+    const float w = sqrt(max(1.0f - dot(q, q), 0.0f));
+    return v + 2.0f * cross(q, cross(q, v) + w * v);
+}
+
+// point of the top or bottom ring of a cone
+vec3 conePoint(const PrimitiveData p, const int segment, const bool top)
+{
+    const vec2 c = circleStep(segment, int(p.segmentCount));
+    const vec3 offset = vec3(p.params.w * 0.5f, p.topSlope.w * 0.5f, p.params.z * 0.5f);
+
+    if(top)
+    {
+        return rotate(vec3(p.topSlope), vec3(c * p.params.x, 0.0f)) + offset;
+    }
+
+    return rotate(vec3(p.bottomSlope), vec3(c * p.params.y, 0.0f)) - offset;
+}
+
+// caps first (top, then bottom), then two triangles per segment on the body
+void coneVertex(const PrimitiveData p, int triangle, const int corner, out vec3 position, out vec3 normal)
+{
+    const int n = int(p.segmentCount);
+    const int capTriangles = ((n - 2) / 2) * 2;
+
+    for(int end = 0; end < 2; ++end)
+    {
+        const bool top = end == 0;
+        if((p.caps & (top ? uint(PRIMITIVE_CAP_TOP) : uint(PRIMITIVE_CAP_BOTTOM))) == 0u)
+        {
+            continue;
+        }
+
+        if(triangle < capTriangles)
+        {
+            // strip zigzagging between both sides of the ring, wound to face outwards
+            const int i = triangle / 2;
+            const int a = (triangle % 2 == 0) ? i + 1 : n - (i + 2);
+            const int c = (triangle % 2 == 0) ? i : i + 1;
+            const int segment = corner == 1 ? n - (i + 1) : ((corner == 0) == top ? a : c);
+
+            position = conePoint(p, segment, top);
+            normal = top ? rotate(vec3(p.topSlope), vec3(0.0f, 0.0f, 1.0f)) : rotate(vec3(p.bottomSlope), vec3(0.0f, 0.0f, -1.0f));
+            return;
+        }
+
+        triangle -= capTriangles;
+    }
+
+    // quad between segments i and i + 1: (bottom i+1, top i, bottom i), (bottom i+1, top i+1, top i)
+    const int i = triangle / 2;
+    const bool top = (triangle % 2 == 0) ? corner == 1 : corner != 0;
+    const int segment = (triangle % 2 == 0) ? (corner == 0 ? i + 1 : i) : (corner == 2 ? i : i + 1);
+
+    position = conePoint(p, segment, top);
+
+    // normal of the plane through the side and the tangent of the ring
+    const vec3 side = top ? conePoint(p, segment, false) - position : position - conePoint(p, segment, true);
+    const vec3 tangent = conePoint(p, segment + 1, top) - conePoint(p, segment + n - 1, top);
+    normal = normalize(cross(side, tangent));
+}
+
+// two triangles per segment between consecutive cross-sections
+void torusVertex(const PrimitiveData p, const int triangle, const int corner, out vec3 position, out vec3 normal)
+{
+    const int n = int(p.segmentCount);
+    const int section = triangle / (2 * n);
+    const int j = (triangle / 2) % n;
+
+    // (current j+1, next j, current j), (next j+1, next j, current j+1)
+    const int next = (triangle % 2 == 0) ? (corner == 1 ? 1 : 0) : (corner == 2 ? 0 : 1);
+    const int segment = (triangle % 2 == 0) ? (corner == 0 ? j + 1 : j) : (corner == 1 ? j : j + 1);
+
+    const float sweep = p.params.z * float(section + next) / float(p.sweepCount);
+    const vec2 s = vec2(cos(sweep), sin(sweep));
+    const vec2 c = circleStep(segment, n);
+
+    normal = vec3(c.y * s, c.x);
+    position = vec3(p.params.y * s, 0.0f) + p.params.x * normal;
+}
+
+// point of a ring of an ellipsoid, ring -1 is the top pole
+void ellipsoidPoint(const PrimitiveData p, const int ring, const int segment, out vec3 position, out vec3 normal)
+{
+    const float vertical = p.params.w * float(ring + 1) / float(p.sweepCount);
+    const vec2 h = circleStep(segment, int(p.segmentCount));
+    const vec3 radii = vec3(p.params);
+
+    position = radii * vec3(sin(vertical) * h, cos(vertical));
+    normal = normalize(position / (radii * radii));
+}
+
+// top fan, two triangles per segment between consecutive rings, then the bottom fan of spheres
+void ellipsoidVertex(const PrimitiveData p, int triangle, const int corner, out vec3 position, out vec3 normal)
+{
+    const int n = int(p.segmentCount);
+    const bool pole = (p.caps & uint(PRIMITIVE_CAP_BOTTOM)) != 0u;
+    const int ringCount = pole ? int(p.sweepCount) - 1 : int(p.sweepCount);
+
+    // (top, ring 0 i, ring 0 i+1)
+    if(triangle < n)
+    {
+        ellipsoidPoint(p, corner == 0 ? -1 : 0, corner == 2 ? triangle + 1 : triangle, position, normal);
+        return;
+    }
+    triangle -= n;
+
+    // (ring j i+1, ring j i, ring j+1 i), (ring j+1 i, ring j+1 i+1, ring j i+1)
+    if(triangle < (ringCount - 1) * 2 * n)
+    {
+        const int j = triangle / (2 * n);
+        const int i = (triangle / 2) % n;
+        const int ring = (triangle % 2 == 0) ? (corner == 2 ? j + 1 : j) : (corner == 2 ? j : j + 1);
+        const int segment = (triangle % 2 == 0) ? (corner == 0 ? i + 1 : i) : (corner == 0 ? i : i + 1);
+        ellipsoidPoint(p, ring, segment, position, normal);
+        return;
+    }
+    triangle -= (ringCount - 1) * 2 * n;
+
+    // (bottom, last ring i+1, last ring i), the bottom pole is one ring past the last one
+    ellipsoidPoint(p, corner == 0 ? ringCount : ringCount - 1, corner == 1 ? triangle + 1 : triangle, position, normal);
+}
+
+//-------------------------------------------------------------------------------------------------
+// MAIN
+//-------------------------------------------------------------------------------------------------
+
+void main()
+{
+    const TransformData t = sb_Transform.data[in_DrawID];
+    mat4 modelMatrix = mat4(vec4(t.row0.x, t.row1.x, t.row2.x, 0.0f),  // col 0
+                            vec4(t.row0.y, t.row1.y, t.row2.y, 0.0f),  // col 1
+                            vec4(t.row0.z, t.row1.z, t.row2.z, 0.0f),  // col 2
+                            vec4(t.row0.w, t.row1.w, t.row2.w, 1.0f)); // col 3
+
+    // non-indexed draws: three consecutive vertices per triangle
+    const PrimitiveData p = sb_Primitive.data[in_DrawID];
+    const int triangle = gl_VertexID / 3;
+    const int corner = gl_VertexID % 3;
+
+    vec3 position;
+    vec3 normal;
+
+    if(p.type == uint(PRIMITIVE_CONE))
+    {
+        coneVertex(p, triangle, corner, position, normal);
+    }
+    else if(p.type == uint(PRIMITIVE_TORUS))
+    {
+        torusVertex(p, triangle, corner, position, normal);
+    }
+    else
+    {
+        ellipsoidVertex(p, triangle, corner, position, normal);
+    }
+
+    gl_Position = ub_Camera.data.viewProjMatrix * modelMatrix * vec4(position, 1.0f);
+
+    out_Lighting.eyeNormal = mat3(ub_Camera.data.viewMatrix) * mat3(transpose(inverse(modelMatrix))) * normal;
+    out_Lighting.eyePosition = vec3(ub_Camera.data.viewMatrix * modelMatrix * vec4(position, 1.0f));
+
+    out_Instancing.id = in_DrawID;
+}
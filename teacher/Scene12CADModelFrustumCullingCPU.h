@@ -9,8 +9,53 @@
 #include <FrustumCuller.h>
 #include <rvm/FileReader.h>
 #include <rvm/StatsCollector.h>
-#include <tess/tessellator.h>
-#include <tess/mesh_optimizer.h>
+#include <tess/batch_tessellator.h>
+#include <tess/cap_culler.h>
+#include <tess/tessellation_quality.h>
+#include <tess/vertex_quantizer.h>
+#include <algorithm>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// maximum distance between curved surfaces and their tessellation, in model units
+static const float TESS_MAX_CHORD_ERROR = 0.005f;
+
+// meshes with at most this many vertices store their elements in 16 bits, larger ones in 32 bits
+static const unsigned int MAX_SHORT_ELEMENT_VERTICES = 65536;
+
+// primitives are only tessellated once culling first finds them visible, on a thread of their own, into GPU pools of fixed size that evict
+// the geometry drawn least recently when full: compare the time to first frame and the memory printed while drawing against false
+static const bool TESS_LAZY = false;
+
+// capacity of the vertex and element pools used by TESS_LAZY
+static const unsigned int LAZY_POOL_VERTICES = 8 << 20;
+static const unsigned int LAZY_POOL_ELEMENTS = 32 << 20;
+
+// largest number of drawables handed to the tessellation thread at once
+static const unsigned int LAZY_MAX_REQUESTS = 4096;
+
+// geometry of a drawable with TESS_LAZY
+enum LazyState
+{
+	LAZY_UNLOADED,  // not tessellated yet, or evicted
+	LAZY_REQUESTED, // being tessellated
+	LAZY_RESIDENT,  // in the pools
+	LAZY_INVALID    // produced an invalid mesh, never drawn
+};
+
+struct LazyDrawable
+{
+	glm::mat4 transform;
+	LazyState state;
+	unsigned int lastFrame; // last frame the drawable was visible, the least recent ones are evicted first
+	unsigned int firstVertex;
+	unsigned int vertexCount;
+	unsigned int firstElement;
+	unsigned int elementCount;
+};
 
 struct ModelData
 {
@@ -26,112 +71,175 @@ struct ModelData
 
 	std::vector<unsigned int> visibleDrawables;
 
+	// visible drawables are drawn in two batches, one per element type: commands of 16-bit elements fill the buffer from its start
+	// and commands of 32-bit elements from its end
 	GLuint drawCmdsBuffer;
 	std::vector<DrawCommand> drawCmds;
+	std::vector<bool> shortDrawables;
 	DrawCommand* persistentDrawCmdsBuffer;
 
 	std::vector<tess::vertex> vertices;
+	std::vector<tess::packed_vertex> packedVertices; // same indices as vertices, uploaded instead of them if QUANTIZE_VERTICES
+
+	GLuint shortElementsBuffer;
+	std::vector<GLushort> shortElements;
+	GLuint elementsBuffer;
 	std::vector<tess::element> elements;
 
 	GLuint program;
+
+	// TESS_LAZY: one primitive per drawable, in drawable order, tessellated while drawing (see Scene::updateLazy)
+	tess::primitive_batch lazyPrimitives;
+	std::vector<LazyDrawable> lazyDrawables;
 };
 
 class ModelLoader : public rvm::FileReader::IObserver
 {
 public:
-	ModelLoader(ModelData* model) {_model = model;}
+	// threadCount = 0 uses one tessellation thread per hardware core
+	ModelLoader(ModelData* model, unsigned int threadCount = 0) : _tessellator(threadCount), _quality(TESS_MAX_CHORD_ERROR)
+	{
+		_model = model;
+		_tessellator.set_cache(&_cache);
+		_cache.set_mesh_comparator([this](unsigned int id, const tess::vertex* vertices, unsigned int vertexCount, const tess::element* elements, unsigned int elementCount)
+		{
+			return sameMesh(id, vertices, vertexCount, elements, elementCount);
+		});
+	}
 
 	virtual void validPrimitive(const rvm::Box& b)
 	{
-		storeMesh(tess::tessellate_box(glm::make_vec3(b.lengths)), glm::make_mat4(b.transform));
+		tess::box p;
+		p.extents = glm::make_vec3(b.lengths);
+		_batch.add(p);
+		queuePrimitive(glm::make_mat4(b.transform));
 	}
 
 	virtual void validPrimitive(const rvm::Sphere& s)
 	{
-		storeMesh(tess::tessellate_sphere(s.radius), glm::make_mat4(s.transform));
+		tess::sphere p;
+		p.radius = s.radius;
+		addAdaptive(p, glm::make_mat4(s.transform));
 	}
 
 	virtual void validPrimitive(const rvm::Cylinder& c)
 	{
-		storeMesh(tess::tessellate_cylinder(c.radius, c.height), glm::make_mat4(c.transform));
+		tess::cylinder p;
+		p.radius = c.radius;
+		p.height = c.height;
+
+		const auto m4 = glm::make_mat4(c.transform);
+		_caps.add(addAdaptive(p, m4), p, m4);
 	}
 
 	virtual void validPrimitive(const rvm::Dish& d)
 	{
-		storeMesh(tess::tessellate_dish(d.radius, d.height), glm::make_mat4(d.transform));
+		tess::dish p;
+		p.radius = d.radius;
+		p.height = d.height;
+
+		const auto m4 = glm::make_mat4(d.transform);
+		addAdaptive(p, m4);
+		_caps.add(p, m4);
 	}
 
 	virtual void validPrimitive(const rvm::Pyramid& p)
 	{
-		storeMesh(tess::tessellate_pyramid(glm::make_vec2(p.topLengths), glm::make_vec2(p.bottomLengths), p.height, glm::make_vec2(p.offset)),
-		          glm::make_mat4(p.transform));
+		tess::pyramid t;
+		t.top_extents = glm::make_vec2(p.topLengths);
+		t.bottom_extents = glm::make_vec2(p.bottomLengths);
+		t.height = p.height;
+		t.offset = glm::make_vec2(p.offset);
+		_batch.add(t);
+		queuePrimitive(glm::make_mat4(p.transform));
 	}
 
 	virtual void validPrimitive(const rvm::RectangularTorus& t)
 	{
-		storeMesh(tess::tessellate_rectangular_torus(t.internalRadius, t.externalRadius, t.height, t.sweepAngle), glm::make_mat4(t.transform));
+		tess::rectangular_torus p;
+		p.in_radius = t.internalRadius;
+		p.out_radius = t.externalRadius;
+		p.in_height = t.height;
+		p.sweep_angle = t.sweepAngle;
+		addAdaptive(p, glm::make_mat4(t.transform));
 	}
 
 	virtual void validPrimitive(const rvm::CircularTorus& t)
 	{
-		storeMesh(tess::tessellate_circular_torus(t.internalRadius, t.externalRadius, t.sweepAngle), glm::make_mat4(t.transform));
+		tess::circular_torus p;
+		p.in_radius = t.internalRadius;
+		p.out_radius = t.externalRadius;
+		p.sweep_angle = t.sweepAngle;
+
+		const auto m4 = glm::make_mat4(t.transform);
+		addAdaptive(p, m4);
+		_caps.add(p, m4);
 	}
 
 	virtual void validPrimitive(const rvm::Cone& c)
 	{
-		storeMesh(tess::tessellate_cone(c.radiusTop, c.radiusBottom, c.height),  glm::make_mat4(c.transform));
+		tess::cone p;
+		p.top_radius = c.radiusTop;
+		p.bottom_radius = c.radiusBottom;
+		p.height = c.height;
+
+		const auto m4 = glm::make_mat4(c.transform);
+		_caps.add(addAdaptive(p, m4), p, m4);
 	}
 
 	virtual void validPrimitive(const rvm::SlopedCone& c)
 	{
-		storeMesh(tess::tessellate_cone_slope_offset(c.radiusTop, c.radiusBottom, c.height, glm::make_vec2(c.topSlopeAngle),
-		                                       glm::make_vec2(c.bottomSlopeAngle), glm::make_vec2(c.offset)),
-		          glm::make_mat4(c.transform));
+		tess::cone_slope_offset p;
+		p.top_radius = c.radiusTop;
+		p.bottom_radius = c.radiusBottom;
+		p.height = c.height;
+		p.top_slope_angles = glm::make_vec2(c.topSlopeAngle);
+		p.bottom_slope_angles = glm::make_vec2(c.bottomSlopeAngle);
+		p.offset = glm::make_vec2(c.offset);
+
+		const auto m4 = glm::make_mat4(c.transform);
+		_caps.add(addAdaptive(p, m4), p, m4);
 	}
 
 	virtual void validPrimitive(const rvm::Mesh& mesh)
 	{
-		tess::tessellate_polygonal_begin();
+		_batch.begin_polygonal();
 
 		for(const auto& face : mesh.faces)
 		{
-			tess::polygon tpoly;
-			tpoly.contours.reserve(face.polygons.size());
+			// every face is read into the same buffers, so faces are added without allocating once they are large enough
+			_facePoints.clear();
+			_faceContours.assign(1, 0);
 
 			for(const auto& poly : face.polygons)
 			{
-				tess::contour tcontour;
-				tcontour.points.reserve(poly.points.size());
-
 				for(const auto& point : poly.points)
 				{
 					tess::point tpoint;
 					tpoint.vertex = make_vec3(point.vertex);
 					tpoint.normal = make_vec3(point.normal);
-					tcontour.points.push_back(tpoint);
+					_facePoints.push_back(tpoint);
 				}
 
-				tpoly.contours.push_back(tcontour);
+				_faceContours.push_back(_facePoints.size());
 			}
 
-			tess::tessellate_polygonal_add(tpoly);
-		}
-
-		auto data = tess::tessellate_polygonal_end();
-
-		if(!data.is_valid())
-		{
-			return;
+			tess::polygon_view view;
+			view.points = _facePoints.data();
+			view.contour_offsets = _faceContours.data();
+			view.contour_count = face.polygons.size();
+			_batch.add_polygon(view);
 		}
 
-		tess::mesh_optimizer opt;
-		opt.optimize(data, tess::mesh_optimizer::flag_all_optimizations);
-
-		storeMesh(data, make_mat4(mesh.transform));
+		_batch.end_polygonal();
+		queuePrimitive(make_mat4(mesh.transform));
 	}
 
 	virtual void beginBlock(rvm::CntBegin& block)
 	{
+		// primitives of the previous group are complete: remove the caps hidden between them
+		_capsRemoved += _caps.cull(_batch);
+
 		rvm::Material m = _materials.getMaterial(block.colorCode);
 		_currMaterial.diffuse = glm::make_vec4(m.diffuseColor);
 		_currMaterial.specular = glm::make_vec4(m.specularColor);
@@ -140,40 +248,283 @@ public:
 
 	virtual void endRead()
 	{
+		// the last group ends with the file
+		_capsRemoved += _caps.cull(_batch);
+
+		// only primitive records and their bounds are kept until culling first finds them visible
+		if(TESS_LAZY)
+		{
+			std::cout << "hidden caps removed: " << _capsRemoved << "... ";
+			_capsRemoved = 0;
+
+			storeLazy();
+			std::cout << "primitives kept for lazy tessellation: " << _batch.size() << "... ";
+
+			_batch.clear();
+			_queued.clear();
+
+			_model->visibleDrawables.reserve(_model->drawCmds.size());
+			return;
+		}
+
+		// tessellate everything read from the file in parallel and append results in file order
+		Timer t;
+		_tessellator.tessellate(_batch, _result);
+		double msec = t.msec();
+
+		std::cout << "tessellated " << _batch.size() << " primitives in " << msec << " ms using " << _tessellator.get_thread_count() << " threads... ";
+
+		const auto& stats = _cache.get_stats();
+		const auto lookups = stats.hits + stats.misses;
+		std::cout << "cache hits: " << stats.hits << "/" << lookups << " (" << (lookups > 0? 100.0 * stats.hits / lookups : 0.0) << "%), saved " <<
+		             stats.saved_msec << " ms, " << stats.saved_vertex_bytes / 1024 << " KB vertices, " << stats.saved_element_bytes / 1024 << " KB elements... ";
+
+		// identical polygonal meshes share the geometry of the first one, they only get a transform and a material of their own
+		const auto meshes = stats.mesh_hits + stats.mesh_misses;
+		std::cout << "unique polygonal meshes: " << stats.mesh_misses << "/" << meshes << " (" << (meshes > 0? 100.0 * stats.mesh_misses / meshes : 0.0) <<
+		             "%), saved " << stats.saved_mesh_bytes / 1024 << " KB... ";
+		_cache.reset_stats();
+
+		std::cout << "adaptive tessellation: " << _adaptiveTriangles << " triangles instead of " << _fixedTriangles << " (" <<
+		             (_fixedTriangles > 0? 100.0 - 100.0 * _adaptiveTriangles / _fixedTriangles : 0.0) << "% fewer)... ";
+		_adaptiveTriangles = 0;
+		_fixedTriangles = 0;
+
+		std::cout << "hidden caps removed: " << _capsRemoved << "... ";
+		_capsRemoved = 0;
+
+		storeBatch();
+
+		const auto elementCount = _model->shortElements.size() + _model->elements.size();
+		std::cout << "elements: " << (_model->shortElements.size() * sizeof(GLushort) + _model->elements.size() * sizeof(tess::element)) / 1024 <<
+		             " KB instead of " << elementCount * sizeof(tess::element) / 1024 << " KB in 32 bits (" <<
+		             (elementCount > 0? 100.0 * _model->shortElements.size() / elementCount : 0.0) << "% in 16 bits)... ";
+
+		if(QUANTIZE_VERTICES)
+		{
+			std::cout << "vertices: " << _model->packedVertices.size() * sizeof(tess::packed_vertex) / 1024 << " KB instead of " <<
+			             _model->vertices.size() * sizeof(tess::vertex) / 1024 << " KB, max quantization error " << _maxQuantizationError << "... ";
+		}
+
+		_batch.clear();
+		_queued.clear();
+
 		_model->visibleDrawables.reserve(_model->drawCmds.size());
 	}
 
 private:
-	void storeMesh(const tess::triangle_mesh& mesh, const glm::mat4& m4)
+	struct QueuedPrimitive
+	{
+		glm::mat4 transform;
+		MaterialData material;
+	};
+
+	struct CachedRange
+	{
+		unsigned int firstElement;
+		unsigned int baseVertex;
+		bool shortElements;
+		tess::quantization quantization;
+		float quantizationError; // in model units
+	};
+
+	void queuePrimitive(const glm::mat4& m4)
+	{
+		_queued.push_back({m4, _currMaterial});
+	}
+
+	// derive segment counts of a curved primitive from its size in model units
+	template<typename T>
+	unsigned int addAdaptive(T& p, const glm::mat4& m4)
 	{
-		_model->transforms.push_back(toTransform(m4));
+		// default counts of the primitive are the fixed ones used without a quality policy
+		_fixedTriangles += tess::triangle_count(p);
 
-		DrawCommand drawCmd;
-		drawCmd.elementCount = mesh.elements.size();
-		drawCmd.instanceCount = 1;
-		drawCmd.firstElement = _model->elements.size();
-		drawCmd.baseVertex = _model->vertices.size();
-		drawCmd.baseInstance = _model->drawCmds.size(); // automatically fetch the drawID instanced attribute
-		_model->drawCmds.push_back(drawCmd);
+		const auto scale = glm::max(glm::length(glm::vec3(m4[0])), glm::max(glm::length(glm::vec3(m4[1])), glm::length(glm::vec3(m4[2]))));
+		_quality.apply(p, scale);
+		_adaptiveTriangles += tess::triangle_count(p);
 
-		_model->vertices.insert(_model->vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
-		_model->elements.insert(_model->elements.end(), mesh.elements.begin(), mesh.elements.end());
+		const auto position = _batch.add(p);
+		queuePrimitive(m4);
+		return position;
+	}
+
+	// append the elements of a batch range to the model, in 16 bits if its mesh has few enough vertices, and return whether they were
+	bool storeElements(const tess::batch_range& range, unsigned int& firstElement)
+	{
+		// elements are relative to the base vertex of their mesh, so only its vertex count matters
+		const auto first = _result.elements.begin() + range.first_element;
+		const auto last = first + range.element_count;
+
+		if(range.vertex_count <= MAX_SHORT_ELEMENT_VERTICES)
+		{
+			firstElement = _model->shortElements.size();
+			_model->shortElements.insert(_model->shortElements.end(), first, last);
+			return true;
+		}
 
-		AABB bounds;
+		firstElement = _model->elements.size();
+		_model->elements.insert(_model->elements.end(), first, last);
+		return false;
+	}
 
-		for(auto v : mesh.vertices)
+	// whether the geometry stored for a cached range is exactly the given mesh, the cache keeps no copy of polygonal meshes
+	bool sameMesh(unsigned int cacheEntry, const tess::vertex* vertices, unsigned int vertexCount, const tess::element* elements, unsigned int elementCount) const
+	{
+		if(cacheEntry >= _cachedRanges.size())
 		{
-			auto worldPos = glm::vec3(m4 * glm::vec4(v.position, 1.0f));
-			_model->bounds.expand(worldPos);
-			bounds.expand(worldPos);
+			return false;
+		}
+
+		const auto& r = _cachedRanges[cacheEntry];
+		if(!std::equal(vertices, vertices + vertexCount, _model->vertices.begin() + r.baseVertex))
+		{
+			return false;
+		}
+
+		if(r.shortElements)
+		{
+			return std::equal(elements, elements + elementCount, _model->shortElements.begin() + r.firstElement);
+		}
+
+		return std::equal(elements, elements + elementCount, _model->elements.begin() + r.firstElement);
+	}
+
+	// pack the vertices of a batch range stored at r.baseVertex, quantized with q or inside a cube around their bounds if q is null
+	void packVertices(const tess::vertex* vertices, unsigned int count, CachedRange& r, const tess::quantization* q = nullptr)
+	{
+		r.quantization = q != nullptr? *q : tess::vertex_quantizer::fit(vertices, count);
+		r.quantizationError = tess::vertex_quantizer::pack(vertices, count, r.quantization, _model->packedVertices.data() + r.baseVertex);
+	}
+
+	void storeBatch()
+	{
+		// tessellation results are already merged, so append all vertices at once
+		const unsigned int baseVertex = _model->vertices.size();
+		_model->vertices.insert(_model->vertices.end(), _result.vertices.begin(), _result.vertices.end());
+		if(QUANTIZE_VERTICES)
+		{
+			_model->packedVertices.resize(_model->vertices.size());
+		}
+
+		for(unsigned int i = 0; i < _result.ranges.size(); ++i)
+		{
+			const auto& range = _result.ranges[i];
+
+			// skip primitives that produced an invalid mesh
+			if(range.element_count == 0)
+			{
+				continue;
+			}
+
+			// geometry of cached primitives is stored only once, the first time it is seen
+			CachedRange r;
+
+			if(range.reused)
+			{
+				r = _cachedRanges[range.cache_entry];
+			}
+			else
+			{
+				r.baseVertex = baseVertex + range.base_vertex;
+				r.shortElements = storeElements(range, r.firstElement);
+				if(QUANTIZE_VERTICES)
+				{
+					packVertices(_result.vertices.data() + range.base_vertex, range.vertex_count, r);
+				}
+
+				if(range.cache_entry != tess::tessellation_cache::npos)
+				{
+					_cachedRanges.resize(std::max<size_t>(_cachedRanges.size(), range.cache_entry + 1));
+					_cachedRanges[range.cache_entry] = r;
+				}
+			}
+
+			const auto& m4 = _queued[i].transform;
+
+			// dequantization of positions is folded into the model matrix, scaling quantization errors like any other length
+			if(QUANTIZE_VERTICES)
+			{
+				const auto scale = glm::max(glm::length(glm::vec3(m4[0])), glm::max(glm::length(glm::vec3(m4[1])), glm::length(glm::vec3(m4[2]))));
+				_maxQuantizationError = glm::max(_maxQuantizationError, r.quantizationError * scale);
+			}
+			_model->transforms.push_back(toTransform(QUANTIZE_VERTICES? m4 * r.quantization.to_matrix() : m4));
+
+			DrawCommand drawCmd;
+			drawCmd.elementCount = range.element_count;
+			drawCmd.instanceCount = 1;
+			drawCmd.firstElement = r.firstElement;
+			drawCmd.baseVertex = r.baseVertex;
+			drawCmd.baseInstance = _model->drawCmds.size(); // automatically fetch the drawID instanced attribute
+			_model->drawCmds.push_back(drawCmd);
+			_model->shortDrawables.push_back(r.shortElements);
+
+			AABB bounds;
+
+			for(unsigned int v = 0; v < range.vertex_count; ++v)
+			{
+				auto worldPos = glm::vec3(m4 * glm::vec4(_model->vertices[r.baseVertex + v].position, 1.0f));
+				_model->bounds.expand(worldPos);
+				bounds.expand(worldPos);
+			}
+
+			_model->drawableBounds.push_back(bounds);
+
+			_model->materials.push_back(_queued[i].material);
 		}
+	}
 
-		_model->drawableBounds.push_back(bounds);
+	void storeLazy()
+	{
+		for(unsigned int i = 0; i < _batch.size(); ++i)
+		{
+			const auto& m4 = _queued[i].transform;
+
+			// bounds of the primitive itself, its tessellation lies inside
+			glm::vec3 minCorner, maxCorner;
+			_batch.get_bounds(i, minCorner, maxCorner);
 
-		_model->materials.push_back(_currMaterial);
+			AABB bounds;
+			for(unsigned int c = 0; c < 8; ++c)
+			{
+				const auto corner = glm::vec3(c & 1? maxCorner.x : minCorner.x, c & 2? maxCorner.y : minCorner.y, c & 4? maxCorner.z : minCorner.z);
+				const auto worldPos = glm::vec3(m4 * glm::vec4(corner, 1.0f));
+				_model->bounds.expand(worldPos);
+				bounds.expand(worldPos);
+			}
+
+			_model->drawableBounds.push_back(bounds);
+
+			LazyDrawable d;
+			d.transform = m4;
+			d.state = LAZY_UNLOADED;
+			d.lastFrame = 0;
+			d.firstVertex = 0;
+			d.vertexCount = 0;
+			d.firstElement = 0;
+			d.elementCount = 0;
+			_model->lazyDrawables.push_back(d);
+			_model->lazyPrimitives.add(_batch, i);
+
+			// quantization is folded into the transform once the geometry is known, and commands are only drawn then
+			_model->transforms.push_back(toTransform(m4));
+
+			DrawCommand drawCmd;
+			drawCmd.elementCount = 0;
+			drawCmd.instanceCount = 1;
+			drawCmd.firstElement = 0;
+			drawCmd.baseVertex = 0;
+			drawCmd.baseInstance = _model->drawCmds.size(); // automatically fetch the drawID instanced attribute
+			_model->drawCmds.push_back(drawCmd);
+			_model->shortDrawables.push_back(false);
+
+			_model->materials.push_back(_queued[i].material);
+		}
 	}
 
-	TransformData toTransform(const glm::mat4& m)
+public:
+	// also used by Scene::updateLazy once the quantization of lazy geometry is known
+	static TransformData toTransform(const glm::mat4& m)
 	{
 		TransformData t;
 
@@ -197,9 +548,244 @@ private:
 		return t;
 	}
 
+private:
 	ModelData* _model;
 	rvm::MaterialTable _materials;
 	MaterialData _currMaterial;
+
+	tess::primitive_batch _batch;
+	std::vector<tess::point> _facePoints; // points of the mesh face being read
+	std::vector<unsigned int> _faceContours; // first point of each contour of that face, plus its end (see tess::polygon_view)
+	std::vector<QueuedPrimitive> _queued;
+	tess::batch_tessellator _tessellator;
+	tess::batch_result _result;
+	tess::tessellation_cache _cache;
+	std::vector<CachedRange> _cachedRanges;
+	tess::tessellation_quality _quality;
+	unsigned long long _fixedTriangles = 0;
+	unsigned long long _adaptiveTriangles = 0;
+	tess::cap_culler _caps;
+	unsigned int _capsRemoved = 0;
+	float _maxQuantizationError = 0.0f; // in world units
+};
+
+// first-fit allocator of ranges inside a pool of fixed size, freed ranges are merged with their neighbours
+class RangeAllocator
+{
+public:
+	static const unsigned int npos = ~0U;
+
+	void reset(unsigned int size)
+	{
+		_free.clear();
+		_free[0] = size;
+		_size = size;
+		_used = 0;
+		_peak = 0;
+	}
+
+	// offset of a new range of count units, or npos if no free range is large enough
+	unsigned int allocate(unsigned int count)
+	{
+		for(auto it = _free.begin(); it != _free.end(); ++it)
+		{
+			if(it->second < count)
+			{
+				continue;
+			}
+
+			const auto offset = it->first;
+			const auto remaining = it->second - count;
+			_free.erase(it);
+			if(remaining > 0)
+			{
+				_free[offset + count] = remaining;
+			}
+
+			_used += count;
+			_peak = std::max(_peak, _used);
+			return offset;
+		}
+
+		return npos;
+	}
+
+	void free(unsigned int offset, unsigned int count)
+	{
+		_used -= count;
+
+		// merge with the free ranges right after and right before
+		auto next = _free.lower_bound(offset);
+		if(next != _free.end() && next->first == offset + count)
+		{
+			count += next->second;
+			next = _free.erase(next);
+		}
+
+		if(next != _free.begin())
+		{
+			auto prev = std::prev(next);
+			if(prev->first + prev->second == offset)
+			{
+				prev->second += count;
+				return;
+			}
+		}
+
+		_free[offset] = count;
+	}
+
+	unsigned int size() const { return _size; }
+	unsigned int used() const { return _used; }
+	unsigned int peak() const { return _peak; }
+
+private:
+	std::map<unsigned int, unsigned int> _free; // offset -> count
+	unsigned int _size = 0;
+	unsigned int _used = 0;
+	unsigned int _peak = 0;
+};
+
+// tessellates requests of lazy drawables on a thread of its own, which also wakes up the worker threads of its batch_tessellator (created once, with it)
+// there is a single request at a time: it is handed over by submit and its meshes are taken back by collect
+class LazyTessellator
+{
+public:
+	// geometry of a drawable inside the arrays of Result, invalid meshes have no elements
+	struct Mesh
+	{
+		unsigned int drawable;
+		unsigned int firstVertex;
+		unsigned int vertexCount;
+		unsigned int firstElement;
+		unsigned int elementCount;
+		tess::quantization quantization;
+	};
+
+	struct Result
+	{
+		std::vector<Mesh> meshes;
+		std::vector<tess::vertex> vertices;
+		std::vector<tess::packed_vertex> packedVertices; // instead of vertices if QUANTIZE_VERTICES
+		std::vector<tess::element> elements;
+	};
+
+	LazyTessellator() : _thread(&LazyTessellator::run, this)
+	{
+	}
+
+	~LazyTessellator()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_quit = true;
+		}
+		_condition.notify_one();
+		_thread.join();
+	}
+
+	// primitive i of batch belongs to drawables[i], both are taken over
+	void submit(tess::primitive_batch& batch, std::vector<unsigned int>& drawables)
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			std::swap(_batch, batch);
+			_drawables.swap(drawables);
+			_pending = true;
+		}
+		_condition.notify_one();
+	}
+
+	// return false while the submitted request is not done yet
+	bool collect(Result& result)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if(!_done)
+		{
+			return false;
+		}
+
+		std::swap(result, _result);
+		_done = false;
+		return true;
+	}
+
+private:
+	LazyTessellator(const LazyTessellator&) = delete;
+	LazyTessellator& operator=(const LazyTessellator&) = delete;
+
+	void run()
+	{
+		// no tessellation cache: it would keep a copy of every mesh ever requested, while the pools only keep what was drawn recently
+		for(;;)
+		{
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_condition.wait(lock, [this]{ return _quit || _pending; });
+				if(_quit)
+				{
+					return;
+				}
+				_pending = false;
+			}
+
+			// nothing below is touched by the drawing thread until the request is done
+			_tessellator.tessellate(_batch, _tessResult);
+
+			_result.meshes.clear();
+			_result.vertices.clear();
+			_result.packedVertices.clear();
+			_result.elements.clear();
+
+			for(unsigned int i = 0; i < _batch.size(); ++i)
+			{
+				const auto& range = _tessResult.ranges[i];
+
+				const auto vertices = _tessResult.vertices.data() + range.base_vertex;
+				const auto elements = _tessResult.elements.data() + range.first_element;
+
+				Mesh m;
+				m.drawable = _drawables[i];
+				m.firstVertex = QUANTIZE_VERTICES? _result.packedVertices.size() : _result.vertices.size();
+				m.vertexCount = range.vertex_count;
+				m.firstElement = _result.elements.size();
+				m.elementCount = range.element_count;
+
+				if(QUANTIZE_VERTICES)
+				{
+					m.quantization = tess::vertex_quantizer::fit(vertices, range.vertex_count);
+					_result.packedVertices.resize(m.firstVertex + range.vertex_count);
+					tess::vertex_quantizer::pack(vertices, range.vertex_count, m.quantization, _result.packedVertices.data() + m.firstVertex);
+				}
+				else
+				{
+					_result.vertices.insert(_result.vertices.end(), vertices, vertices + range.vertex_count);
+				}
+
+				_result.elements.insert(_result.elements.end(), elements, elements + range.element_count);
+				_result.meshes.push_back(m);
+			}
+
+			std::lock_guard<std::mutex> lock(_mutex);
+			_done = true;
+		}
+	}
+
+	tess::batch_tessellator _tessellator;
+	tess::batch_result _tessResult;
+
+	// shared with the drawing thread
+	std::mutex _mutex;
+	std::condition_variable _condition;
+	tess::primitive_batch _batch;
+	std::vector<unsigned int> _drawables;
+	Result _result;
+	bool _pending = false;
+	bool _done = false;
+	bool _quit = false;
+
+	// last, so it starts once everything above is constructed
+	std::thread _thread;
 };
 
 class Scene
@@ -239,11 +825,36 @@ public:
 
 		GLuint vbo;
 		glCreateBuffers(1, &vbo);
-		glNamedBufferStorage(vbo, _model.vertices.size()*sizeof(tess::vertex), _model.vertices.data(), 0); // flags = 0
+		if(TESS_LAZY)
+		{
+			// pools are filled while drawing, see updateLazy
+			const size_t vertexSize = QUANTIZE_VERTICES? sizeof(tess::packed_vertex) : sizeof(tess::vertex);
+			glNamedBufferStorage(vbo, LAZY_POOL_VERTICES*vertexSize, nullptr, GL_DYNAMIC_STORAGE_BIT); // data = nullptr
+			_lazyVerticesBuffer = vbo;
+		}
+		else if(QUANTIZE_VERTICES)
+		{
+			glNamedBufferStorage(vbo, _model.packedVertices.size()*sizeof(tess::packed_vertex), _model.packedVertices.data(), 0); // flags = 0
+		}
+		else
+		{
+			glNamedBufferStorage(vbo, _model.vertices.size()*sizeof(tess::vertex), _model.vertices.data(), 0); // flags = 0
+		}
+
+		// buffers cannot be empty, and usually no mesh needs 32-bit elements
+		glCreateBuffers(1, &_model.shortElementsBuffer);
+		glNamedBufferStorage(_model.shortElementsBuffer, std::max<size_t>(_model.shortElements.size(), 1)*sizeof(GLushort), _model.shortElements.data(), 0); // flags = 0
 
-		GLuint ebo;
-		glCreateBuffers(1, &ebo);
-		glNamedBufferStorage(ebo, _model.elements.size()*sizeof(tess::element), _model.elements.data(), 0); // flags = 0
+		glCreateBuffers(1, &_model.elementsBuffer);
+		if(TESS_LAZY)
+		{
+			// geometry in the pools always uses 32-bit elements
+			glNamedBufferStorage(_model.elementsBuffer, LAZY_POOL_ELEMENTS*sizeof(tess::element), nullptr, GL_DYNAMIC_STORAGE_BIT); // data = nullptr
+		}
+		else
+		{
+			glNamedBufferStorage(_model.elementsBuffer, std::max<size_t>(_model.elements.size(), 1)*sizeof(tess::element), _model.elements.data(), 0); // flags = 0
+		}
 
 		// ------------------------------------------------------------------------
 		// 3- Setup vertex array object
@@ -255,20 +866,28 @@ public:
 		glCreateVertexArrays(1, &_model.vao);
 
 		// bind vbo to vao
-		glVertexArrayVertexBuffer(_model.vao, bufferIndex, vbo, 0, sizeof(tess::vertex)); // offset = 0, stride = sizeof(tess::vertex)
+		const GLsizei stride = QUANTIZE_VERTICES? sizeof(tess::packed_vertex) : sizeof(tess::vertex);
+		glVertexArrayVertexBuffer(_model.vao, bufferIndex, vbo, 0, stride); // offset = 0
 
 		// setup position attrib
 		glEnableVertexArrayAttrib(_model.vao, IN_POSITION);
 		glVertexArrayAttribBinding(_model.vao, IN_POSITION, bufferIndex);
-		glVertexArrayAttribFormat(_model.vao, IN_POSITION, 3, GL_FLOAT, GL_FALSE, 0); // size = 3, normalized = false, offset = 0
 
 		// setup normal attrib
 		glEnableVertexArrayAttrib(_model.vao, IN_NORMAL);
 		glVertexArrayAttribBinding(_model.vao, IN_NORMAL, bufferIndex);
-		glVertexArrayAttribFormat(_model.vao, IN_NORMAL, 3, GL_FLOAT, GL_FALSE, sizeof(tess::vertex::position)); // size = 3, normalized = false, offset = sizeof(tess::vertex::position)
 
-		// bind ebo
-		glVertexArrayElementBuffer(_model.vao, ebo);
+		if(QUANTIZE_VERTICES)
+		{
+			// positions are mapped back from [0, 1] by the model matrix, octahedral normals are decoded by the vertex shader
+			glVertexArrayAttribFormat(_model.vao, IN_POSITION, 3, GL_UNSIGNED_SHORT, GL_TRUE, 0); // size = 3, normalized = true, offset = 0
+			glVertexArrayAttribFormat(_model.vao, IN_NORMAL, 2, GL_SHORT, GL_TRUE, sizeof(tess::packed_vertex::position)); // size = 2, normalized = true, offset = sizeof(tess::packed_vertex::position)
+		}
+		else
+		{
+			glVertexArrayAttribFormat(_model.vao, IN_POSITION, 3, GL_FLOAT, GL_FALSE, 0); // size = 3, normalized = false, offset = 0
+			glVertexArrayAttribFormat(_model.vao, IN_NORMAL, 3, GL_FLOAT, GL_FALSE, sizeof(tess::vertex::position)); // size = 3, normalized = false, offset = sizeof(tess::vertex::position)
+		}
 
 		// ------------------------------------------------------------------------
 		// 4- Create shader program
@@ -292,8 +911,9 @@ public:
 		// 5- Setup storage buffers to store per-instance data
 		// ------------------------------------------------------------------------
 
+		// lazy drawables get the quantization of their geometry once it is tessellated
 		glCreateBuffers(1, &_model.transformsSSBO);
-		glNamedBufferStorage(_model.transformsSSBO, _model.transforms.size()*sizeof(TransformData), _model.transforms.data(), 0); // flags = 0
+		glNamedBufferStorage(_model.transformsSSBO, _model.transforms.size()*sizeof(TransformData), _model.transforms.data(), TESS_LAZY? GL_DYNAMIC_STORAGE_BIT : 0);
 
 		glCreateBuffers(1, &_model.materialsSSBO);
 		glNamedBufferStorage(_model.materialsSSBO, _model.materials.size()*sizeof(MaterialData), _model.materials.data(), 0); // flags = 0
@@ -352,6 +972,17 @@ public:
 		glVertexArrayAttribBinding(_model.vao, IN_DRAWID, bufferIndex);
 		glVertexArrayAttribIFormat(_model.vao, IN_DRAWID, 1, GL_INT, 0); // size = 1, offset = 0
 
+		// ------------------------------------------------------------------------
+		// 8- Start the tessellation thread of lazy drawables
+		// ------------------------------------------------------------------------
+
+		if(TESS_LAZY)
+		{
+			_lazyVertices.reset(LAZY_POOL_VERTICES);
+			_lazyElements.reset(LAZY_POOL_ELEMENTS);
+			_lazyTessellator.reset(new LazyTessellator());
+		}
+
 		return true;
 	}
 
@@ -383,6 +1014,12 @@ public:
 		}
 		double cullTime = t.msec();
 
+		// drawables seen for the first time are tessellated, and only those already in the pools are drawn
+		if(TESS_LAZY)
+		{
+			updateLazy();
+		}
+
 		// ----------------------------------------------------------------------------------------------------------------------
 		// Update persistent mapped buffer
 		// ----------------------------------------------------------------------------------------------------------------------
@@ -404,15 +1041,31 @@ public:
 			std::cout << "Waited too long to refill persistent mapped buffer: " << msec << " ms" << std::endl;
 		}
 
-		// 2- fill buffer with new commands
-		unsigned int dst = 0;
+		// 2- fill buffer with new commands, those of 16-bit elements from its start and those of 32-bit elements from its end
+		unsigned int shortCount = 0;
+		unsigned int firstWide = _model.drawCmds.size();
 		for(auto d : _model.visibleDrawables)
 		{
-			_model.persistentDrawCmdsBuffer[dst++] = _model.drawCmds.at(d);
+			if(TESS_LAZY && _model.lazyDrawables[d].state != LAZY_RESIDENT)
+			{
+				continue;
+			}
+
+			if(_model.shortDrawables[d])
+			{
+				_model.persistentDrawCmdsBuffer[shortCount++] = _model.drawCmds.at(d);
+			}
+			else
+			{
+				_model.persistentDrawCmdsBuffer[--firstWide] = _model.drawCmds.at(d);
+			}
 		}
 
+		const unsigned int wideCount = _model.drawCmds.size() - firstWide;
+
 		// 3- flush newly written contents from the CPU to the GPU
-		glFlushMappedNamedBufferRange(_model.drawCmdsBuffer, 0, _model.visibleDrawables.size()*sizeof(DrawCommand));
+		glFlushMappedNamedBufferRange(_model.drawCmdsBuffer, 0, shortCount*sizeof(DrawCommand));
+		glFlushMappedNamedBufferRange(_model.drawCmdsBuffer, firstWide*sizeof(DrawCommand), wideCount*sizeof(DrawCommand));
 
 		// ----------------------------------------------------------------------------------------------------------------------
 		// Draw scene
@@ -425,21 +1078,209 @@ public:
 		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SB_MATERIAL, _model.materialsSSBO);
 		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _model.drawCmdsBuffer);
 
-		// draw
-		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, 0, _model.visibleDrawables.size(), 0); // offset = 0, stride = 0
+		// draw one batch per element type, each with its own element buffer
+		glVertexArrayElementBuffer(_model.vao, _model.shortElementsBuffer);
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT, 0, shortCount, 0); // offset = 0, stride = 0
+
+		glVertexArrayElementBuffer(_model.vao, _model.elementsBuffer);
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (const void*)(firstWide*sizeof(DrawCommand)), wideCount, 0); // stride = 0
 
 		// set fence to wait for draw to finish
 		fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0); // flags = 0 (not used)
 
+		// the scene is created when the program starts, so this includes loading
+		if(_frameCount++ == 0)
+		{
+			std::cout << "first frame after " << _startTimer.msec() << " ms" << std::endl;
+		}
+
 		if(_reportTimer.sec() > 0.5)
 		{
 			std::cout << "culling time: " << cullTime << " ms (visible: " << _model.visibleDrawables.size() << ")" << std::endl;
+
+			if(TESS_LAZY)
+			{
+				const size_t vertexSize = QUANTIZE_VERTICES? sizeof(tess::packed_vertex) : sizeof(tess::vertex);
+				std::cout << "lazy pools: " << _lazyVertices.used()*vertexSize / 1024 << " KB vertices (peak " << _lazyVertices.peak()*vertexSize / 1024 << " KB of " <<
+				             _lazyVertices.size()*vertexSize / 1024 << " KB), " << _lazyElements.used()*sizeof(tess::element) / 1024 << " KB elements (peak " <<
+				             _lazyElements.peak()*sizeof(tess::element) / 1024 << " KB of " << _lazyElements.size()*sizeof(tess::element) / 1024 << " KB), " <<
+				             "resident drawables: " << _lazyResident << "/" << _model.lazyDrawables.size() << ", evicted: " << _lazyEvictions <<
+				             ", rejected by full pools: " << _lazyRejections << std::endl;
+			}
+
 			_reportTimer.restart();
 		}
 	}
 
 private:
+	// upload meshes tessellated since the last frame, then request visible drawables that are not in the pools yet
+	void updateLazy()
+	{
+		++_lazyFrame;
+
+		// 1- visible drawables are the most recently used, and cannot be evicted during this frame
+		for(auto d : _model.visibleDrawables)
+		{
+			_model.lazyDrawables[d].lastFrame = _lazyFrame;
+		}
+
+		// 2- store meshes of the last request
+		if(_lazyInFlight && _lazyTessellator->collect(_lazyResult))
+		{
+			_lazyInFlight = false;
+			for(const auto& m : _lazyResult.meshes)
+			{
+				storeLazyMesh(m);
+			}
+		}
+
+		if(_lazyInFlight)
+		{
+			return;
+		}
+
+		// 3- send a new request, drawables are copied in the order they are found visible
+		tess::primitive_batch batch;
+		std::vector<unsigned int> drawables;
+
+		for(auto d : _model.visibleDrawables)
+		{
+			auto& drawable = _model.lazyDrawables[d];
+			if(drawable.state == LAZY_UNLOADED && drawables.size() < LAZY_MAX_REQUESTS)
+			{
+				batch.add(_model.lazyPrimitives, d);
+				drawables.push_back(d);
+				drawable.state = LAZY_REQUESTED;
+			}
+		}
+
+		if(!drawables.empty())
+		{
+			_lazyTessellator->submit(batch, drawables);
+			_lazyInFlight = true;
+		}
+		else if(!_lazyComplete)
+		{
+			_lazyComplete = true;
+			std::cout << "visible geometry complete after " << _startTimer.msec() << " ms" << std::endl;
+		}
+	}
+
+	// copy a mesh into the pools, evicting the geometry drawn least recently until it fits
+	void storeLazyMesh(const LazyTessellator::Mesh& m)
+	{
+		auto& d = _model.lazyDrawables[m.drawable];
+		if(m.elementCount == 0)
+		{
+			d.state = LAZY_INVALID;
+			return;
+		}
+
+		for(;;)
+		{
+			d.firstVertex = _lazyVertices.allocate(m.vertexCount);
+			d.firstElement = d.firstVertex != RangeAllocator::npos? _lazyElements.allocate(m.elementCount) : RangeAllocator::npos;
+			if(d.firstElement != RangeAllocator::npos)
+			{
+				break;
+			}
+
+			if(d.firstVertex != RangeAllocator::npos)
+			{
+				_lazyVertices.free(d.firstVertex, m.vertexCount);
+			}
+
+			// visible geometry alone fills the pools: try again the next time the drawable is found visible
+			if(!evictLeastRecentlyUsed())
+			{
+				d.state = LAZY_UNLOADED;
+				++_lazyRejections;
+				return;
+			}
+		}
+
+		d.vertexCount = m.vertexCount;
+		d.elementCount = m.elementCount;
+		d.state = LAZY_RESIDENT;
+		++_lazyResident;
+
+		if(QUANTIZE_VERTICES)
+		{
+			glNamedBufferSubData(_lazyVerticesBuffer, d.firstVertex*sizeof(tess::packed_vertex), m.vertexCount*sizeof(tess::packed_vertex),
+			                     _lazyResult.packedVertices.data() + m.firstVertex);
+		}
+		else
+		{
+			glNamedBufferSubData(_lazyVerticesBuffer, d.firstVertex*sizeof(tess::vertex), m.vertexCount*sizeof(tess::vertex), _lazyResult.vertices.data() + m.firstVertex);
+		}
+		glNamedBufferSubData(_model.elementsBuffer, d.firstElement*sizeof(tess::element), m.elementCount*sizeof(tess::element), _lazyResult.elements.data() + m.firstElement);
+
+		const auto transform = ModelLoader::toTransform(QUANTIZE_VERTICES? d.transform * m.quantization.to_matrix() : d.transform);
+		glNamedBufferSubData(_model.transformsSSBO, m.drawable*sizeof(TransformData), sizeof(TransformData), &transform);
+
+		auto& drawCmd = _model.drawCmds[m.drawable];
+		drawCmd.elementCount = m.elementCount;
+		drawCmd.firstElement = d.firstElement;
+		drawCmd.baseVertex = d.firstVertex;
+	}
+
+	bool evictLeastRecentlyUsed()
+	{
+		// candidates are sorted once per frame, least recently used last
+		if(_lazyEvictableFrame != _lazyFrame)
+		{
+			_lazyEvictableFrame = _lazyFrame;
+			_lazyEvictable.clear();
+
+			for(unsigned int i = 0; i < _model.lazyDrawables.size(); ++i)
+			{
+				const auto& d = _model.lazyDrawables[i];
+				if(d.state == LAZY_RESIDENT && d.lastFrame < _lazyFrame)
+				{
+					_lazyEvictable.push_back(i);
+				}
+			}
+
+			std::sort(_lazyEvictable.begin(), _lazyEvictable.end(), [this](unsigned int a, unsigned int b)
+			{
+				return _model.lazyDrawables[a].lastFrame > _model.lazyDrawables[b].lastFrame;
+			});
+		}
+
+		if(_lazyEvictable.empty())
+		{
+			return false;
+		}
+
+		auto& d = _model.lazyDrawables[_lazyEvictable.back()];
+		_lazyEvictable.pop_back();
+
+		_lazyVertices.free(d.firstVertex, d.vertexCount);
+		_lazyElements.free(d.firstElement, d.elementCount);
+		d.state = LAZY_UNLOADED;
+		--_lazyResident;
+		++_lazyEvictions;
+		return true;
+	}
+
 	ModelData _model;
 	FrustumCuller _frustumCuller;
 	Timer _reportTimer;
+	Timer _startTimer;
+	unsigned int _frameCount = 0;
+
+	// TESS_LAZY
+	std::unique_ptr<LazyTessellator> _lazyTessellator;
+	LazyTessellator::Result _lazyResult;
+	bool _lazyInFlight = false;
+	bool _lazyComplete = false;
+	GLuint _lazyVerticesBuffer = 0;
+	RangeAllocator _lazyVertices;
+	RangeAllocator _lazyElements;
+	unsigned int _lazyFrame = 0;
+	unsigned int _lazyEvictableFrame = 0;
+	std::vector<unsigned int> _lazyEvictable;
+	unsigned int _lazyResident = 0;
+	unsigned int _lazyEvictions = 0;
+	unsigned int _lazyRejections = 0;
 };
@@ -10,8 +10,30 @@
 #include <FrustumCuller.h>
 #include <rvm/FileReader.h>
 #include <rvm/StatsCollector.h>
-#include <tess/tessellator.h>
-#include <tess/mesh_optimizer.h>
+#include <tess/batch_tessellator.h>
+#include <tess/cap_culler.h>
+#include <tess/meshlet_builder.h>
+#include <tess/vertex_quantizer.h>
+
+// segment counts of each level of detail, from coarsest to finest
+static const int LOD_SEGMENT_COUNTS[MAX_LODS] = {4, 8, 16, 32};
+static const int LOD_SWEEP_COUNTS[MAX_LODS] = {2, 4, 8, 16};
+
+// polygonal meshes are simplified: each coarser level keeps at most this fraction of the triangles of the next finer one
+static const float LOD_POLYGONAL_RATIO = 0.5f;
+
+// maximum geometric error allowed on screen when selecting levels of detail, in pixels
+static const float LOD_MAX_PIXEL_ERROR = 0.5f;
+
+// meshes with at most this many vertices store their elements in 16 bits, larger ones in 32 bits
+static const unsigned int MAX_SHORT_ELEMENT_VERTICES = 65536;
+
+// triangles submitted with and without cluster culling are counted and printed once every this many frames
+static const unsigned int CLUSTER_STATS_INTERVAL = 100;
+
+// cylinders, cones, circular tori, dishes and spheres can also be drawn as patches split by the tessellation shaders ('t' switches between both),
+// with edges of about this many pixels: compare triangles generated and frame times in the window title against their clusters
+static const float TESS_SHADER_EDGE_PIXELS = 8.0f;
 
 struct ModelData
 {
@@ -26,145 +48,660 @@ struct ModelData
 	GLuint boundsSSBO;
 	std::vector<BoundsData> drawableBounds;
 
-	GLuint drawCmdsBuffer;
-	std::vector<DrawCommand> drawCmds;
+	GLuint lodsSSBO;
+	std::vector<LodData> lods;
+
+	GLuint clustersSSBO;
+	std::vector<ClusterData> clusters;
+	// largest number of clusters drawn at once with 16-bit and with 32-bit elements: each drawable draws at most its level with most clusters
+	unsigned int maxShortDrawCmds = 0;
+	unsigned int maxDrawCmds = 0;
 
 	std::vector<tess::vertex> vertices;
+	std::vector<tess::packed_vertex> packedVertices; // same indices as vertices, uploaded instead of them if QUANTIZE_VERTICES
+
+	GLuint shortElementsBuffer;
+	std::vector<GLushort> shortElements;
+	GLuint elementsBuffer;
 	std::vector<tess::element> elements;
 
 	GLuint program;
+
+	// one patch per surface of a curved primitive, without vertex attributes
+	GLuint patchVao;
+	GLuint primitivesSSBO;
+	std::vector<PrimitiveData> primitives;
+	GLuint patchesSSBO;
+	std::vector<PatchData> patches;
+	GLuint patchProgram;
 };
 
 class ModelLoader : public rvm::FileReader::IObserver
 {
 public:
-	ModelLoader(ModelData* model) {_model = model;}
+	// threadCount = 0 uses one tessellation thread per hardware core
+	ModelLoader(ModelData* model, unsigned int threadCount = 0) : _tessellator(threadCount)
+	{
+		_model = model;
+		_tessellator.set_cache(&_cache);
+		_cache.set_mesh_comparator([this](unsigned int id, const tess::vertex* vertices, unsigned int vertexCount, const tess::element* elements, unsigned int elementCount)
+		{
+			return sameMesh(id, vertices, vertexCount, elements, elementCount);
+		});
+		_tessellator.set_polygonal_simplification(LOD_POLYGONAL_RATIO);
+	}
 
 	virtual void validPrimitive(const rvm::Box& b)
 	{
-		storeMesh(tess::tessellate_box(glm::make_vec3(b.lengths)), glm::make_mat4(b.transform));
+		tess::box p;
+		p.extents = glm::make_vec3(b.lengths);
+		_batch.add(p);
+		queuePrimitive(glm::make_mat4(b.transform));
 	}
 
 	virtual void validPrimitive(const rvm::Sphere& s)
 	{
-		storeMesh(tess::tessellate_sphere(s.radius), glm::make_mat4(s.transform));
+		tess::sphere p;
+		p.radius = s.radius;
+
+		float errors[MAX_LODS];
+		for(unsigned int lod = 0; lod < MAX_LODS; ++lod)
+		{
+			p.horizontal_count = LOD_SEGMENT_COUNTS[lod];
+			p.vertical_count = LOD_SEGMENT_COUNTS[lod];
+			_batch.add(p);
+			errors[lod] = tess::arc_chord_error(p.radius, glm::two_pi<float>(), p.horizontal_count);
+		}
+
+		queuePrimitive(glm::make_mat4(s.transform), MAX_LODS, errors);
+		queuePatches(toEllipsoid(glm::vec3(p.radius), glm::pi<float>()));
 	}
 
 	virtual void validPrimitive(const rvm::Cylinder& c)
 	{
-		storeMesh(tess::tessellate_cylinder(c.radius, c.height), glm::make_mat4(c.transform));
+		tess::cylinder p;
+		p.radius = c.radius;
+		p.height = c.height;
+
+		const auto firstLod = _batch.size();
+		float errors[MAX_LODS];
+		for(unsigned int lod = 0; lod < MAX_LODS; ++lod)
+		{
+			p.segment_count = LOD_SEGMENT_COUNTS[lod];
+			_batch.add(p);
+			errors[lod] = tess::arc_chord_error(p.radius, glm::two_pi<float>(), p.segment_count);
+		}
+
+		const auto m4 = glm::make_mat4(c.transform);
+		_caps.add(firstLod, p, m4, MAX_LODS);
+		queuePrimitive(m4, MAX_LODS, errors);
+		queuePatches(toCone(p.radius, p.radius, p.height, glm::vec2(), glm::vec2(), glm::vec2()), firstLod);
 	}
 
 	virtual void validPrimitive(const rvm::Dish& d)
 	{
-		storeMesh(tess::tessellate_dish(d.radius, d.height), glm::make_mat4(d.transform));
+		tess::dish p;
+		p.radius = d.radius;
+		p.height = d.height;
+
+		float errors[MAX_LODS];
+		for(unsigned int lod = 0; lod < MAX_LODS; ++lod)
+		{
+			p.horizontal_count = LOD_SEGMENT_COUNTS[lod];
+			p.vertical_count = LOD_SWEEP_COUNTS[lod];
+			_batch.add(p);
+			errors[lod] = glm::max(tess::arc_chord_error(p.radius, glm::two_pi<float>(), p.horizontal_count),
+			                       tess::arc_chord_error(glm::max(p.radius, p.height), glm::half_pi<float>(), p.vertical_count));
+		}
+
+		const auto m4 = glm::make_mat4(d.transform);
+		_caps.add(p, m4);
+		queuePrimitive(m4, MAX_LODS, errors);
+		queuePatches(toEllipsoid(glm::vec3(p.radius, p.radius, p.height), glm::half_pi<float>()));
 	}
 
 	virtual void validPrimitive(const rvm::Pyramid& p)
 	{
-		storeMesh(tess::tessellate_pyramid(glm::make_vec2(p.topLengths), glm::make_vec2(p.bottomLengths), p.height, glm::make_vec2(p.offset)),
-		          glm::make_mat4(p.transform));
+		tess::pyramid t;
+		t.top_extents = glm::make_vec2(p.topLengths);
+		t.bottom_extents = glm::make_vec2(p.bottomLengths);
+		t.height = p.height;
+		t.offset = glm::make_vec2(p.offset);
+		_batch.add(t);
+		queuePrimitive(glm::make_mat4(p.transform));
 	}
 
 	virtual void validPrimitive(const rvm::RectangularTorus& t)
 	{
-		storeMesh(tess::tessellate_rectangular_torus(t.internalRadius, t.externalRadius, t.height, t.sweepAngle), glm::make_mat4(t.transform));
+		tess::rectangular_torus p;
+		p.in_radius = t.internalRadius;
+		p.out_radius = t.externalRadius;
+		p.in_height = t.height;
+		p.sweep_angle = t.sweepAngle;
+
+		float errors[MAX_LODS];
+		for(unsigned int lod = 0; lod < MAX_LODS; ++lod)
+		{
+			p.sweep_count = LOD_SWEEP_COUNTS[lod];
+			_batch.add(p);
+			errors[lod] = tess::arc_chord_error(p.out_radius + p.in_radius, p.sweep_angle, p.sweep_count);
+		}
+
+		queuePrimitive(glm::make_mat4(t.transform), MAX_LODS, errors);
 	}
 
 	virtual void validPrimitive(const rvm::CircularTorus& t)
 	{
-		storeMesh(tess::tessellate_circular_torus(t.internalRadius, t.externalRadius, t.sweepAngle), glm::make_mat4(t.transform));
+		tess::circular_torus p;
+		p.in_radius = t.internalRadius;
+		p.out_radius = t.externalRadius;
+		p.sweep_angle = t.sweepAngle;
+
+		float errors[MAX_LODS];
+		for(unsigned int lod = 0; lod < MAX_LODS; ++lod)
+		{
+			p.segment_count = LOD_SEGMENT_COUNTS[lod];
+			p.sweep_count = LOD_SWEEP_COUNTS[lod];
+			_batch.add(p);
+			errors[lod] = glm::max(tess::arc_chord_error(p.in_radius, glm::two_pi<float>(), p.segment_count),
+			                       tess::arc_chord_error(p.out_radius + p.in_radius, p.sweep_angle, p.sweep_count));
+		}
+
+		const auto m4 = glm::make_mat4(t.transform);
+		_caps.add(p, m4);
+		queuePrimitive(m4, MAX_LODS, errors);
+
+		PrimitiveData patches;
+		patches.params = glm::vec4(p.in_radius, p.out_radius, p.sweep_angle, 0.0f);
+		patches.topSlope = glm::vec4(0.0f);
+		patches.bottomSlope = glm::vec4(0.0f);
+		patches.type = PRIMITIVE_TORUS;
+		patches.segmentCount = 0;
+		patches.sweepCount = 0;
+		patches.caps = 0;
+		queuePatches(patches);
 	}
 
 	virtual void validPrimitive(const rvm::Cone& c)
 	{
-		storeMesh(tess::tessellate_cone(c.radiusTop, c.radiusBottom, c.height),  glm::make_mat4(c.transform));
+		tess::cone p;
+		p.top_radius = c.radiusTop;
+		p.bottom_radius = c.radiusBottom;
+		p.height = c.height;
+
+		const auto firstLod = _batch.size();
+		float errors[MAX_LODS];
+		for(unsigned int lod = 0; lod < MAX_LODS; ++lod)
+		{
+			p.segment_count = LOD_SEGMENT_COUNTS[lod];
+			_batch.add(p);
+			errors[lod] = tess::arc_chord_error(glm::max(p.top_radius, p.bottom_radius), glm::two_pi<float>(), p.segment_count);
+		}
+
+		const auto m4 = glm::make_mat4(c.transform);
+		_caps.add(firstLod, p, m4, MAX_LODS);
+		queuePrimitive(m4, MAX_LODS, errors);
+		queuePatches(toCone(p.top_radius, p.bottom_radius, p.height, glm::vec2(), glm::vec2(), glm::vec2()), firstLod);
 	}
 
 	virtual void validPrimitive(const rvm::SlopedCone& c)
 	{
-		storeMesh(tess::tessellate_cone_slope_offset(c.radiusTop, c.radiusBottom, c.height, glm::make_vec2(c.topSlopeAngle),
-		                                       glm::make_vec2(c.bottomSlopeAngle), glm::make_vec2(c.offset)),
-		          glm::make_mat4(c.transform));
+		tess::cone_slope_offset p;
+		p.top_radius = c.radiusTop;
+		p.bottom_radius = c.radiusBottom;
+		p.height = c.height;
+		p.top_slope_angles = glm::make_vec2(c.topSlopeAngle);
+		p.bottom_slope_angles = glm::make_vec2(c.bottomSlopeAngle);
+		p.offset = glm::make_vec2(c.offset);
+
+		const auto firstLod = _batch.size();
+		float errors[MAX_LODS];
+		for(unsigned int lod = 0; lod < MAX_LODS; ++lod)
+		{
+			p.segment_count = LOD_SEGMENT_COUNTS[lod];
+			_batch.add(p);
+			errors[lod] = tess::arc_chord_error(glm::max(p.top_radius, p.bottom_radius), glm::two_pi<float>(), p.segment_count);
+		}
+
+		const auto m4 = glm::make_mat4(c.transform);
+		_caps.add(firstLod, p, m4, MAX_LODS);
+		queuePrimitive(m4, MAX_LODS, errors);
+		queuePatches(toCone(p.top_radius, p.bottom_radius, p.height, p.top_slope_angles, p.bottom_slope_angles, p.offset), firstLod);
 	}
 
 	virtual void validPrimitive(const rvm::Mesh& mesh)
 	{
-		tess::tessellate_polygonal_begin();
+		_batch.begin_polygonal();
 
 		for(const auto& face : mesh.faces)
 		{
-			tess::polygon tpoly;
-			tpoly.contours.reserve(face.polygons.size());
+			// every face is read into the same buffers, so faces are added without allocating once they are large enough
+			_facePoints.clear();
+			_faceContours.assign(1, 0);
 
 			for(const auto& poly : face.polygons)
 			{
-				tess::contour tcontour;
-				tcontour.points.reserve(poly.points.size());
-
 				for(const auto& point : poly.points)
 				{
 					tess::point tpoint;
 					tpoint.vertex = make_vec3(point.vertex);
 					tpoint.normal = make_vec3(point.normal);
-					tcontour.points.push_back(tpoint);
+					_facePoints.push_back(tpoint);
 				}
 
-				tpoly.contours.push_back(tcontour);
+				_faceContours.push_back(_facePoints.size());
 			}
 
-			tess::tessellate_polygonal_add(tpoly);
+			tess::polygon_view view;
+			view.points = _facePoints.data();
+			view.contour_offsets = _faceContours.data();
+			view.contour_count = face.polygons.size();
+			_batch.add_polygon(view);
 		}
 
-		auto data = tess::tessellate_polygonal_end();
-
-		if(!data.is_valid())
-		{
-			return;
-		}
-
-		tess::mesh_optimizer opt;
-		opt.optimize(data, tess::mesh_optimizer::flag_all_optimizations);
-
-		storeMesh(data, make_mat4(mesh.transform));
+		// errors of simplified levels are only known after tessellation, see storeBatch
+		_batch.end_polygonal(MAX_LODS);
+		queuePrimitive(make_mat4(mesh.transform), MAX_LODS);
 	}
 
 	virtual void beginBlock(rvm::CntBegin& block)
 	{
+		// primitives of the previous group are complete: remove the caps hidden between them
+		_capsRemoved += _caps.cull(_batch);
+
 		rvm::Material m = _materials.getMaterial(block.colorCode);
 		_currMaterial.diffuse = glm::make_vec4(m.diffuseColor);
 		_currMaterial.specular = glm::make_vec4(m.specularColor);
 		_currMaterial.specular.w = m.shininess;
 	}
 
+	virtual void endRead()
+	{
+		// the last group ends with the file
+		_capsRemoved += _caps.cull(_batch);
+
+		// tessellate everything read from the file in parallel and append results in file order
+		Timer t;
+		_tessellator.tessellate(_batch, _result);
+		double msec = t.msec();
+
+		std::cout << "tessellated " << _batch.size() << " primitives in " << msec << " ms using " << _tessellator.get_thread_count() << " threads... ";
+
+		const auto& stats = _cache.get_stats();
+		const auto lookups = stats.hits + stats.misses;
+		std::cout << "cache hits: " << stats.hits << "/" << lookups << " (" << (lookups > 0? 100.0 * stats.hits / lookups : 0.0) << "%), saved " <<
+		             stats.saved_msec << " ms, " << stats.saved_vertex_bytes / 1024 << " KB vertices, " << stats.saved_element_bytes / 1024 << " KB elements... ";
+
+		// identical polygonal meshes share the geometry of the first one, they only get a transform and a material of their own
+		const auto meshes = stats.mesh_hits + stats.mesh_misses;
+		std::cout << "unique polygonal meshes: " << stats.mesh_misses << "/" << meshes << " (" << (meshes > 0? 100.0 * stats.mesh_misses / meshes : 0.0) <<
+		             "%), saved " << stats.saved_mesh_bytes / 1024 << " KB... ";
+		_cache.reset_stats();
+
+		std::cout << "hidden caps removed: " << _capsRemoved << "... ";
+		_capsRemoved = 0;
+
+		const auto firstCluster = _model->clusters.size();
+		const auto firstPatch = _model->patches.size();
+		const auto firstPrimitive = _model->primitives.size();
+		storeBatch();
+
+		const auto elementCount = _model->shortElements.size() + _model->elements.size();
+		std::cout << "elements: " << (_model->shortElements.size() * sizeof(GLushort) + _model->elements.size() * sizeof(tess::element)) / 1024 <<
+		             " KB instead of " << elementCount * sizeof(tess::element) / 1024 << " KB in 32 bits (" <<
+		             (elementCount > 0? 100.0 * _model->shortElements.size() / elementCount : 0.0) << "% in 16 bits)... ";
+
+		if(QUANTIZE_VERTICES)
+		{
+			std::cout << "vertices: " << _model->packedVertices.size() * sizeof(tess::packed_vertex) / 1024 << " KB instead of " <<
+			             _model->vertices.size() * sizeof(tess::vertex) / 1024 << " KB, max quantization error " << _maxQuantizationError << "... ";
+		}
+
+		const auto clusterCount = _model->clusters.size() - firstCluster;
+		unsigned long long clusterElements = 0;
+		for(auto c = firstCluster; c < _model->clusters.size(); ++c)
+		{
+			clusterElements += _model->clusters[c].elementCount;
+		}
+		std::cout << "clusters: " << clusterCount << " (" << (clusterCount > 0? clusterElements / 3.0 / clusterCount : 0.0) << " triangles on average)... ";
+
+		std::cout << "patches: " << _model->patches.size() - firstPatch << " for " << _model->primitives.size() - firstPrimitive << " curved primitives... ";
+
+		_batch.clear();
+		_queued.clear();
+	}
+
 private:
-	void storeMesh(const tess::triangle_mesh& mesh, const glm::mat4& m4)
+	struct QueuedPrimitive
+	{
+		glm::mat4 transform;
+		MaterialData material;
+		unsigned int lodCount;      // levels of detail were added to the batch one after the other
+		float lodErrors[MAX_LODS];  // object-space geometric error of each level, simplified polygonal levels report theirs in batch_range::error
+
+		bool patched;               // curved primitives are also described by a PrimitiveData, split into patches by storeBatch
+		PrimitiveData primitive;
+		unsigned int firstLod;      // batch position of the coarsest level, whose caps are those of all levels
+	};
+
+	struct CachedRange
+	{
+		unsigned int firstElement;
+		unsigned int baseVertex;
+		unsigned int firstMeshlet; // object-space meshlets of the range in _meshlets
+		unsigned int meshletCount;
+		bool shortElements;
+		tess::quantization quantization;
+		float quantizationError; // in model units
+	};
+
+	void queuePrimitive(const glm::mat4& m4, unsigned int lodCount = 1, const float* lodErrors = nullptr)
+	{
+		QueuedPrimitive q;
+		q.transform = m4;
+		q.material = _currMaterial;
+		q.lodCount = lodCount;
+		for(unsigned int i = 0; i < lodCount; ++i)
+		{
+			q.lodErrors[i] = lodErrors != nullptr? lodErrors[i] : 0.0f;
+		}
+		q.patched = false;
+		_queued.push_back(q);
+	}
+
+	// let the tessellation shaders draw the last queued primitive from p, firstLod is only used by primitives with caps
+	void queuePatches(const PrimitiveData& p, unsigned int firstLod = 0)
+	{
+		auto& q = _queued.back();
+		q.patched = true;
+		q.primitive = p;
+		q.firstLod = firstLod;
+	}
+
+	// parameters read by Scene13CADModelFrustumCullingGPUPatch.tese, which chooses segment counts itself and gets cone caps once hidden ones are removed
+	static PrimitiveData toCone(float topRadius, float bottomRadius, float height, const glm::vec2& topSlopeAngles, const glm::vec2& bottomSlopeAngles,
+	                            const glm::vec2& offset)
 	{
-		_model->transforms.push_back(_toTransform(m4));
+		// same rotations and degenerate radii as tess::tessellate_cone_slope_offset, quaternions negated to have w >= 0
+		auto topSlope = glm::quat(glm::vec3(topSlopeAngles.x, topSlopeAngles.y, 0.0f));
+		auto bottomSlope = glm::quat(glm::vec3(bottomSlopeAngles.x, bottomSlopeAngles.y, 0.0f));
+		topSlope = topSlope.w < 0.0f? -topSlope : topSlope;
+		bottomSlope = bottomSlope.w < 0.0f? -bottomSlope : bottomSlope;
+
+		PrimitiveData p;
+		p.params = glm::vec4(glm::abs(topRadius) < 1e-6f? 1e-6f : topRadius, glm::abs(bottomRadius) < 1e-6f? 1e-6f : bottomRadius, height, offset.x);
+		p.topSlope = glm::vec4(topSlope.x, topSlope.y, topSlope.z, offset.y);
+		p.bottomSlope = glm::vec4(bottomSlope.x, bottomSlope.y, bottomSlope.z, 0.0f);
+		p.type = PRIMITIVE_CONE;
+		p.segmentCount = 0;
+		p.sweepCount = 0;
+		p.caps = PRIMITIVE_CAP_TOP | PRIMITIVE_CAP_BOTTOM;
+		return p;
+	}
+
+	static PrimitiveData toEllipsoid(const glm::vec3& radii, float maxVerticalAngle)
+	{
+		PrimitiveData p;
+		p.params = glm::vec4(radii, maxVerticalAngle);
+		p.topSlope = glm::vec4(0.0f);
+		p.bottomSlope = glm::vec4(0.0f);
+		p.type = PRIMITIVE_ELLIPSOID;
+		p.segmentCount = 0;
+		p.sweepCount = 0;
+		p.caps = maxVerticalAngle < glm::pi<float>()? 0 : PRIMITIVE_CAP_BOTTOM; // dishes are open, spheres end at the bottom pole
+		return p;
+	}
+
+	// one patch for the body of a curved primitive and one for each cap of a cone that was not removed
+	void storePatches(const QueuedPrimitive& q, unsigned int drawID, const tess::quantization& quantization)
+	{
+		auto p = q.primitive;
+		if(p.type == PRIMITIVE_CONE)
+		{
+			bool top, bottom;
+			_batch.get_caps(q.firstLod, top, bottom);
+			p.caps = (top? PRIMITIVE_CAP_TOP : 0) | (bottom? PRIMITIVE_CAP_BOTTOM : 0);
+		}
+
+		PatchData patch;
+		patch.quantization = QUANTIZE_VERTICES? glm::vec4(quantization.origin, quantization.size) : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+		patch.drawID = drawID;
+		patch.primitive = _model->primitives.size();
+		patch.padding = 0;
+
+		patch.surface = PATCH_BODY;
+		_model->patches.push_back(patch);
+
+		// caps are patches of their own, the bottom pole of spheres is part of their body
+		if(p.type == PRIMITIVE_CONE && (p.caps & PRIMITIVE_CAP_TOP))
+		{
+			patch.surface = PATCH_TOP_CAP;
+			_model->patches.push_back(patch);
+		}
+
+		if(p.type == PRIMITIVE_CONE && (p.caps & PRIMITIVE_CAP_BOTTOM))
+		{
+			patch.surface = PATCH_BOTTOM_CAP;
+			_model->patches.push_back(patch);
+		}
 
-		DrawCommand drawCmd;
-		drawCmd.elementCount = mesh.elements.size();
-		drawCmd.instanceCount = 1;
-		drawCmd.firstElement = _model->elements.size();
-		drawCmd.baseVertex = _model->vertices.size();
-		drawCmd.baseInstance = _model->drawCmds.size(); // automatically fetch the drawID instanced attribute
-		_model->drawCmds.push_back(drawCmd);
+		_model->primitives.push_back(p);
+	}
 
-		_model->vertices.insert(_model->vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
-		_model->elements.insert(_model->elements.end(), mesh.elements.begin(), mesh.elements.end());
+	// pack the vertices of a batch range stored at r.baseVertex, quantized with q or inside a cube around their bounds if q is null
+	void packVertices(const tess::vertex* vertices, unsigned int count, CachedRange& r, const tess::quantization* q = nullptr)
+	{
+		r.quantization = q != nullptr? *q : tess::vertex_quantizer::fit(vertices, count);
+		r.quantizationError = tess::vertex_quantizer::pack(vertices, count, r.quantization, _model->packedVertices.data() + r.baseVertex);
+	}
 
-		AABB bounds;
+	// whether the geometry stored for a cached range is exactly the given mesh, the cache keeps no copy of polygonal meshes
+	bool sameMesh(unsigned int cacheEntry, const tess::vertex* vertices, unsigned int vertexCount, const tess::element* elements, unsigned int elementCount) const
+	{
+		if(cacheEntry >= _cachedRanges.size())
+		{
+			return false;
+		}
 
-		for(auto v : mesh.vertices)
+		const auto& r = _cachedRanges[cacheEntry];
+		if(!std::equal(vertices, vertices + vertexCount, _model->vertices.begin() + r.baseVertex))
 		{
-			auto worldPos = glm::vec3(m4 * glm::vec4(v.position, 1.0f));
-			_model->bounds.expand(worldPos);
-			bounds.expand(worldPos);
+			return false;
 		}
 
-		_model->drawableBounds.push_back(_toBoundsData(bounds));
+		if(r.shortElements)
+		{
+			return std::equal(elements, elements + elementCount, _model->shortElements.begin() + r.firstElement);
+		}
 
-		_model->materials.push_back(_currMaterial);
+		return std::equal(elements, elements + elementCount, _model->elements.begin() + r.firstElement);
+	}
+
+	// find where the geometry of a batch range was stored inside the model arrays, with vertices quantized with q if not null
+	CachedRange resolveRange(const tess::batch_range& range, unsigned int baseVertex, const tess::quantization* q)
+	{
+		// geometry of cached primitives is stored only once, the first time it is seen
+		if(range.reused)
+		{
+			auto r = _cachedRanges[range.cache_entry];
+
+			// levels of a drawable share its model matrix, so a cached level quantized for another drawable needs its own copy of vertices
+			if(QUANTIZE_VERTICES && q != nullptr && !(r.quantization == *q))
+			{
+				const unsigned int copy = _model->vertices.size();
+				_model->vertices.resize(copy + range.vertex_count);
+				std::copy(_model->vertices.begin() + r.baseVertex, _model->vertices.begin() + r.baseVertex + range.vertex_count, _model->vertices.begin() + copy);
+				_model->packedVertices.resize(_model->vertices.size());
+
+				r.baseVertex = copy;
+				packVertices(_model->vertices.data() + copy, range.vertex_count, r, q);
+			}
+
+			return r;
+		}
+
+		CachedRange r = {0, baseVertex + range.base_vertex, static_cast<unsigned int>(_meshlets.size()), 0, false, {}, 0.0f};
+		if(QUANTIZE_VERTICES)
+		{
+			packVertices(_result.vertices.data() + range.base_vertex, range.vertex_count, r, q);
+		}
+
+		_meshletBuilder.build(_result.vertices.data() + range.base_vertex, _result.elements.data() + range.first_element, range.element_count, _meshlets);
+		r.meshletCount = _meshlets.size() - r.firstMeshlet;
+
+		// elements are relative to the base vertex of their mesh, so only its vertex count decides whether they fit in 16 bits
+		const auto first = _result.elements.begin() + range.first_element;
+		const auto last = first + range.element_count;
+		r.shortElements = range.vertex_count <= MAX_SHORT_ELEMENT_VERTICES;
+
+		if(r.shortElements)
+		{
+			r.firstElement = _model->shortElements.size();
+			_model->shortElements.insert(_model->shortElements.end(), first, last);
+		}
+		else
+		{
+			r.firstElement = _model->elements.size();
+			_model->elements.insert(_model->elements.end(), first, last);
+		}
+
+		if(range.cache_entry != tess::tessellation_cache::npos)
+		{
+			_cachedRanges.resize(std::max<size_t>(_cachedRanges.size(), range.cache_entry + 1));
+			_cachedRanges[range.cache_entry] = r;
+		}
+
+		return r;
+	}
+
+	void storeBatch()
+	{
+		// tessellation results are already merged, so append all vertices at once
+		const unsigned int baseVertex = _model->vertices.size();
+		_model->vertices.insert(_model->vertices.end(), _result.vertices.begin(), _result.vertices.end());
+		if(QUANTIZE_VERTICES)
+		{
+			_model->packedVertices.resize(_model->vertices.size());
+		}
+
+		unsigned int rangeIndex = 0;
+
+		for(const auto& q : _queued)
+		{
+			const unsigned int firstRange = rangeIndex;
+			rangeIndex += q.lodCount;
+
+			const auto& m4 = q.transform;
+
+			// object-space errors become world-space errors using the largest scale of the transform
+			const auto scales = glm::vec3(glm::length(glm::vec3(m4[0])), glm::length(glm::vec3(m4[1])), glm::length(glm::vec3(m4[2])));
+			const auto scale = glm::max(scales.x, glm::max(scales.y, scales.z));
+
+			// the finest valid level is stored first: its quantization is used by all levels
+			unsigned int finestLevel = q.lodCount;
+			while(finestLevel > 0 && _result.ranges[firstRange + finestLevel - 1].element_count == 0)
+			{
+				--finestLevel;
+			}
+
+			// skip primitives that produced only invalid meshes
+			if(finestLevel == 0)
+			{
+				continue;
+			}
+
+			const auto finest = resolveRange(_result.ranges[firstRange + --finestLevel], baseVertex, nullptr);
+
+			LodData lod;
+			lod.lodCount = 0;
+			lod.patched = q.patched? 1 : 0;
+			unsigned int finestVertexCount = 0;
+			CachedRange levels[MAX_LODS];
+
+			for(unsigned int l = 0; l <= finestLevel; ++l)
+			{
+				const auto& range = _result.ranges[firstRange + l];
+
+				// skip levels that produced an invalid mesh
+				if(range.element_count == 0)
+				{
+					continue;
+				}
+
+				const auto r = l == finestLevel? finest : resolveRange(range, baseVertex, &finest.quantization);
+				lod.error[lod.lodCount] = glm::max(q.lodErrors[l], range.error) * scale;
+				lod.elementCount[lod.lodCount] = range.element_count;
+				lod.firstElement[lod.lodCount] = r.firstElement;
+				lod.baseVertex[lod.lodCount] = r.baseVertex;
+				lod.shortElements[lod.lodCount] = r.shortElements? 1 : 0;
+				levels[lod.lodCount] = r;
+				++lod.lodCount;
+				finestVertexCount = range.vertex_count;
+			}
+
+			// dequantization of positions is folded into the model matrix, scaling quantization errors like any other length
+			if(QUANTIZE_VERTICES)
+			{
+				for(unsigned int l = 0; l < lod.lodCount; ++l)
+				{
+					_maxQuantizationError = glm::max(_maxQuantizationError, levels[l].quantizationError * scale);
+				}
+			}
+
+			const unsigned int drawID = _model->transforms.size();
+			_model->transforms.push_back(_toTransform(QUANTIZE_VERTICES? m4 * finest.quantization.to_matrix() : m4));
+			_model->lods.push_back(lod);
+
+			if(q.patched)
+			{
+				storePatches(q, drawID, finest.quantization);
+			}
+
+			// normal cones survive rotations and uniform scales only, clusters under other transforms are never back-face culled
+			const auto normalMatrix = glm::inverseTranspose(glm::mat3(m4));
+			const bool keepCones = glm::determinant(glm::mat3(m4)) > 0.0f && glm::min(scales.x, glm::min(scales.y, scales.z)) >= scale * 0.999f;
+			unsigned int maxShortClusters = 0;
+			unsigned int maxClusters = 0;
+
+			for(unsigned int l = 0; l < lod.lodCount; ++l)
+			{
+				const auto& r = levels[l];
+				auto& maxLevelClusters = r.shortElements? maxShortClusters : maxClusters;
+				maxLevelClusters = glm::max(maxLevelClusters, r.meshletCount);
+
+				for(unsigned int i = r.firstMeshlet; i < r.firstMeshlet + r.meshletCount; ++i)
+				{
+					const auto& m = _meshlets[i];
+
+					ClusterData cluster;
+					cluster.sphere = glm::vec4(glm::vec3(m4 * glm::vec4(m.center, 1.0f)), m.radius * scale);
+					cluster.cone = glm::vec4(glm::normalize(normalMatrix * m.cone_axis), keepCones? m.cone_cutoff : 1.0f);
+					cluster.drawID = drawID;
+					cluster.lod = l;
+					cluster.firstElement = r.firstElement + m.first_element;
+					cluster.elementCount = m.element_count;
+					_model->clusters.push_back(cluster);
+				}
+			}
+
+			_model->maxShortDrawCmds += maxShortClusters;
+			_model->maxDrawCmds += maxClusters;
+
+			AABB bounds;
+
+			// coarser levels are inscribed in the finest one, so its bounds enclose all levels
+			const unsigned int finestBaseVertex = lod.baseVertex[lod.lodCount - 1];
+			for(unsigned int v = 0; v < finestVertexCount; ++v)
+			{
+				auto worldPos = glm::vec3(m4 * glm::vec4(_model->vertices[finestBaseVertex + v].position, 1.0f));
+				_model->bounds.expand(worldPos);
+				bounds.expand(worldPos);
+			}
+
+			_model->drawableBounds.push_back(_toBoundsData(bounds));
+
+			_model->materials.push_back(q.material);
+		}
 	}
 
 	TransformData _toTransform(const glm::mat4& m)
@@ -199,6 +736,20 @@ private:
 	ModelData* _model;
 	rvm::MaterialTable _materials;
 	MaterialData _currMaterial;
+
+	tess::primitive_batch _batch;
+	std::vector<tess::point> _facePoints; // points of the mesh face being read
+	std::vector<unsigned int> _faceContours; // first point of each contour of that face, plus its end (see tess::polygon_view)
+	std::vector<QueuedPrimitive> _queued;
+	tess::batch_tessellator _tessellator;
+	tess::batch_result _result;
+	tess::tessellation_cache _cache;
+	std::vector<CachedRange> _cachedRanges;
+	tess::meshlet_builder _meshletBuilder;
+	std::vector<tess::meshlet> _meshlets;
+	tess::cap_culler _caps;
+	unsigned int _capsRemoved = 0;
+	float _maxQuantizationError = 0.0f; // in world units
 };
 
 class Scene
@@ -238,11 +789,21 @@ public:
 
 		GLuint vbo;
 		glCreateBuffers(1, &vbo);
-		glNamedBufferStorage(vbo, _model.vertices.size()*sizeof(tess::vertex), _model.vertices.data(), 0); // flags = 0
+		if(QUANTIZE_VERTICES)
+		{
+			glNamedBufferStorage(vbo, _model.packedVertices.size()*sizeof(tess::packed_vertex), _model.packedVertices.data(), 0); // flags = 0
+		}
+		else
+		{
+			glNamedBufferStorage(vbo, _model.vertices.size()*sizeof(tess::vertex), _model.vertices.data(), 0); // flags = 0
+		}
+
+		// buffers cannot be empty, and usually no mesh needs 32-bit elements
+		glCreateBuffers(1, &_model.shortElementsBuffer);
+		glNamedBufferStorage(_model.shortElementsBuffer, std::max<size_t>(_model.shortElements.size(), 1)*sizeof(GLushort), _model.shortElements.data(), 0); // flags = 0
 
-		GLuint ebo;
-		glCreateBuffers(1, &ebo);
-		glNamedBufferStorage(ebo, _model.elements.size()*sizeof(tess::element), _model.elements.data(), 0); // flags = 0
+		glCreateBuffers(1, &_model.elementsBuffer);
+		glNamedBufferStorage(_model.elementsBuffer, std::max<size_t>(_model.elements.size(), 1)*sizeof(tess::element), _model.elements.data(), 0); // flags = 0
 
 		// ------------------------------------------------------------------------
 		// 3- Setup vertex array object
@@ -254,20 +815,28 @@ public:
 		glCreateVertexArrays(1, &_model.vao);
 
 		// bind vbo to vao
-		glVertexArrayVertexBuffer(_model.vao, bufferIndex, vbo, 0, sizeof(tess::vertex)); // offset = 0, stride = sizeof(tess::vertex)
+		const GLsizei stride = QUANTIZE_VERTICES? sizeof(tess::packed_vertex) : sizeof(tess::vertex);
+		glVertexArrayVertexBuffer(_model.vao, bufferIndex, vbo, 0, stride); // offset = 0
 
 		// setup position attrib
 		glEnableVertexArrayAttrib(_model.vao, IN_POSITION);
 		glVertexArrayAttribBinding(_model.vao, IN_POSITION, bufferIndex);
-		glVertexArrayAttribFormat(_model.vao, IN_POSITION, 3, GL_FLOAT, GL_FALSE, 0); // size = 3, normalized = false, offset = 0
 
 		// setup normal attrib
 		glEnableVertexArrayAttrib(_model.vao, IN_NORMAL);
 		glVertexArrayAttribBinding(_model.vao, IN_NORMAL, bufferIndex);
-		glVertexArrayAttribFormat(_model.vao, IN_NORMAL, 3, GL_FLOAT, GL_FALSE, sizeof(tess::vertex::position)); // size = 3, normalized = false, offset = sizeof(tess::vertex::position)
 
-		// bind ebo
-		glVertexArrayElementBuffer(_model.vao, ebo);
+		if(QUANTIZE_VERTICES)
+		{
+			// positions are mapped back from [0, 1] by the model matrix, octahedral normals are decoded by the vertex shader
+			glVertexArrayAttribFormat(_model.vao, IN_POSITION, 3, GL_UNSIGNED_SHORT, GL_TRUE, 0); // size = 3, normalized = true, offset = 0
+			glVertexArrayAttribFormat(_model.vao, IN_NORMAL, 2, GL_SHORT, GL_TRUE, sizeof(tess::packed_vertex::position)); // size = 2, normalized = true, offset = sizeof(tess::packed_vertex::position)
+		}
+		else
+		{
+			glVertexArrayAttribFormat(_model.vao, IN_POSITION, 3, GL_FLOAT, GL_FALSE, 0); // size = 3, normalized = false, offset = 0
+			glVertexArrayAttribFormat(_model.vao, IN_NORMAL, 3, GL_FLOAT, GL_FALSE, sizeof(tess::vertex::position)); // size = 3, normalized = false, offset = sizeof(tess::vertex::position)
+		}
 
 		// ------------------------------------------------------------------------
 		// 4- Create shader program
@@ -300,18 +869,21 @@ public:
 		glCreateBuffers(1, &_model.boundsSSBO);
 		glNamedBufferStorage(_model.boundsSSBO, _model.drawableBounds.size()*sizeof(BoundsData), _model.drawableBounds.data(), 0); // flags = 0
 
+		glCreateBuffers(1, &_model.lodsSSBO);
+		glNamedBufferStorage(_model.lodsSSBO, _model.lods.size()*sizeof(LodData), _model.lods.data(), 0); // flags = 0
+
 		// ------------------------------------------------------------------------
-		// 6- Setup draw command buffer
+		// 6- Setup cluster buffer, the compute shader generates draw commands from it
 		// ------------------------------------------------------------------------
 
-		glCreateBuffers(1, &_model.drawCmdsBuffer);
-		glNamedBufferStorage(_model.drawCmdsBuffer, _model.drawCmds.size()*sizeof(DrawCommand), _model.drawCmds.data(), 0); // flags = 0
+		glCreateBuffers(1, &_model.clustersSSBO);
+		glNamedBufferStorage(_model.clustersSSBO, _model.clusters.size()*sizeof(ClusterData), _model.clusters.data(), 0); // flags = 0
 
 		// ------------------------------------------------------------------------
 		// 7- Setup custom draw ID
 		// ------------------------------------------------------------------------
 
-		std::vector<int> drawIDs(_model.drawCmds.size());
+		std::vector<int> drawIDs(_model.transforms.size());
 		for(unsigned int i = 0; i < drawIDs.size(); ++i)
 		{
 			drawIDs[i] = i;
@@ -354,25 +926,29 @@ public:
 		}
 
 		// compute the number of groups to be dispatched according to scene size and block size
-		// each shader invocation will compute a single geometry
-		_numGroupsX = (_model.drawCmds.size() + CS_BLOCK_SIZE_X - 1) / CS_BLOCK_SIZE_X;
+		// each shader invocation will compute a single cluster
+		_numGroupsX = (_model.clusters.size() + CS_BLOCK_SIZE_X - 1) / CS_BLOCK_SIZE_X;
+
+		// tell compute shader how many clusters are in the scene, so any extra shader invocations can return immediatelly
+		glProgramUniform1ui(_computeProgram, U_SCENE_SIZE, _model.clusters.size());
 
-		// tell compute shader how many geometries are in the scene, so any extra shader invocations can return immediatelly
-		glProgramUniform1ui(_computeProgram, U_SCENE_SIZE, _model.drawCmds.size());
+		// draw commands of 32-bit elements follow all those of 16-bit elements
+		glProgramUniform1ui(_computeProgram, U_WIDE_DRAW_OFFSET, _model.maxShortDrawCmds);
 
 		// -------------------------------------------------------------------------------------------
 		// 9- Setup atomic counter to keep track of how many draw calls were generated inside the GPU
 		// -------------------------------------------------------------------------------------------
 
 		glCreateBuffers(1, &_atomicCounterBuffer);
-		glNamedBufferStorage(_atomicCounterBuffer, sizeof(GLuint), nullptr, GL_DYNAMIC_STORAGE_BIT); // data = nullptr
+		// one counter per element type
+		glNamedBufferStorage(_atomicCounterBuffer, 2*sizeof(GLuint), nullptr, GL_DYNAMIC_STORAGE_BIT); // data = nullptr
 
 		// -------------------------------------------------------------------------------------------
 		// 10- Setup draw commands for visible geometries inside GPU
 		// -------------------------------------------------------------------------------------------
 
 		glCreateBuffers(1, &_visibleDrawCmdsBuffer);
-		glNamedBufferStorage(_visibleDrawCmdsBuffer, _model.drawCmds.size()*sizeof(DrawCommand), nullptr, 0);
+		glNamedBufferStorage(_visibleDrawCmdsBuffer, (_model.maxShortDrawCmds + _model.maxDrawCmds)*sizeof(DrawCommand), nullptr, 0);
 
 		// -------------------------------------------------------------------------------------------
 		// 11- Setup buffer to store frustum data
@@ -381,6 +957,54 @@ public:
 		glCreateBuffers(1, &_frustumSSBO);
 		glNamedBufferStorage(_frustumSSBO, sizeof(FrustumData), nullptr, GL_DYNAMIC_STORAGE_BIT); // data = nullptr
 
+		// -------------------------------------------------------------------------------------------
+		// 12- Setup buffer to count triangles submitted with and without cluster culling
+		// -------------------------------------------------------------------------------------------
+
+		glCreateBuffers(1, &_cullStatsSSBO);
+		glNamedBufferStorage(_cullStatsSSBO, sizeof(CullStatsData), nullptr, GL_DYNAMIC_STORAGE_BIT); // data = nullptr
+
+		// -------------------------------------------------------------------------------------------
+		// 13- Setup patches of curved primitives for the tessellation shaders
+		// -------------------------------------------------------------------------------------------
+
+		// patches read everything from storage buffers, but drawing still needs a vao
+		glCreateVertexArrays(1, &_model.patchVao);
+
+		glCreateBuffers(1, &_model.primitivesSSBO);
+		glNamedBufferStorage(_model.primitivesSSBO, std::max<size_t>(_model.primitives.size(), 1)*sizeof(PrimitiveData), _model.primitives.data(), 0); // flags = 0
+
+		glCreateBuffers(1, &_model.patchesSSBO);
+		glNamedBufferStorage(_model.patchesSSBO, std::max<size_t>(_model.patches.size(), 1)*sizeof(PatchData), _model.patches.data(), 0); // flags = 0
+
+		ShaderLoader patchLoader;
+		if(!patchLoader.addFile(GL_VERTEX_SHADER, "../src/Scene13CADModelFrustumCullingGPUPatch.vert", "../src/ShaderData.h"))
+		{
+			return false;
+		}
+		if(!patchLoader.addFile(GL_TESS_CONTROL_SHADER, "../src/Scene13CADModelFrustumCullingGPUPatch.tesc", "../src/ShaderData.h"))
+		{
+			return false;
+		}
+		if(!patchLoader.addFile(GL_TESS_EVALUATION_SHADER, "../src/Scene13CADModelFrustumCullingGPUPatch.tese", "../src/ShaderData.h"))
+		{
+			return false;
+		}
+		if(!patchLoader.addFile(GL_FRAGMENT_SHADER, "../src/Scene13CADModelFrustumCullingGPU.frag", "../src/ShaderData.h"))
+		{
+			return false;
+		}
+		if(!patchLoader.link(_model.patchProgram))
+		{
+			return false;
+		}
+
+		// a single control point per patch: the tessellation control shader computes levels for the whole surface
+		glPatchParameteri(GL_PATCH_VERTICES, 1);
+
+		// triangles reaching the rasterizer are counted along with submitted ones, for both ways of drawing curved primitives
+		glCreateQueries(GL_PRIMITIVES_GENERATED, 1, &_primitivesQuery);
+
 		return true;
 	}
 
@@ -399,33 +1023,64 @@ public:
 		_frustumCuller.beginFrame(cameraData.viewProjMatrix);
 		glNamedBufferSubData(_frustumSSBO, 0, sizeof(FrustumData), &_frustumCuller.getData());
 
-		// clear atomic counter (zero how many draw calls were generated in the previous frame)
-		GLuint zero = 0;
-		glNamedBufferSubData(_atomicCounterBuffer, 0, sizeof(GLuint), &zero); // offset = 0
+		// update level of detail selection data: a world-space error e at distance d covers e * lodScale / d pixels (scaled by the max pixel error)
+		GLint viewport[4];
+		glGetIntegerv(GL_VIEWPORT, viewport);
+		const auto projMatrix = cameraData.viewProjMatrix * glm::inverse(cameraData.viewMatrix);
+		const auto cameraPos = glm::vec3(glm::inverse(cameraData.viewMatrix)[3]);
+		const auto lodScale = projMatrix[1][1] * 0.5f * static_cast<float>(viewport[3]) / LOD_MAX_PIXEL_ERROR;
+		glProgramUniform3fv(_computeProgram, U_CAMERA_POS, 1, glm::value_ptr(cameraPos));
+		glProgramUniform1f(_computeProgram, U_LOD_SCALE, lodScale);
+
+		// patches are split the same way: a world-space length l at distance d covers l * edgeScale / d edges of TESS_SHADER_EDGE_PIXELS
+		const auto edgeScale = lodScale * LOD_MAX_PIXEL_ERROR / TESS_SHADER_EDGE_PIXELS;
+		glProgramUniform1ui(_computeProgram, U_SKIP_PATCHED, _drawPatches);
+		glProgramUniform3fv(_model.patchProgram, U_CAMERA_POS, 1, glm::value_ptr(cameraPos));
+		glProgramUniform1f(_model.patchProgram, U_EDGE_SCALE, edgeScale);
+
+		// count submitted triangles only once in a while, atomic additions shared by all invocations are slow
+		const bool collectStats = ++_frameCount % CLUSTER_STATS_INTERVAL == 0;
+		glProgramUniform1ui(_computeProgram, U_COLLECT_STATS, collectStats);
+		if(collectStats)
+		{
+			const CullStatsData zeroStats = {0, 0};
+			glNamedBufferSubData(_cullStatsSSBO, 0, sizeof(CullStatsData), &zeroStats); // offset = 0
+		}
+
+		// clear atomic counters (zero how many draw calls were generated in the previous frame)
+		const GLuint zeros[2] = {0, 0};
+		glNamedBufferSubData(_atomicCounterBuffer, 0, sizeof(zeros), zeros); // offset = 0
 
 		// clear draw command buffer (maybe it is more efficient to use a compute shader or to copy from another gpu buffer)
 		// we take benefit of the fact that if data is null, the range is filled with zeroes
-		glClearNamedBufferSubData(_visibleDrawCmdsBuffer, GL_R32UI, 0, _model.drawCmds.size()*sizeof(DrawCommand), GL_RED, GL_UNSIGNED_INT, nullptr);
+		glClearNamedBufferSubData(_visibleDrawCmdsBuffer, GL_R32UI, 0, (_model.maxShortDrawCmds + _model.maxDrawCmds)*sizeof(DrawCommand), GL_RED, GL_UNSIGNED_INT, nullptr);
 
 		// bind stuff to compute
 		glUseProgram(_computeProgram);
 		glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, AC_DRAW_COUNT, _atomicCounterBuffer);
-		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SB_IN_DRAW_CMD, _model.drawCmdsBuffer); // bind as SSBO to read!
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SB_CLUSTER, _model.clustersSSBO);
 		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SB_OUT_DRAW_CMD, _visibleDrawCmdsBuffer); // bind as SSBO to write!
 		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SB_BOUNDS, _model.boundsSSBO);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SB_LOD, _model.lodsSSBO);
 		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SB_FRUSTUM, _frustumSSBO);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SB_CULL_STATS, _cullStatsSSBO);
 
 		// dispatch compute
 		glDispatchCompute(_numGroupsX, 1, 1); // num_groups_y = 1, num_groups_z = 1
 
 		// insert memory barrier to guarantee data will be visible when drawing
 		// the parameter indicates how the written memory will be used afterwards
-		glMemoryBarrier(GL_COMMAND_BARRIER_BIT); // this corresponds to GL_DRAW_INDIRECT_BUFFER later
+		glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT); // this corresponds to GL_DRAW_INDIRECT_BUFFER later, and to reading stats back
 
 		// ----------------------------------------------------------------------------------------------------------------------
 		// Draw scene
 		// ----------------------------------------------------------------------------------------------------------------------
 
+		if(collectStats)
+		{
+			glBeginQuery(GL_PRIMITIVES_GENERATED, _primitivesQuery);
+		}
+
 		// bind stuff to draw
 		glUseProgram(_model.program);
 		glBindVertexArray(_model.vao);
@@ -438,10 +1093,50 @@ public:
 		// if you want to test this, you can comment the "clear draw command buffer" line above, just before compute dispatch, since it would no longer be needed
 		// remember to comment the old draw call below
 //		glBindBuffer(GL_PARAMETER_BUFFER_ARB, _atomicCounterBuffer); // bind atomic counter as the parameter buffer for the multidrawindirect call
-//		glMultiDrawElementsIndirectCountARB(GL_TRIANGLES, GL_UNSIGNED_INT, 0, 0, _model.drawCmds.size(), 0); // drawOffset = 0, drawCountOffset = 0, stride = 0
+//		glMultiDrawElementsIndirectCountARB(GL_TRIANGLES, GL_UNSIGNED_SHORT, 0, 0, _model.maxShortDrawCmds, 0); // drawOffset = 0, drawCountOffset = 0, stride = 0
+//		glMultiDrawElementsIndirectCountARB(GL_TRIANGLES, GL_UNSIGNED_INT, (const void*)(_model.maxShortDrawCmds*sizeof(DrawCommand)), sizeof(GLuint), _model.maxDrawCmds, 0); // stride = 0
 
-		// draw indirect using commands generated by compute shader inside GPU
-		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, 0, _model.drawCmds.size(), 0); // offset = 0, stride = 0
+		// draw indirect using commands generated by compute shader inside GPU, one batch per element type with its own element buffer
+		glVertexArrayElementBuffer(_model.vao, _model.shortElementsBuffer);
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT, 0, _model.maxShortDrawCmds, 0); // offset = 0, stride = 0
+
+		glVertexArrayElementBuffer(_model.vao, _model.elementsBuffer);
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (const void*)(_model.maxShortDrawCmds*sizeof(DrawCommand)), _model.maxDrawCmds, 0); // stride = 0
+
+		// curved primitives skipped by the compute shader: the tessellation control shader culls them and splits the visible ones according to their distance
+		if(_drawPatches)
+		{
+			glUseProgram(_model.patchProgram);
+			glBindVertexArray(_model.patchVao);
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SB_PRIMITIVE, _model.primitivesSSBO);
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SB_PATCH, _model.patchesSSBO);
+			glDrawArrays(GL_PATCHES, 0, _model.patches.size()); // first = 0
+		}
+
+		// reading stats back waits for the compute shader, which is why they are not collected every frame
+		if(collectStats)
+		{
+			glEndQuery(GL_PRIMITIVES_GENERATED);
+
+			CullStatsData stats;
+			glGetNamedBufferSubData(_cullStatsSSBO, 0, sizeof(CullStatsData), &stats); // offset = 0
+			std::cout << "triangles submitted: " << stats.clusterTriangles << " with cluster culling, " << stats.drawableTriangles << " with drawable culling (" <<
+			             (stats.drawableTriangles > 0? 100.0 * (1.0 - static_cast<double>(stats.clusterTriangles) / stats.drawableTriangles) : 0.0) << "% less)";
+
+			GLuint64 generated = 0;
+			glGetQueryObjectui64v(_primitivesQuery, GL_QUERY_RESULT, &generated);
+			std::cout << ", triangles generated: " << generated << " with curved primitives drawn by " << (_drawPatches? "the tessellation shaders" : "their clusters") << std::endl;
+		}
+	}
+
+	// 't' switches curved primitives between their clusters and patches split by the tessellation shaders
+	void keyPress(unsigned char key)
+	{
+		if(key == 't' || key == 'T')
+		{
+			_drawPatches = !_drawPatches && !_model.patches.empty();
+			std::cout << "curved primitives drawn by " << (_drawPatches? "the tessellation shaders" : "their clusters") << std::endl;
+		}
 	}
 
 private:
@@ -452,4 +1147,8 @@ private:
 	GLuint _visibleDrawCmdsBuffer;
 	FrustumCuller _frustumCuller;
 	GLuint _frustumSSBO;
+	GLuint _cullStatsSSBO;
+	unsigned int _frameCount = 0;
+	GLuint _primitivesQuery;
+	bool _drawPatches = false;
 };
@@ -0,0 +1,18 @@
+//-------------------------------------------------------------------------------------------------
+// OUTPUTS
+//-------------------------------------------------------------------------------------------------
+
+out Patch
+{
+    int id;
+} out_Patch;
+
+//-------------------------------------------------------------------------------------------------
+// MAIN
+//-------------------------------------------------------------------------------------------------
+
+void main()
+{
+    // patches have a single control point without attributes: everything is read from storage buffers using its index
+    out_Patch.id = gl_VertexID;
+}
@@ -71,6 +71,80 @@ struct DrawCommand
 	uint  baseInstance; // baseInstance
 };
 
+struct DrawArraysCommand
+{
+	uint  vertexCount; // count
+	uint  instanceCount; // instanceCount
+	uint  firstVertex; // first
+	uint  baseInstance; // baseInstance
+};
+
+// Procedural primitives: round primitives whose vertices are generated from gl_VertexID by the vertex shader (see Scene11CADModelProcedural.vert)
+// triangles come in the same order as the tess::tessellate_* function of each type, non-indexed
+#define PRIMITIVE_CONE		0 // truncated cone with sloped ends, see tess::tessellate_cone_slope_offset
+#define PRIMITIVE_TORUS		1 // circular torus without caps, see tess::tessellate_circular_torus
+#define PRIMITIVE_ELLIPSOID	2 // sphere or dish without cap, see tess::tessellate_ellipsoid
+
+#define PRIMITIVE_CAP_TOP		1
+#define PRIMITIVE_CAP_BOTTOM	2 // ellipsoids: closed by a vertex at the bottom pole
+
+struct PrimitiveData
+{
+	vec4  params;       // cone: top radius, bottom radius, height, offset x; torus: in radius, out radius, sweep angle, 0; ellipsoid: radii, max vertical angle
+	vec4  topSlope;     // cone: xyz = rotation of the top end as a unit quaternion with w >= 0, w = offset y
+	vec4  bottomSlope;  // cone: xyz = rotation of the bottom end as a unit quaternion with w >= 0
+	uint  type;
+	uint  segmentCount; // around the axis (cone, ellipsoid) or the cross-section (torus)
+	uint  sweepCount;   // along the sweep (torus) or the vertical angle (ellipsoid)
+	uint  caps;
+};
+
+// Patches: surfaces of curved primitives tessellated by the tessellation shaders (Scene13), see Scene13CADModelFrustumCullingGPUPatch.tesc
+// each patch is a single control point covering the whole surface, whose quad domain is u around the axis or cross-section and v along it
+#define PATCH_BODY			0
+#define PATCH_TOP_CAP		1 // cones only
+#define PATCH_BOTTOM_CAP	2 // cones only
+
+struct PatchData
+{
+	vec4  quantization; // xyz = origin, w = size of the quantization cube folded into the transform of the drawable (see tess::quantization)
+	uint  drawID;
+	uint  primitive;    // index of the PrimitiveData of the drawable
+	uint  surface;
+	uint  padding;
+};
+
+// Level of detail
+#define MAX_LODS		4
+
+struct LodData
+{
+	uint  lodCount;                // number of valid levels, ordered from coarsest to finest
+	float error[MAX_LODS];         // world-space geometric error of each level
+	uint  elementCount[MAX_LODS];
+	uint  firstElement[MAX_LODS];
+	uint  baseVertex[MAX_LODS];
+	uint  shortElements[MAX_LODS]; // 1 when the elements of a level are stored in 16 bits, 0 in 32 bits
+	uint  patched;                 // 1 when the drawable can also be drawn from patches (see PatchData)
+};
+
+// Clusters: consecutive triangles of one level of detail of a drawable, culled together (see tess::meshlet)
+struct ClusterData
+{
+	vec4  sphere;       // world-space bounding sphere: xyz = center, w = radius
+	vec4  cone;         // world-space normal cone: xyz = axis, w = cutoff (1 = never back facing)
+	uint  drawID;
+	uint  lod;          // level of detail of the drawable the cluster belongs to
+	uint  firstElement;
+	uint  elementCount;
+};
+
+struct CullStatsData
+{
+	uint  drawableTriangles; // triangles submitted when culling whole drawables only
+	uint  clusterTriangles;  // triangles submitted when culling clusters
+};
+
 // Uniform Buffers
 #define UB_CAMERA		0
 #define UB_LIGHT		1
@@ -85,6 +159,14 @@ struct DrawCommand
 #define SB_OUT_DRAW_CMD	4
 #define SB_BOUNDS		5
 #define SB_FRUSTUM      6
+#define SB_LOD			7
+#define SB_CLUSTER		8
+#define SB_CULL_STATS	9
+#define SB_PRIMITIVE	10
+#define SB_PATCH		11
+
+// Vertex format of CAD models (Scene11 to Scene13): 0 = tess::vertex (24 bytes), 1 = tess::packed_vertex (12 bytes, lossy: positions are quantized)
+#define QUANTIZE_VERTICES	0
 
 // Vertex Attributes
 #define IN_POSITION		0
@@ -107,6 +189,12 @@ struct DrawCommand
 // Uniform Variables
 #define U_SCENE_SIZE	0
 #define U_RAND_SEED		1
+#define U_CAMERA_POS	2
+#define U_LOD_SCALE		3
+#define U_COLLECT_STATS	4
+#define U_WIDE_DRAW_OFFSET	5
+#define U_SKIP_PATCHED	6
+#define U_EDGE_SCALE	7
 
 // Atomic Counters
-#define AC_DRAW_COUNT	0
+#define AC_DRAW_COUNT	0 // followed by the count of draw calls using 32-bit elements in the same buffer
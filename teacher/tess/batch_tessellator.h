@@ -0,0 +1,175 @@
+#pragma once
+#include <tess/geometries.h>
+#include <tess/mesh_optimizer.h>
+#include <tess/polygon_tessellator.h>
+#include <tess/tessellation_cache.h>
+#include <tess/tessellator.h>
+#include <limits>
+
+namespace tess
+{
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// primitive_batch: ordered list of primitive descriptions to be tessellated together
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	class primitive_batch
+	{
+	public:
+		enum kind
+		{
+			kind_box,
+			kind_pyramid,
+			kind_cylinder,
+			kind_cone,
+			kind_cone_slope_offset,
+			kind_circular_torus,
+			kind_rectangular_torus,
+			kind_dish,
+			kind_sphere,
+			kind_polygonal
+		};
+
+		struct entry
+		{
+			kind type;
+			unsigned int index; // position inside the array of the corresponding kind
+		};
+
+		// each add returns the position of the primitive in the batch (i.e. its position in batch_result::ranges)
+		unsigned int add(const box& b);
+		unsigned int add(const pyramid& p);
+		unsigned int add(const cylinder& c);
+		unsigned int add(const cone& c);
+		unsigned int add(const cone_slope_offset& c);
+		unsigned int add(const circular_torus& t);
+		unsigned int add(const rectangular_torus& t);
+		unsigned int add(const dish& d);
+		unsigned int add(const sphere& s);
+
+		// polygonal meshes are built the same way as tessellate_polygonal_begin/add/end
+		// lod_count > 1 adds one entry per level of detail, coarsest first and full mesh last, and returns the position of the coarsest
+		// coarser levels are simplified from the full mesh, see batch_tessellator::set_polygonal_simplification
+		// polygons are copied into flat arrays that keep their capacity after clear, so adding a polygon_view does not allocate once they are large enough
+		void begin_polygonal();
+		void add_polygon(const polygon& poly);
+		void add_polygon(const polygon_view& poly);
+		unsigned int end_polygonal(unsigned int lod_count = 1);
+
+		// tessellate a truncated cone (cylinder, cone or sloped cone) already in the batch without its top and/or bottom cap
+		void remove_caps(unsigned int position, bool top, bool bottom);
+
+		// caps a truncated cone already in the batch will be tessellated with, i.e. the ones not removed
+		void get_caps(unsigned int position, bool& top, bool& bottom) const;
+
+		// copy a primitive of another batch, removed caps included, and return its position in this batch
+		// polygonal meshes can only be copied when they have a single level of detail
+		unsigned int add(const primitive_batch& other, unsigned int position);
+
+		// conservative model-space box around a primitive already in the batch, known without tessellating it
+		void get_bounds(unsigned int position, vec3& min_corner, vec3& max_corner) const;
+
+		void clear();
+		unsigned int size() const;
+		bool empty() const;
+
+	private:
+		friend class batch_tessellator;
+
+		// contours of a polygon are a range of _contour_offsets, which has one more offset than contours per polygon (see polygon_view)
+		struct polygon_range
+		{
+			unsigned int first_offset;
+			unsigned int contour_count;
+		};
+
+		unsigned int _add(kind type, unsigned int index);
+
+		polygon_view _polygon_view(unsigned int polygon) const;
+
+		std::vector<entry> _entries;
+		std::vector<box> _boxes;
+		std::vector<pyramid> _pyramids;
+		std::vector<cylinder> _cylinders;
+		std::vector<cone> _cones;
+		std::vector<cone_slope_offset> _sloped_cones;
+		std::vector<circular_torus> _circular_tori;
+		std::vector<rectangular_torus> _rectangular_tori;
+		std::vector<dish> _dishes;
+		std::vector<sphere> _spheres;
+		std::vector<polygonal> _polygonals;
+		std::vector<polygon_range> _polygons;
+		std::vector<unsigned int> _contour_offsets; // into _points
+		std::vector<point> _points;
+	};
+
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// batch_result: merged output of a batch, one range per primitive in batch order
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	struct batch_range
+	{
+		unsigned int first_element = 0;
+		unsigned int element_count = 0; // zero if primitive produced an invalid mesh
+		unsigned int base_vertex = 0;
+		unsigned int vertex_count = 0;
+		unsigned int cache_entry = tessellation_cache::npos; // cache entry holding this geometry, if any
+		bool reused = false; // geometry is not in batch_result: reuse the range where cache_entry was first stored (or found by content)
+		float error = 0.0f;  // distance between a simplified polygonal level and its full mesh (model units)
+	};
+
+	struct batch_result
+	{
+		// elements are relative to the base_vertex of their range
+		std::vector<vertex> vertices;
+		std::vector<element> elements;
+		std::vector<batch_range> ranges;
+	};
+
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// batch_tessellator: tessellates a primitive_batch using a pool of worker threads, created once and kept until destruction
+	// exceptions thrown by any worker are rethrown by tessellate on the calling thread
+	// each worker owns its own polygon_tessellator, mesh_optimizer and mesh_simplifier, so there is no shared state between threads
+	// output is deterministic: it does not depend on the number of threads or on scheduling
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	class batch_tessellator
+	{
+	public:
+		// thread_count = 0 uses one thread per hardware core
+		explicit batch_tessellator(unsigned int thread_count = 0);
+		~batch_tessellator();
+
+		unsigned int get_thread_count() const;
+
+		// optimizations applied to each polygonal mesh after tessellation
+		void set_polygonal_optimizations(mesh_optimizer::flag flags);
+
+		// polygonal levels of detail: each coarser level keeps at most lod_ratio times the triangles of the next finer one,
+		// unless that moves the surface further than max_error (model units), see mesh_simplifier::simplify_lods
+		void set_polygonal_simplification(float lod_ratio, float max_error = std::numeric_limits<float>::max());
+
+		// tolerances used by mesh_optimizer::flag_weld_vertices_nearby, see mesh_optimizer::set_weld_tolerances
+		void set_polygonal_weld_tolerances(float distance, float angle);
+
+		// simulated drawing cost of all polygonal meshes tessellated so far, before and after optimization
+		// only collected after set_collect_polygonal_stats(true), see mesh_optimizer::set_collect_stats
+		void set_collect_polygonal_stats(bool collect);
+		mesh_optimizer::stats get_polygonal_input_stats() const;
+		mesh_optimizer::stats get_polygonal_output_stats() const;
+		mesh_optimizer::weld_stats get_polygonal_weld_stats() const;
+		polygon_tessellator::path_stats get_polygon_path_stats() const; // always collected
+		void reset_polygonal_stats();
+
+		// parametric primitives already present in the cache are not tessellated again (nullptr disables caching)
+		// polygonal meshes are looked up by content once tessellated and optimized, each level of detail on its own
+		// the cache is only accessed from the calling thread
+		void set_cache(tessellation_cache* cache);
+
+		// if tessellation throws, entries this call added to the cache are removed before the exception is rethrown
+		void tessellate(const primitive_batch& batch, batch_result& result);
+
+	private:
+		batch_tessellator(const batch_tessellator&) = delete;
+		batch_tessellator& operator=(const batch_tessellator&) = delete;
+
+		class impl;
+		impl* _d;
+	};
+} // namespace tess
@@ -1,5 +1,5 @@
 #pragma once
-#include <glm.h>
+#include <tess/triangle_mesh.h>
 
 namespace tess
 {
@@ -12,7 +12,9 @@ namespace tess
 	{
 		float in_radius = 0.1f;
 		float out_radius = 0.4f;
-		float sweep_angle = math::half_pi();
+		float sweep_angle = half_pi<float>();
+		int segment_count = 16;
+		int sweep_count = 8;
 	};
 
 	struct cone
@@ -20,6 +22,9 @@ namespace tess
 		float top_radius = 0.25f;
 		float bottom_radius = 0.5f;
 		float height = 1.0f;
+		int segment_count = 16;
+		bool with_top_cap = true;
+		bool with_bottom_cap = true;
 	};
 
 	struct cone_offset
@@ -28,12 +33,31 @@ namespace tess
 		float bottom_radius = 0.5f;
 		float height = 1.0f;
 		vec2  offset = {0.25f, 0.25f};
+		int segment_count = 16;
+		bool with_top_cap = true;
+		bool with_bottom_cap = true;
+	};
+
+	struct cone_slope_offset
+	{
+		float top_radius = 0.25f;
+		float bottom_radius = 0.5f;
+		float height = 1.0f;
+		vec2  top_slope_angles = {0.0f, 0.0f};
+		vec2  bottom_slope_angles = {0.0f, 0.0f};
+		vec2  offset = {0.25f, 0.25f};
+		int segment_count = 16;
+		bool with_top_cap = true;
+		bool with_bottom_cap = true;
 	};
 
 	struct cylinder
 	{
 		float radius = 0.5f;
 		float height = 1.0f;
+		int segment_count = 16;
+		bool with_top_cap = true;
+		bool with_bottom_cap = true;
 	};
 
 	struct cylinder_offset
@@ -41,12 +65,17 @@ namespace tess
 		float radius = 0.5f;
 		float height = 1.0f;
 		vec2  offset = {0.25f, 0.25f};
+		int segment_count = 16;
+		bool with_top_cap = true;
+		bool with_bottom_cap = true;
 	};
 
 	struct dish
 	{
 		float radius = 0.5f;
 		float height = 1.0f;
+		int horizontal_count = 16;
+		int vertical_count = 8;
 	};
 
 	struct pyramid
@@ -62,11 +91,23 @@ namespace tess
 		float in_height = 1.0f;
 		float in_radius = 0.1f;
 		float out_radius = 0.4f;
-		float sweep_angle = math::half_pi();
+		float sweep_angle = half_pi<float>();
+		int sweep_count = 8;
 	};
 
 	struct sphere
 	{
 		float radius = 0.5f;
+		int horizontal_count = 16;
+		int vertical_count = 16;
+	};
+
+	// range of polygons in a batch that make up a single polygonal mesh
+	struct polygonal
+	{
+		unsigned int first_polygon = 0;
+		unsigned int polygon_count = 0;
+		unsigned int lod = 0;       // level of detail described by this entry, 0 is the coarsest
+		unsigned int lod_count = 1; // levels of detail of the same mesh, stored one after the other
 	};
 } // namespace tess
@@ -92,14 +92,31 @@ void		dictDelete( Dict *dict, DictNode *node );
 
 /*** Private data structures ***/
 
+/* The dictionary is a skip list.  Level 0 is the sorted doubly linked
+ * list that Succ, Pred, Min and Max walk; each node is also linked into
+ * a random number of higher levels, each about a quarter as long as the
+ * one below it, so that Search takes logarithmic time instead of
+ * walking the whole sweep line.
+ */
+#define DICT_MAX_LEVEL	12
+
+typedef struct DictLink {
+  DictNode	*next;
+  DictNode	*prev;
+} DictLink;
+
 struct DictNode {
   DictKey	key;
   DictNode	*next;
   DictNode	*prev;
+  int		height;		/* number of levels this node is linked in */
+  DictLink	*up;		/* links of levels 1 .. height-1 */
 };
 
 struct Dict {
   DictNode	head;
+  DictLink	headUp[DICT_MAX_LEVEL-1];
+  unsigned long	seed;		/* chooses node heights */
   void		*frame;
   int		(*leq)(void *frame, DictKey key1, DictKey key2);
 };
@@ -43,21 +43,57 @@
 #include "dict-list.h"
 #include "memalloc.h"
 
+/* Links of node at level i; level 0 is the plain list. */
+#define Next(n,i)	((i) == 0 ? (n)->next : (n)->up[(i)-1].next)
+#define Prev(n,i)	((i) == 0 ? (n)->prev : (n)->up[(i)-1].prev)
+
+static void SetNext( DictNode *n, int i, DictNode *next )
+{
+  if( i == 0 ) n->next = next; else n->up[i-1].next = next;
+}
+
+static void SetPrev( DictNode *n, int i, DictNode *prev )
+{
+  if( i == 0 ) n->prev = prev; else n->up[i-1].prev = prev;
+}
+
+/* Each node reaches one level higher with probability 1/4.  Heights
+ * come from a generator owned by the dictionary, so that tessellating
+ * the same polygon always builds the same skip list.
+ */
+static int RandomHeight( Dict *dict )
+{
+  int height = 1;
+
+  while( height < DICT_MAX_LEVEL ) {
+    dict->seed = dict->seed * 1103515245 + 12345;
+    if( ((dict->seed >> 16) & 3) != 0 ) break;
+    ++height;
+  }
+  return height;
+}
+
 /* really __tess_dictListNewDict */
 Dict *dictNewDict( void *frame,
 		   int (*leq)(void *frame, DictKey key1, DictKey key2) )
 {
   Dict *dict = (Dict *) memAlloc( sizeof( Dict ));
   DictNode *head;
+  int i;
 
   if (dict == NULL) return NULL;
 
   head = &dict->head;
 
   head->key = NULL;
-  head->next = head;
-  head->prev = head;
+  head->height = DICT_MAX_LEVEL;
+  head->up = dict->headUp;
+  for( i = 0; i < DICT_MAX_LEVEL; ++i ) {
+    SetNext( head, i, head );
+    SetPrev( head, i, head );
+  }
 
+  dict->seed = 2016473283;
   dict->frame = frame;
   dict->leq = leq;
 
@@ -67,9 +103,10 @@ Dict *dictNewDict( void *frame,
 /* really __tess_dictListDeleteDict */
 void dictDeleteDict( Dict *dict )
 {
-  DictNode *node;
+  DictNode *node, *next;
 
-  for( node = dict->head.next; node != &dict->head; node = node->next ) {
+  for( node = dict->head.next; node != &dict->head; node = next ) {
+    next = node->next;
     memFree( node );
   }
   memFree( dict );
@@ -78,20 +115,38 @@ void dictDeleteDict( Dict *dict )
 /* really __tess_dictListInsertBefore */
 DictNode *dictInsertBefore( Dict *dict, DictNode *node, DictKey key )
 {
-  DictNode *newNode;
+  DictNode *newNode, *prev;
+  int i, height;
 
+  /* The sweep always passes a node next to where the key belongs, so
+   * walking back along level 0 stays short.
+   */
   do {
     node = node->prev;
   } while( node->key != NULL && ! (*dict->leq)(dict->frame, node->key, key));
 
-  newNode = (DictNode *) memAlloc( sizeof( DictNode ));
+  height = RandomHeight( dict );
+  newNode = (DictNode *) memAlloc( sizeof( DictNode )
+				   + (height - 1) * sizeof( DictLink ));
   if (newNode == NULL) return NULL;
 
   newNode->key = key;
-  newNode->next = node->next;
-  node->next->prev = newNode;
-  newNode->prev = node;
-  node->next = newNode;
+  newNode->height = height;
+  newNode->up = (DictLink *)(newNode + 1);
+
+  /* At each level, link after the closest previous node that is tall
+   * enough, found by climbing back from the level-0 predecessor.
+   */
+  prev = node;
+  for( i = 0; i < height; ++i ) {
+    while( prev->height <= i ) {
+      prev = Prev( prev, prev->height - 1 );
+    }
+    SetNext( newNode, i, Next( prev, i ));
+    SetPrev( newNode, i, prev );
+    SetPrev( Next( prev, i ), i, newNode );
+    SetNext( prev, i, newNode );
+  }
 
   return newNode;
 }
@@ -99,8 +154,12 @@ DictNode *dictInsertBefore( Dict *dict, DictNode *node, DictKey key )
 /* really __tess_dictListDelete */
 void dictDelete( Dict *dict, DictNode *node ) /*ARGSUSED*/
 {
-  node->next->prev = node->prev;
-  node->prev->next = node->next;
+  int i;
+
+  for( i = 0; i < node->height; ++i ) {
+    SetPrev( Next( node, i ), i, Prev( node, i ));
+    SetNext( Prev( node, i ), i, Next( node, i ));
+  }
   memFree( node );
 }
 
@@ -108,11 +167,19 @@ void dictDelete( Dict *dict, DictNode *node ) /*ARGSUSED*/
 DictNode *dictSearch( Dict *dict, DictKey key )
 {
   DictNode *node = &dict->head;
+  DictNode *next;
+  int i;
+
+  /* Skip every node whose key is smaller than the given one, using the
+   * highest levels first.  The answer is the node after the last one
+   * skipped.
+   */
+  for( i = DICT_MAX_LEVEL - 1; i >= 0; --i ) {
+    for( next = Next( node, i ); next->key != NULL
+	   && ! (*dict->leq)(dict->frame, key, next->key); next = Next( node, i )) {
+      node = next;
+    }
+  }
 
-  do
-  {
-    node = node->next;
-  } while( node->key != NULL && ! (*dict->leq)(dict->frame, key, node->key));
-
-  return node;
+  return node->next;
 }
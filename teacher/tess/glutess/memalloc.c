@@ -42,6 +42,34 @@
 #include "memalloc.h"
 #include "string.h"
 
+#if defined(_MSC_VER)
+#define TESS_THREAD_LOCAL	__declspec(thread)
+#else
+#define TESS_THREAD_LOCAL	__thread
+#endif
+
+/* Every arena allocation is preceded by a header holding its size,
+ * which memRealloc() needs to copy the old contents.  The header also
+ * keeps the allocations aligned for doubles and pointers.
+ */
+typedef union ArenaHeader {
+  size_t	size;
+  double	d;
+  void		*p;
+} ArenaHeader;
+
+struct TESSarenaBlock {
+  TESSarenaBlock	*next;
+  size_t		size;		/* usable bytes after the block header */
+};
+
+#define ARENA_MIN_BLOCK		(64 * 1024)
+#define ArenaRound(n)	(((n) + sizeof(ArenaHeader) - 1) \
+			 / sizeof(ArenaHeader) * sizeof(ArenaHeader))
+#define BlockData(b)	((char *)((b) + 1))
+
+static TESS_THREAD_LOCAL TESSarena *currentArena = NULL;
+
 int __tess_memInit( size_t maxFast )
 {
 #ifndef NO_MALLOPT
@@ -53,10 +81,142 @@ int __tess_memInit( size_t maxFast )
    return 1;
 }
 
-#ifdef MEMORY_DEBUG
-void *__tess_memAlloc( size_t n )
+void __tess_arenaInit( TESSarena *arena )
 {
-  return memset( malloc( n ), 0xa5, n );
+  arena->blocks = NULL;
+  arena->top = NULL;
+  arena->end = NULL;
 }
+
+static int ArenaGrow( TESSarena *arena, size_t n )
+{
+  TESSarenaBlock *block;
+  size_t size = ARENA_MIN_BLOCK;
+
+  /* Blocks double in size, so large polygons need few of them. */
+  if( arena->blocks != NULL && size < 2 * arena->blocks->size ) {
+    size = 2 * arena->blocks->size;
+  }
+  if( size < n ) size = n;
+
+  block = (TESSarenaBlock *)malloc( sizeof( TESSarenaBlock ) + size );
+  if (block == NULL) return 0;
+
+  block->next = arena->blocks;
+  block->size = size;
+  arena->blocks = block;
+  arena->top = BlockData( block );
+  arena->end = arena->top + size;
+  return 1;
+}
+
+static void *ArenaAlloc( TESSarena *arena, size_t n )
+{
+  ArenaHeader *h;
+  size_t total = sizeof( ArenaHeader ) + ArenaRound( n );
+
+  if( (size_t)(arena->end - arena->top) < total ) {
+    if ( !ArenaGrow( arena, total ) ) return NULL;
+  }
+  h = (ArenaHeader *)arena->top;
+  h->size = ArenaRound( n );
+  arena->top += total;
+  return h + 1;
+}
+
+static void *ArenaRealloc( TESSarena *arena, void *p, size_t n )
+{
+  ArenaHeader *h;
+  size_t size;
+  void *pNew;
+
+  if( p == NULL ) return ArenaAlloc( arena, n );
+  h = (ArenaHeader *)p - 1;
+  size = h->size;
+
+  /* The priority queue keeps growing the last array it allocated,
+   * which can then be extended where it is.
+   */
+  if( (char *)p + size == arena->top
+      && ArenaRound( n ) <= size + (size_t)(arena->end - arena->top) ) {
+    arena->top = (char *)p + ArenaRound( n );
+    h->size = ArenaRound( n );
+    return p;
+  }
+
+  pNew = ArenaAlloc( arena, n );
+  if (pNew == NULL) return NULL;
+  memcpy( pNew, p, size < n ? size : n );
+  return pNew;
+}
+
+void __tess_arenaReset( TESSarena *arena )
+{
+  TESSarenaBlock *block, *next;
+  size_t size = 0;
+
+  if( arena->blocks == NULL ) return;
+
+  if( arena->blocks->next != NULL ) {
+    /* Replace the blocks with a single one that holds all of them,
+     * so that the next polygon of the same size does not grow again.
+     */
+    for( block = arena->blocks; block != NULL; block = next ) {
+      next = block->next;
+      size += block->size;
+      free( block );
+    }
+    arena->blocks = NULL;
+    if ( !ArenaGrow( arena, size ) ) {
+      __tess_arenaInit( arena );
+      return;
+    }
+  }
+  arena->top = BlockData( arena->blocks );
+  arena->end = arena->top + arena->blocks->size;
+}
+
+void __tess_arenaFree( TESSarena *arena )
+{
+  TESSarenaBlock *block, *next;
+
+  for( block = arena->blocks; block != NULL; block = next ) {
+    next = block->next;
+    free( block );
+  }
+  __tess_arenaInit( arena );
+}
+
+TESSarena *__tess_arenaEnter( TESSarena *arena )
+{
+  TESSarena *previous = currentArena;
+  currentArena = arena;
+  return previous;
+}
+
+void __tess_arenaLeave( TESSarena *previous )
+{
+  currentArena = previous;
+}
+
+void *__tess_memAlloc( size_t n )
+{
+  void *p = (currentArena != NULL) ? ArenaAlloc( currentArena, n )
+				   : malloc( n );
+#ifdef MEMORY_DEBUG
+  if (p != NULL) memset( p, 0xa5, n );
 #endif
+  return p;
+}
+
+void *__tess_memRealloc( void *p, size_t n )
+{
+  if( currentArena != NULL ) return ArenaRealloc( currentArena, p, n );
+  return realloc( p, n );
+}
 
+void __tess_memFree( void *p )
+{
+  /* Arena memory is released by __tess_arenaReset(). */
+  if( currentArena == NULL ) free( p );
+}
@@ -44,18 +44,40 @@
 
 #include <malloc.h>
 
-#define memRealloc	realloc
-#define memFree		free
+/* Polygon memory is taken from an arena: a list of blocks that
+ * allocations are bumped out of.  memFree() does nothing for arena
+ * memory, which is released wholesale by __tess_arenaReset() once the
+ * polygon is done.  Allocations go to the arena that was made current
+ * on this thread by __tess_arenaEnter(), and to malloc() otherwise.
+ */
+typedef struct TESSarenaBlock TESSarenaBlock;
 
-#define memInit		__tess_memInit
-/*extern void		__tess_memInit( size_t );*/
-extern int		__tess_memInit( size_t );
+typedef struct TESSarena {
+  TESSarenaBlock	*blocks;	/* most recent block first */
+  char		*top;		/* next free byte of blocks */
+  char		*end;		/* end of blocks */
+} TESSarena;
+
+extern void		__tess_arenaInit( TESSarena *arena );
+extern void		__tess_arenaReset( TESSarena *arena );
+extern void		__tess_arenaFree( TESSarena *arena );
+
+/* Make arena current on this thread (NULL for malloc) and return the
+ * previous one, which must be restored with __tess_arenaLeave().
+ */
+extern TESSarena *	__tess_arenaEnter( TESSarena *arena );
+extern void		__tess_arenaLeave( TESSarena *previous );
 
-#ifndef MEMORY_DEBUG
-#define memAlloc	malloc
-#else
 #define memAlloc	__tess_memAlloc
+#define memRealloc	__tess_memRealloc
+#define memFree		__tess_memFree
+
 extern void *		__tess_memAlloc( size_t );
-#endif
+extern void *		__tess_memRealloc( void *, size_t );
+extern void		__tess_memFree( void * );
+
+#define memInit		__tess_memInit
+/*extern void		__tess_memInit( size_t );*/
+extern int		__tess_memInit( size_t );
 
 #endif
@@ -44,6 +44,7 @@
 
 #include <tess/glutess/glutess_facade.h>
 #include <setjmp.h>
+#include "memalloc.h"
 #include "mesh.h"
 #include "dict.h"
 #include "priorityq.h"
@@ -127,6 +128,8 @@ struct GLUTESS_tesselator {
 
   jmp_buf env;			/* place to jump to when memAllocs fail */
 
+  TESSarena arena;		/* memory of the current polygon */
+
   void *polygonData;		/* client data for current polygon */
 };
 
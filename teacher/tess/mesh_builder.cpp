@@ -1,4 +1,5 @@
 #include <tess/mesh_builder.h>
+#include <algorithm>
 #include <stdexcept>
 
 namespace tess
@@ -7,13 +8,33 @@ namespace tess
 	static const unsigned int GL_TRIANGLE_STRIP = 0x0005;
 	static const unsigned int GL_TRIANGLE_FAN   = 0x0006;
 
+	// capacity kept regardless of estimates, so runs of tiny meshes never reallocate
+	static const std::size_t MIN_KEPT_CAPACITY = 4096;
+
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+	// give back memory left by a mesh much larger than the recent ones, and reserve what the next mesh is likely to need
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	template<typename T>
+	static void fit_capacity(std::vector<T>& v, std::size_t estimate)
+	{
+		if(v.capacity() > 4 * estimate + MIN_KEPT_CAPACITY)
+		{
+			std::vector<T>().swap(v);
+		}
+
+		v.reserve(estimate);
+	}
+
 	//----------------------------------------------------------------------------------------------------------------------------------------------------------
 	// mesh_builder::public
 	//----------------------------------------------------------------------------------------------------------------------------------------------------------
 
 	mesh_builder::mesh_builder() : _curr_prim_mode(GL_TRIANGLES),
 								 _num_curr_elements(0),
-								 _invert_winding(false)
+								 _invert_winding(false),
+								 _vertex_estimate(0),
+								 _element_estimate(0)
 	{
 		_curr_elements[0] = 0;
 		_curr_elements[1] = 0;
@@ -22,9 +43,9 @@ namespace tess
 	void mesh_builder::begin()
 	{
 		_vertices.clear();
-		_vertices.reserve(65535);
+		fit_capacity(_vertices, _vertex_estimate);
 		_elements.clear();
-		_elements.reserve(65535 * 12);
+		fit_capacity(_elements, _element_estimate);
 		_curr_prim_mode = GL_TRIANGLES;
 		_curr_elements[0] = 0;
 		_curr_elements[1] = 0;
@@ -72,6 +93,13 @@ namespace tess
 		}
 	}
 
+	void mesh_builder::add_triangle(element e0, element e1, element e2)
+	{
+		_elements.push_back(e0);
+		_elements.push_back(e1);
+		_elements.push_back(e2);
+	}
+
 	unsigned int mesh_builder::add_vertex(const vertex& v)
 	{
 		_vertices.push_back(v);
@@ -85,13 +113,28 @@ namespace tess
 
 	triangle_mesh mesh_builder::end()
 	{
+		_update_estimates();
 		return {_vertices, _elements};
 	}
 
+	void mesh_builder::end(mesh_sink& sink)
+	{
+		_update_estimates();
+		std::copy(_vertices.begin(), _vertices.end(), sink.allocate_vertices(_vertices.size()));
+		std::copy(_elements.begin(), _elements.end(), sink.allocate_elements(_elements.size()));
+	}
+
 	//----------------------------------------------------------------------------------------------------------------------------------------------------------
 	// mesh_builder::private
 	//----------------------------------------------------------------------------------------------------------------------------------------------------------
 
+	void mesh_builder::_update_estimates()
+	{
+		// a large mesh raises the estimates at once, which then decay by 1/8 per mesh
+		_vertex_estimate = std::max(_vertices.size(), _vertex_estimate - _vertex_estimate / 8);
+		_element_estimate = std::max(_elements.size(), _element_estimate - _element_estimate / 8);
+	}
+
 	void mesh_builder::_add_triangle(element last_elem)
 	{
 		// Three vertices make one unique triangle
@@ -9,15 +9,115 @@ namespace tess
 		typedef unsigned int flag;
 
 		static const flag flag_check_results = 1;              // check results for consistency and print any problems found: O(n^2)
-		static const flag flag_all_optimizations = (~0U) << 1; // enable all optimizations: O(n)
+		static const flag flag_all_optimizations = ((~0U) << 1) & ~(1U << 3); // enable all lossless optimizations, all but flag_weld_vertices_nearby: O(n log n)
 		static const flag flag_remove_unused_vertices = 1 << 1; // remove vertices not referenced by any element: O(n)
 		static const flag flag_weld_vertices_exact = 1 << 2;    // merge vertices with exactly the same attributes: O(n)
-		// todo: static const flag flag_weld_vertices_nearby =  1<<3; // merge nearby vertices using tolerance: O(n)
+		static const flag flag_weld_vertices_nearby = 1 << 3;   // merge vertices within distance and normal angle tolerances, see set_weld_tolerances (lossy, opt-in): O(n)
+		static const flag flag_optimize_vertex_cache = 1 << 4;  // reorder triangles to reuse post-transform cache entries (tipsify): O(n)
+		static const flag flag_optimize_overdraw = 1 << 5;      // reorder vertex cache clusters so outward-facing ones are drawn first: O(n log n)
+		static const flag flag_optimize_vertex_fetch = 1 << 6;  // reorder vertices by first use in elements: O(n)
+
+		// size of the simulated post-transform cache, used both to optimize and to analyze meshes
+		static const unsigned int VERTEX_CACHE_SIZE = 16;
+
+		// ------------------------------------------------------------------------------------------------------------------------------------------------------
+		// stats: simulated cost of drawing meshes, can be accumulated over many meshes
+		// ------------------------------------------------------------------------------------------------------------------------------------------------------
+		struct stats
+		{
+			unsigned long long triangles = 0;
+			unsigned long long vertices = 0;             // vertices referenced by elements
+			unsigned long long transformed_vertices = 0; // vertex shader invocations with a FIFO post-transform cache
+			unsigned long long vertex_bytes = 0;         // size of referenced vertices
+			unsigned long long fetched_bytes = 0;        // bytes read from the vertex buffer through a small cache of 64-byte lines
+
+			stats& operator+=(const stats& other);
+
+			double acmr() const;      // average cache miss ratio: transformed vertices per triangle, 0.5 is the best possible
+			double atvr() const;      // average transformed vertex ratio: transformed vertices per vertex, 1.0 is the best possible
+			double overfetch() const; // fetched bytes per vertex byte, 1.0 is the best possible
+		};
+
+		static stats analyze(const triangle_mesh& mesh, unsigned int cache_size = VERTEX_CACHE_SIZE);
+
+		// ------------------------------------------------------------------------------------------------------------------------------------------------------
+		// weld_stats: work done by flag_weld_vertices_nearby, can be accumulated over many meshes
+		// ------------------------------------------------------------------------------------------------------------------------------------------------------
+		struct weld_stats
+		{
+			unsigned long long removed_vertices = 0;
+			unsigned long long removed_triangles = 0; // collapsed by welding two of their corners
+			double msec = 0.0;
+
+			weld_stats& operator+=(const weld_stats& other);
+		};
+
+		mesh_optimizer();
+
+		// vertices are welded by flag_weld_vertices_nearby when their positions are at most distance apart (model units)
+		// and their normals differ by at most angle (radians), so hard edges are kept
+		void set_weld_tolerances(float distance, float angle);
+
+		// analyze every mesh given to optimize, before and after optimization (disabled by default)
+		void set_collect_stats(bool collect);
 
 		void optimize(triangle_mesh& mesh, flag flags);
 
+		// accumulated over all meshes given to optimize, before and after optimization
+		// draw cost stats are only accumulated while set_collect_stats is enabled
+		const stats& get_input_stats() const;
+		const stats& get_output_stats() const;
+		const weld_stats& get_weld_stats() const;
+		void reset_stats();
+
 	private:
+		static void _analyze(const triangle_mesh& mesh, unsigned int cache_size, std::vector<unsigned int>& vertex_stamps,
+							 std::vector<unsigned int>& line_stamps, stats& s);
+
+		void _reorder_vertices_by_first_use(triangle_mesh& mesh);
+
+		void _weld_vertices_nearby(triangle_mesh& mesh, weld_stats& s);
+
+		void _optimize_vertex_cache(triangle_mesh& mesh, bool sort_clusters);
+
+		void _sort_clusters(triangle_mesh& mesh);
+
 		std::vector<vertex>  _temp_vertices;
 		std::vector<element> _temp_elements;
+
+		// open addressing table of exact welding, capacity is kept between meshes
+		std::vector<element> _hash_slots;
+
+		// spatial hash grid of welded vertices: first vertex of each cell and next vertex in the same cell
+		// cells are kept in an open addressing table, whose capacity is kept between meshes like _hash_slots
+		struct weld_cell
+		{
+			unsigned long long key = 0;
+			element first = ~0U; // no vertex yet: empty slot
+		};
+
+		float _weld_distance;
+		float _weld_min_cos;
+		std::vector<weld_cell> _weld_cells;
+		std::vector<element> _weld_next;
+
+		bool _collect_stats;
+
+		// tipsify state: triangles adjacent to each vertex in offset/list form, live triangle counts, cache time stamps and dead-end stack
+		std::vector<unsigned int> _adjacency_offsets;
+		std::vector<unsigned int> _adjacency;
+		std::vector<unsigned int> _live_counts;
+		std::vector<unsigned int> _time_stamps;
+		std::vector<element> _dead_ends;
+		std::vector<bool> _emitted;
+
+		// first triangle of each cluster found while optimizing for the vertex cache, and the order in which clusters are drawn
+		std::vector<unsigned int> _cluster_starts;
+		std::vector<float> _cluster_keys;
+		std::vector<unsigned int> _cluster_order;
+
+		stats _input_stats;
+		stats _output_stats;
+		weld_stats _weld_stats;
 	};
 } // namespace tess
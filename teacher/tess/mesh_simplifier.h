@@ -0,0 +1,97 @@
+#pragma once
+#include <tess/triangle_mesh.h>
+#include <limits>
+
+namespace tess
+{
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// mesh_simplifier: reduces triangle count by collapsing edges in order of quadric error (Garland and Heckbert, 1997)
+	// collapses move a vertex onto a neighbour (half-edge collapse), so every remaining vertex keeps its original position and normal
+	// open borders only slide along themselves and hard edges (vertices sharing a position with different normals) only along the crease
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	class mesh_simplifier
+	{
+	public:
+		// collapse edges until at most target_triangle_count triangles are left or the next collapse would move the surface further than max_error
+		// (model units); return the error reached
+		float simplify(triangle_mesh& mesh, unsigned int target_triangle_count, float max_error = std::numeric_limits<float>::max());
+
+		// level of detail chain, coarsest first: lods.back() is the input mesh and every other level keeps at most ratio times the triangles of the next
+		// finer one; all levels come from a single simplification, so errors[i] is the error of lods[i] with respect to the input mesh
+		void simplify_lods(const triangle_mesh& mesh, unsigned int lod_count, float ratio, float max_error,
+						   std::vector<triangle_mesh>& lods, std::vector<float>& errors);
+
+	private:
+		// symmetric 4x4 matrix of summed squared distances to planes, plus the total weight of those planes
+		struct quadric
+		{
+			double a00 = 0.0, a01 = 0.0, a02 = 0.0, a11 = 0.0, a12 = 0.0, a22 = 0.0;
+			double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+			double c = 0.0;
+			double w = 0.0;
+		};
+
+		// edge between two groups (first < second) and the triangles sharing it, with the vertices of the first two of them
+		struct edge
+		{
+			unsigned int groups[2];
+			unsigned int triangles[2];
+			element vertices[2][2];
+			unsigned int triangle_count;
+		};
+
+		struct collapse
+		{
+			float cost;
+			unsigned int from;
+			unsigned int to;
+			unsigned int shared_triangles;
+		};
+
+		enum kind
+		{
+			kind_interior,
+			kind_border,
+			kind_locked
+		};
+
+		void _begin(const triangle_mesh& mesh);
+
+		void _build_edges();
+
+		float _collapse_until(unsigned int target_triangle_count, float max_error);
+
+		unsigned int _pass(unsigned int target_triangle_count, double max_cost);
+
+		bool _find_partners(unsigned int from, unsigned int to);
+
+		bool _is_valid_collapse(const collapse& c);
+
+		void _extract(triangle_mesh& mesh);
+
+		// input mesh: vertices sharing a position form a group, which is what collapses move
+		std::vector<vertex> _vertices;
+		std::vector<element> _elements;
+		std::vector<unsigned int> _group_of;
+		std::vector<unsigned int> _group_offsets;
+		std::vector<element> _group_vertices;
+		std::vector<quadric> _quadrics;
+		unsigned int _group_count;
+		double _max_cost;
+
+		// state of the current pass
+		std::vector<unsigned int> _triangle_offsets;
+		std::vector<unsigned int> _group_triangles;
+		std::vector<edge> _edges;
+		std::vector<unsigned int> _edge_of;
+		std::vector<unsigned char> _kinds;
+		std::vector<collapse> _collapses;
+		std::vector<bool> _touched;
+		std::vector<unsigned int> _stamps;
+		unsigned int _stamp;
+		std::vector<element> _remap;
+		std::vector<std::pair<element, element>> _partners;
+
+		std::vector<element> _hash_slots;
+	};
+} // namespace tess
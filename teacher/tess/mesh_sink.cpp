@@ -0,0 +1,84 @@
+#include <tess/mesh_sink.h>
+#include <stdexcept>
+
+namespace tess
+{
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// mesh_sink
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	mesh_sink::~mesh_sink()
+	{
+	}
+
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// vector_sink
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	vector_sink::vector_sink(std::vector<vertex>& vertices, std::vector<element>& elements) : _vertices(vertices), _elements(elements)
+	{
+	}
+
+	vertex* vector_sink::allocate_vertices(unsigned int count)
+	{
+		const auto first = _vertices.size();
+		_vertices.resize(first + count);
+		return _vertices.data() + first;
+	}
+
+	element* vector_sink::allocate_elements(unsigned int count)
+	{
+		const auto first = _elements.size();
+		_elements.resize(first + count);
+		return _elements.data() + first;
+	}
+
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// span_sink
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	span_sink::span_sink(vertex* vertices, unsigned int vertex_capacity, element* elements, unsigned int element_capacity)
+		: _vertices(vertices), _elements(elements), _vertex_capacity(vertex_capacity), _element_capacity(element_capacity), _vertex_count(0), _element_count(0)
+	{
+	}
+
+	vertex* span_sink::allocate_vertices(unsigned int count)
+	{
+		if(count > _vertex_capacity - _vertex_count)
+		{
+			throw std::length_error("Not enough room for vertices in tess::span_sink.");
+		}
+
+		auto first = _vertices + _vertex_count;
+		_vertex_count += count;
+		return first;
+	}
+
+	element* span_sink::allocate_elements(unsigned int count)
+	{
+		if(count > _element_capacity - _element_count)
+		{
+			throw std::length_error("Not enough room for elements in tess::span_sink.");
+		}
+
+		auto first = _elements + _element_count;
+		_element_count += count;
+		return first;
+	}
+
+	unsigned int span_sink::get_vertex_count() const
+	{
+		return _vertex_count;
+	}
+
+	unsigned int span_sink::get_element_count() const
+	{
+		return _element_count;
+	}
+
+	void span_sink::reset()
+	{
+		_vertex_count = 0;
+		_element_count = 0;
+	}
+} // namespace tess
@@ -0,0 +1,63 @@
+#pragma once
+#include <tess/triangle_mesh.h>
+
+namespace tess
+{
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// mesh_sink: destination of tessellated geometry
+	// each mesh asks once for the exact number of vertices and elements it needs and writes them in place
+	// elements are relative to the first vertex of their mesh
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	class mesh_sink
+	{
+	public:
+		virtual ~mesh_sink();
+
+		virtual vertex* allocate_vertices(unsigned int count) = 0;
+		virtual element* allocate_elements(unsigned int count) = 0;
+	};
+
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// vector_sink: appends meshes to vectors owned by the caller
+	// vectors keep their capacity, so a sink that is cleared and reused stops allocating once it reaches its working size
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	class vector_sink : public mesh_sink
+	{
+	public:
+		vector_sink(std::vector<vertex>& vertices, std::vector<element>& elements);
+
+		virtual vertex* allocate_vertices(unsigned int count);
+		virtual element* allocate_elements(unsigned int count);
+
+	private:
+		std::vector<vertex>& _vertices;
+		std::vector<element>& _elements;
+	};
+
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// span_sink: appends meshes to fixed-size memory, e.g. a pre-sized array or a persistently mapped buffer range
+	// throws std::length_error when a mesh does not fit
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	class span_sink : public mesh_sink
+	{
+	public:
+		span_sink(vertex* vertices, unsigned int vertex_capacity, element* elements, unsigned int element_capacity);
+
+		virtual vertex* allocate_vertices(unsigned int count);
+		virtual element* allocate_elements(unsigned int count);
+
+		unsigned int get_vertex_count() const;
+		unsigned int get_element_count() const;
+
+		// start writing again from the beginning of both spans
+		void reset();
+
+	private:
+		vertex* _vertices;
+		element* _elements;
+		unsigned int _vertex_capacity;
+		unsigned int _element_capacity;
+		unsigned int _vertex_count;
+		unsigned int _element_count;
+	};
+} // namespace tess
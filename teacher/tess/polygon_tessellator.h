@@ -3,15 +3,41 @@
 
 namespace tess
 {
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// polygon_tessellator: triangulates the polygons of a mesh between begin() and end()
+	// meant to be reused across meshes: the glutess object and the vectors the mesh is built in are kept from one mesh to the next
+	// single-contour polygons are triangulated directly in the plane given by their normals: convex ones as a fan, other simple ones by ear clipping
+	// polygons with holes or self-intersections, and anything the direct paths cannot decide, go through the glutess sweep
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
 	class polygon_tessellator
 	{
 	public:
+		// ------------------------------------------------------------------------------------------------------------------------------------------------------
+		// path_stats: polygons triangulated by each path, can be accumulated over many meshes
+		// ------------------------------------------------------------------------------------------------------------------------------------------------------
+		struct path_stats
+		{
+			unsigned long long fan_polygons = 0;
+			unsigned long long ear_clipped_polygons = 0;
+			unsigned long long swept_polygons = 0; // glutess
+
+			path_stats& operator+=(const path_stats& other);
+
+			unsigned long long polygons() const;
+		};
+
 		polygon_tessellator();
 		~polygon_tessellator();
 
 		void begin();
 		void add_polygon(const polygon& poly);
+		void add_polygon(const polygon_view& poly); // points are only read during the call
 		triangle_mesh end();
+		void end(mesh_sink& sink);
+
+		// accumulated over all polygons added since construction or the last reset
+		const path_stats& get_path_stats() const;
+		void reset_path_stats();
 
 	private:
 		polygon_tessellator(const polygon_tessellator&) = delete;
@@ -0,0 +1,61 @@
+#pragma once
+#include <tess/geometries.h>
+
+namespace tess
+{
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// tessellation_quality: derives segment and sweep counts of curved primitives from a maximum chord deviation
+	// a thin pipe gets fewer segments than a wide column and a short elbow gets fewer sweep steps than a long one
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	class tessellation_quality
+	{
+	public:
+		// max_chord_error is given in model units
+		// segment counts go around full circles and are always even, so caps can be closed; sweep counts go along arcs
+		explicit tessellation_quality(float max_chord_error, int min_segment_count = 8, int max_segment_count = 32,
+									  int min_sweep_count = 1, int max_sweep_count = 16);
+
+		float get_max_chord_error() const;
+
+		// number of segments to approximate a full circle of the given radius
+		int segment_count(float radius) const;
+
+		// number of segments to approximate a circular arc of the given radius and angle
+		int sweep_count(float radius, float arc_angle) const;
+
+		// overwrite the segment and sweep counts of a primitive
+		// scale converts primitive units to model units, e.g. the largest scale of the primitive's transform
+		void apply(cylinder& c, float scale = 1.0f) const;
+		void apply(cylinder_offset& c, float scale = 1.0f) const;
+		void apply(cone& c, float scale = 1.0f) const;
+		void apply(cone_offset& c, float scale = 1.0f) const;
+		void apply(cone_slope_offset& c, float scale = 1.0f) const;
+		void apply(circular_torus& t, float scale = 1.0f) const;
+		void apply(rectangular_torus& t, float scale = 1.0f) const;
+		void apply(dish& d, float scale = 1.0f) const;
+		void apply(sphere& s, float scale = 1.0f) const;
+
+	private:
+		int _count(float radius, float arc_angle, int min_count, int max_count) const;
+
+		float _max_chord_error;
+		int _min_segment_count;
+		int _max_segment_count;
+		int _min_sweep_count;
+		int _max_sweep_count;
+	};
+
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// number of triangles generated for a primitive with its current segment and sweep counts
+	// caps follow the flags of the primitive or the defaults of the corresponding tessellate_* functions
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	unsigned int triangle_count(const cylinder& c);
+	unsigned int triangle_count(const cylinder_offset& c);
+	unsigned int triangle_count(const cone& c);
+	unsigned int triangle_count(const cone_offset& c);
+	unsigned int triangle_count(const cone_slope_offset& c);
+	unsigned int triangle_count(const circular_torus& t);
+	unsigned int triangle_count(const rectangular_torus& t);
+	unsigned int triangle_count(const dish& d);
+	unsigned int triangle_count(const sphere& s);
+} // namespace tess
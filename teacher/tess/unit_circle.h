@@ -0,0 +1,106 @@
+#pragma once
+#include <tess/triangle_mesh.h>
+
+namespace tess
+{
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// compile-time trigonometry, only meant to fill the tables below
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	namespace ct
+	{
+		constexpr double PI = 3.14159265358979323846;
+
+		// Taylor series after reducing x to [-pi, pi], accurate to double precision
+		constexpr double sin(double x)
+		{
+			while(x > PI)
+			{
+				x -= 2.0 * PI;
+			}
+			while(x < -PI)
+			{
+				x += 2.0 * PI;
+			}
+
+			double term = x;
+			double sum = x;
+			for(int i = 1; i < 30; ++i)
+			{
+				term *= -x * x / ((2.0 * i) * (2.0 * i + 1.0));
+				sum += term;
+			}
+			return sum;
+		}
+
+		constexpr double cos(double x)
+		{
+			return sin(x + 0.5 * PI);
+		}
+	} // namespace ct
+
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// unit_circle: cosines and sines of the N angles i * 2 pi / N, computed by the compiler
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	template<int N>
+	struct circle_table
+	{
+		float cos[N];
+		float sin[N];
+	};
+
+	template<int N>
+	constexpr circle_table<N> make_circle_table()
+	{
+		circle_table<N> t{};
+		for(int i = 0; i < N; ++i)
+		{
+			const auto angle = 2.0 * ct::PI * i / N;
+			t.cos[i] = static_cast<float>(ct::cos(angle));
+			t.sin[i] = static_cast<float>(ct::sin(angle));
+		}
+		return t;
+	}
+
+	template<int N>
+	struct unit_circle
+	{
+		static constexpr circle_table<N> table = make_circle_table<N>();
+	};
+
+	template<int N>
+	constexpr circle_table<N> unit_circle<N>::table;
+
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// circle_steps: unit vectors at i * 2 pi / segment_count, read from a baked unit_circle when there is one for segment_count
+	// ring of a unit cylinder for i in [0, segment_count), meridian of a unit sphere (with twice its vertical count) for i in [0, segment_count / 2]
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	class circle_steps
+	{
+	public:
+		// every even segment count from 4 up to this one is baked
+		static const int MAX_BAKED_SEGMENT_COUNT = 64;
+
+		explicit circle_steps(int segment_count);
+
+		bool is_baked() const;
+
+		// i may be any non-negative integer, the circle repeats every segment_count steps
+		vec2 operator[](int i) const
+		{
+			if(_cos == nullptr)
+			{
+				return _compute(i);
+			}
+
+			i %= _segment_count;
+			return vec2(_cos[i], _sin[i]);
+		}
+
+	private:
+		vec2 _compute(int i) const;
+
+		const float* _cos;
+		const float* _sin;
+		int _segment_count;
+	};
+} // namespace tess
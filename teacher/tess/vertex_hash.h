@@ -0,0 +1,63 @@
+#pragma once
+#include <tess/triangle_mesh.h>
+#include <cstring>
+
+namespace tess
+{
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	// vertex_hash: internal hashing shared by the welds of mesh_optimizer and mesh_simplifier (and the mesh lookup of tessellation_cache),
+	// so all of them agree on which attributes are equal
+	// ---------------------------------------------------------------------------------------------------------------------------------------------------------
+	namespace vertex_hash
+	{
+		// bits of an attribute: +0 and -0 compare equal, so they must hash equal
+		inline unsigned int bits(float value)
+		{
+			unsigned int b = 0;
+			if(value != 0.0f)
+			{
+				std::memcpy(&b, &value, sizeof(b));
+			}
+			return b;
+		}
+
+		// murmur3 finalizer: spread all bits to the low ones used as table index
+		inline unsigned long long finalize(unsigned long long h)
+		{
+			h ^= h >> 33;
+			h *= 0xff51afd7ed558ccdULL;
+			h ^= h >> 33;
+			h *= 0xc4ceb9fe1a85ec53ULL;
+			h ^= h >> 33;
+			return h;
+		}
+
+		// 64-bit hash of count attributes, consistent with comparing them with ==
+		inline unsigned long long attributes(const float* values, unsigned int count)
+		{
+			unsigned long long h = 0x9e3779b97f4a7c15ULL;
+
+			for(unsigned int i = 0; i < count; ++i)
+			{
+				h = (h ^ bits(values[i])) * 0xff51afd7ed558ccdULL;
+				h ^= h >> 32;
+			}
+
+			return finalize(h);
+		}
+
+		// consistent with vertex::operator==
+		inline unsigned long long of_vertex(const vertex& v)
+		{
+			const float values[6] = {v.position.x, v.position.y, v.position.z, v.normal.x, v.normal.y, v.normal.z};
+			return attributes(values, 6);
+		}
+
+		// consistent with comparing positions with ==
+		inline unsigned long long of_position(const vec3& p)
+		{
+			const float values[3] = {p.x, p.y, p.z};
+			return attributes(values, 3);
+		}
+	} // namespace vertex_hash
+} // namespace tess
@@ -0,0 +1,86 @@
+#include <tess/batch_tessellator.h>
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+// allocations larger than this fail, so tessellation can be made to throw from the vector_sink of a worker
+static std::atomic<size_t> maxAllocation(~size_t(0));
+
+void* operator new(size_t size)
+{
+	void* p = size <= maxAllocation? std::malloc(size > 0? size : 1) : nullptr;
+	if(p == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, size_t /*size*/) noexcept
+{
+	std::free(p);
+}
+
+static int failures = 0;
+
+static void check(bool condition, const char* message)
+{
+	if(!condition)
+	{
+		std::cout << "FAILED: " << message << std::endl;
+		++failures;
+	}
+}
+
+// a batch that throws while tessellating must not leave meshless cache entries behind
+static void testFailedBatchLeavesNoCacheEntries()
+{
+	tess::tessellation_cache cache;
+	tess::batch_tessellator tessellator(4);
+	tessellator.set_cache(&cache);
+
+	// large enough for its vertices to exceed the allocation limit below
+	tess::cylinder c;
+	c.segment_count = 100000;
+
+	tess::primitive_batch batch;
+	batch.add(c);
+	batch.add(c);
+
+	tess::batch_result result;
+	bool thrown = false;
+
+	maxAllocation = 1024 * 1024;
+	try
+	{
+		tessellator.tessellate(batch, result);
+	}
+	catch(const std::bad_alloc&)
+	{
+		thrown = true;
+	}
+	maxAllocation = ~size_t(0);
+
+	check(thrown, "tessellation of the first batch throws");
+	check(cache.size() == 0, "failed batch adds no cache entries");
+
+	tessellator.tessellate(batch, result);
+
+	check(result.ranges.size() == 2, "second batch has one range per primitive");
+	check(!result.ranges[0].reused && result.ranges[0].element_count > 0, "second batch tessellates the key again");
+	check(result.ranges[1].reused && result.ranges[1].cache_entry == result.ranges[0].cache_entry, "duplicate in second batch reuses the new entry");
+}
+
+int main()
+{
+	testFailedBatchLeavesNoCacheEntries();
+
+	std::cout << (failures == 0? "all tests passed" : "some tests failed") << std::endl;
+	return failures == 0? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,15 @@
+TEMPLATE = app
+CONFIG += console
+CONFIG += c++14
+CONFIG -= qt
+
+INCLUDEPATH += ..
+INCLUDEPATH += ../../dep/glm/inc
+
+SOURCES += $$files(*.cpp)
+
+HEADERS += $$files(../tess/*.h)
+SOURCES += $$files(../tess/*.cpp)
+SOURCES += $$files(../tess/glutess/*.c)
+
+LIBS += -lpthread